@@ -0,0 +1,500 @@
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <benchmark/benchmark.h>
+#include "memory_pool.h"
+#include "map_order_book.h"
+#include "ladder_order_book.h"
+#include "transport.h"
+#include "perf_counters.h"
+#include "market_data.h"
+#include "level_scan.h"
+#include "net_ingress.h"
+#include "risk_check.h"
+#include "order.h"
+
+//Order Book Benchmark: microbenchmarks of each book backend and transport backend on their own,
+//one message per benchmark iteration. every benchmark that can open the perf_event group also
+//reports hardware events per message next to the time
+
+const Price MID_PRICE = 10000;
+const size_t FLOW_STEPS = 1 << 15; //steps in a pregenerated flow, replayed in a loop
+const size_t FEED_CAPACITY = 1 << 14; //L2 feed ring in the feed benchmarks, drained when half full
+
+Order make_order(OrderID id, MsgType type, Side side, Price price, Quantity quantity) {
+    Order order{};
+    order.id = id;
+    order.price = price;
+    order.quantity = quantity;
+    order.type = type;
+    order.side = side;
+    return order;
+}
+
+//the ladder is centred on the benchmark's mid price, the map does not need to be told
+template <typename Book>
+std::unique_ptr<Book> make_book(Arena& arena, const BookLimits& limits) {
+    if constexpr (std::is_same_v<Book, LadderOrderBook>) {
+        return std::make_unique<Book>(arena, limits, nullptr, MID_PRICE);
+    } else {
+        return std::make_unique<Book>(arena, limits);
+    }
+}
+
+//a book and its arena, prefilled with orders resting over levels above and below the mid price
+template <typename Book>
+struct BenchBook {
+    BookLimits limits;
+    Arena arena;
+    std::unique_ptr<Book> book;
+
+    BenchBook(size_t orders, size_t levels, OrderID first_id)
+        : limits{16 * orders + 1024, 4 * levels + 64, ExhaustionPolicy::REJECT},
+          arena(Book::arena_bytes(limits)),
+          book(make_book<Book>(arena, limits)) {
+        std::mt19937 gen(7);
+        for (size_t i = 0; i < orders; ++i) {
+            Order order = resting(first_id + i, i % 2 == 0 ? Side::BUY : Side::SELL, levels, gen);
+            book->process_order(order);
+        }
+    }
+
+    //a non-crossing order on one of levels prices on its side
+    static Order resting(OrderID id, Side side, size_t levels, std::mt19937& gen) {
+        Price offset = 1 + static_cast<Price>(gen() % levels);
+        Quantity quantity = 1 + static_cast<Quantity>(gen() % 10);
+        return make_order(id, MsgType::NEW, side, side == Side::BUY ? MID_PRICE - offset : MID_PRICE + offset,
+                          quantity);
+    }
+};
+
+//reports each perf event per message, for the events this machine exposes
+void report_counters(benchmark::State& state, const PerfCounters& counters, const PerfSample& sample,
+                     double messages) {
+    if (!counters.ok() || messages <= 0) {
+        return;
+    }
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+        PerfEvent event = static_cast<PerfEvent>(i);
+        if (counters.available(event)) {
+            state.counters[std::string(to_string(event)) + "/msg"] = static_cast<double>(sample[event]) / messages;
+        }
+    }
+}
+
+//replays flow against the book, one message per iteration. flow ids are relative to a cycle of the
+//flow and are offset by cycle * stride, so every cycle adds fresh ids and cancels still find
+//the order they were generated against (unsigned wrap-around makes negative offsets work).
+//with a feed attached to the book its ring is emptied inside the timing whenever it is half full
+template <typename Book>
+void replay_flow(benchmark::State& state, Book& book, const std::vector<Order>& flow, OrderID stride,
+                 LevelFeed* feed = nullptr) {
+    LevelUpdate drained[64];
+    PerfCounters counters;
+    counters.start();
+    PerfSample before = counters.read();
+    size_t next = 0;
+    OrderID cycle = 1;
+    for (auto _ : state) {
+        Order order = flow[next];
+        order.id += cycle * stride;
+        book.process_order(order);
+        benchmark::ClobberMemory();
+        if (feed && feed->updates().size_approx() > FEED_CAPACITY / 2) {
+            while (feed->updates().try_pop_bulk(drained, 64) > 0) {
+            }
+        }
+        if (++next == flow.size()) {
+            next = 0;
+            ++cycle;
+        }
+    }
+    PerfSample sample = counters.read() - before;
+    counters.stop();
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    report_counters(state, counters, sample, static_cast<double>(state.iterations()));
+}
+
+//resting-heavy: every step adds a non-crossing order and cancels the one added `orders` steps earlier,
+//so the book holds its depth and nothing trades
+template <typename Book>
+void BM_ProcessResting(benchmark::State& state) {
+    size_t orders = static_cast<size_t>(state.range(0));
+    size_t levels = static_cast<size_t>(state.range(1));
+    BenchBook<Book> bench(orders, levels, FLOW_STEPS - orders);
+    std::mt19937 gen(11);
+    std::vector<Order> flow;
+    flow.reserve(2 * FLOW_STEPS);
+    for (size_t i = 0; i < FLOW_STEPS; ++i) {
+        Side side = i % 2 == 0 ? Side::BUY : Side::SELL;
+        flow.push_back(BenchBook<Book>::resting(i, side, levels, gen));
+        flow.push_back(make_order(static_cast<OrderID>(i - orders), MsgType::CANCEL, side, 0, 0));
+    }
+    replay_flow(state, *bench.book, flow, FLOW_STEPS);
+}
+
+//crossing-heavy: every step rests an order and then sends an aggressor of the same size from the other
+//side that is marketable through every level, so half the messages trade and the depth holds.
+//with_feed attaches an L2 feed, the difference is what emitting level updates adds to matching
+template <typename Book>
+void process_crossing(benchmark::State& state, bool with_feed) {
+    size_t orders = static_cast<size_t>(state.range(0));
+    size_t levels = static_cast<size_t>(state.range(1));
+    BenchBook<Book> bench(orders, levels, 0);
+    std::mt19937 gen(13);
+    std::vector<Order> flow;
+    flow.reserve(2 * FLOW_STEPS);
+    Price reach = static_cast<Price>(levels) + 1;
+    for (size_t i = 0; i < FLOW_STEPS; ++i) {
+        Side side = i % 2 == 0 ? Side::BUY : Side::SELL;
+        Order passive = BenchBook<Book>::resting(2 * i, side, levels, gen);
+        flow.push_back(passive);
+        flow.push_back(side == Side::BUY
+                       ? make_order(2 * i + 1, MsgType::NEW, Side::SELL, MID_PRICE - reach, passive.quantity)
+                       : make_order(2 * i + 1, MsgType::NEW, Side::BUY, MID_PRICE + reach, passive.quantity));
+    }
+    //crossing ids never refer back, they only have to stay clear of the prefill and of other cycles
+    for (Order& order : flow) {
+        order.id += orders;
+    }
+    Arena feed_arena(LevelFeed::bytes_needed(FEED_CAPACITY));
+    LevelFeed feed(feed_arena, FEED_CAPACITY);
+    if (with_feed) {
+        bench.book->attach_feed(&feed, 0);
+    }
+    replay_flow(state, *bench.book, flow, flow.size() + orders, with_feed ? &feed : nullptr);
+    if (with_feed) {
+        state.counters["updates/msg"] = static_cast<double>(feed.published()) / static_cast<double>(state.iterations());
+    }
+}
+
+template <typename Book>
+void BM_ProcessCrossing(benchmark::State& state) {
+    process_crossing<Book>(state, false);
+}
+
+template <typename Book>
+void BM_ProcessCrossingFeed(benchmark::State& state) {
+    process_crossing<Book>(state, true);
+}
+
+//one order type. every step rests a limit order, then
+//  limit, market, ioc, fok: an aggressor of that type for the same quantity, marketable through every
+//      level so it fills completely (fok pays its liquidity pre-check first), and for ioc and fok a
+//      second one that does not fill: an ioc priced short of the book, which is cancelled instead of
+//      resting, and a fok for more than the best level holds, killed by the pre-check
+//  post-only: the resting order is sent post-only, a crossing post-only order is rejected, and the
+//      order rested `orders` steps earlier is cancelled so the depth holds
+template <typename Book>
+void BM_ProcessOrderType(benchmark::State& state) {
+    OrderType type = static_cast<OrderType>(state.range(0));
+    size_t orders = static_cast<size_t>(state.range(1));
+    size_t levels = static_cast<size_t>(state.range(2));
+    state.SetLabel(to_string(type));
+    BenchBook<Book> bench(orders, levels, FLOW_STEPS - orders);
+    std::mt19937 gen(23);
+    std::vector<Order> flow;
+    flow.reserve(3 * FLOW_STEPS);
+    Price reach = static_cast<Price>(levels) + 1;
+    auto aggressor = [&](OrderID id, Side side, Price offset, Quantity quantity) {
+        Order order = make_order(id, MsgType::NEW, side, side == Side::BUY ? MID_PRICE + offset : MID_PRICE - offset,
+                                 quantity);
+        order.order_type = type;
+        return order;
+    };
+    for (size_t i = 0; i < FLOW_STEPS; ++i) {
+        Side side = i % 2 == 0 ? Side::BUY : Side::SELL;
+        Side other = side == Side::BUY ? Side::SELL : Side::BUY;
+        Order passive = BenchBook<Book>::resting(i, side, levels, gen);
+        OrderID id = (OrderID(1) << 40) + 2 * i; //orders that never rest, far clear of the passive ids
+        if (type == OrderType::POST_ONLY) {
+            passive.order_type = OrderType::POST_ONLY;
+            flow.push_back(passive);
+            flow.push_back(aggressor(id, other, reach, passive.quantity));
+            flow.push_back(make_order(static_cast<OrderID>(i - orders), MsgType::CANCEL, side, 0, 0));
+            continue;
+        }
+        flow.push_back(passive);
+        flow.push_back(aggressor(id, other, reach, passive.quantity));
+        if (type == OrderType::IOC) {
+            flow.push_back(aggressor(id + 1, other, 0, passive.quantity));
+        } else if (type == OrderType::FOK) {
+            flow.push_back(aggressor(id + 1, other, 1, 1 << 20));
+        }
+    }
+    replay_flow(state, *bench.book, flow, FLOW_STEPS);
+    state.counters["resting"] = static_cast<double>(bench.book->resting_orders());
+}
+
+//top-of-book query on a resting book, what the engine's snapshot and print paths call
+template <typename Book>
+void BM_TopOfBook(benchmark::State& state) {
+    BenchBook<Book> bench(static_cast<size_t>(state.range(0)), static_cast<size_t>(state.range(1)), 0);
+    PerfCounters counters;
+    counters.start();
+    PerfSample before = counters.read();
+    for (auto _ : state) {
+        TopOfBook top = bench.book->top_of_book();
+        benchmark::DoNotOptimize(top);
+        benchmark::ClobberMemory();
+    }
+    PerfSample sample = counters.read() - before;
+    counters.stop();
+    report_counters(state, counters, sample, static_cast<double>(state.iterations()));
+}
+
+//one market data snapshot of the book at depth levels per side, what the engine pays after each batch
+template <typename Book>
+void BM_PublishSnapshot(benchmark::State& state) {
+    BenchBook<Book> bench(static_cast<size_t>(state.range(0)), static_cast<size_t>(state.range(1)), 0);
+    MarketDataPublisher publisher(1, static_cast<size_t>(state.range(2)), "");
+    PerfCounters counters;
+    counters.start();
+    PerfSample before = counters.read();
+    Timestamp now = 0;
+    for (auto _ : state) {
+        publisher.publish(0, *bench.book, ++now);
+        benchmark::ClobberMemory();
+    }
+    PerfSample sample = counters.read() - before;
+    counters.stop();
+    report_counters(state, counters, sample, static_cast<double>(state.iterations()));
+}
+
+//enqueue then dequeue of batch orders on one thread, the transport's own cost without any contention
+template <typename Transport>
+void BM_TransportSendPoll(benchmark::State& state) {
+    size_t batch = static_cast<size_t>(state.range(0));
+    const size_t capacity = 1 << 12;
+    Arena arena(Transport::arena_bytes(1, capacity) + CACHE_LINE_SIZE);
+    Transport transport(arena, 1, capacity);
+    auto producer = transport.producer(0);
+    std::vector<Order> drained(batch);
+    Order order = make_order(1, MsgType::NEW, Side::BUY, MID_PRICE, 1);
+    PerfCounters counters;
+    counters.start();
+    PerfSample before = counters.read();
+    for (auto _ : state) {
+        for (size_t i = 0; i < batch; ++i) {
+            order.id++;
+            producer.send(order);
+        }
+        size_t received = batch == 1 ? (transport.poll(drained[0]) ? 1 : 0)
+                                     : transport.poll_bulk(drained.data(), batch);
+        benchmark::DoNotOptimize(received);
+        benchmark::ClobberMemory();
+    }
+    PerfSample sample = counters.read() - before;
+    counters.stop();
+    double messages = static_cast<double>(state.iterations()) * static_cast<double>(batch);
+    state.SetItemsProcessed(static_cast<int64_t>(messages));
+    state.counters["ns/msg"] = benchmark::Counter(messages, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    report_counters(state, counters, sample, messages);
+}
+
+//decodes a datagram of batch wire messages into Orders, the network ingress's per-message parsing cost
+void BM_DecodeWireOrder(benchmark::State& state) {
+    size_t batch = static_cast<size_t>(state.range(0));
+    std::vector<unsigned char> datagram(batch * WIRE_ORDER_SIZE);
+    for (size_t i = 0; i < batch; ++i) {
+        Order order = make_order(i + 1, MsgType::NEW, i % 2 ? Side::SELL : Side::BUY, MID_PRICE, 1);
+        encode_order(order, static_cast<uint32_t>(i), i, datagram.data() + i * WIRE_ORDER_SIZE);
+    }
+    PerfCounters counters;
+    counters.start();
+    PerfSample before = counters.read();
+    for (auto _ : state) {
+        for (size_t i = 0; i < batch; ++i) {
+            Order order{};
+            Timestamp sent;
+            uint32_t sequence;
+            bool decoded = decode_order(datagram.data() + i * WIRE_ORDER_SIZE, 1, order, sent, sequence);
+            benchmark::DoNotOptimize(decoded);
+            benchmark::DoNotOptimize(order);
+        }
+    }
+    PerfSample sample = counters.read() - before;
+    counters.stop();
+    double messages = static_cast<double>(state.iterations()) * static_cast<double>(batch);
+    state.SetItemsProcessed(static_cast<int64_t>(messages));
+    state.counters["ns/msg"] = benchmark::Counter(messages, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    report_counters(state, counters, sample, messages);
+}
+
+//one message through the engine's risk chain with every check off (0) or on (1), the cost the inline mode adds
+//ahead of matching. the limits are loose enough that every order passes, so every check runs and commits
+void BM_RiskCheck(benchmark::State& state) {
+    RiskLimits limits;
+    if (state.range(0) != 0) {
+        limits = RiskLimits{1000, 1000, 1LL << 40, 1e12, 1e12};
+    }
+    const size_t lanes = 4;
+    const size_t symbols = 64;
+    Arena arena(RiskStage::bytes_needed(limits, lanes, symbols));
+    RiskStage risk(arena, limits, lanes, symbols);
+    TopOfBook top{MID_PRICE - 1, 10, MID_PRICE + 1, 10};
+    auto top_of = [&top](SymbolID) { return top; };
+    std::vector<Order> flow;
+    for (size_t i = 0; i < 1024; ++i) {
+        Order order = make_order(i + 1, MsgType::NEW, i % 2 ? Side::SELL : Side::BUY, MID_PRICE + static_cast<Price>(i % 5) - 2, 1);
+        order.producer_id = static_cast<uint8_t>(i % lanes);
+        order.symbol = static_cast<SymbolID>(i % symbols);
+        flow.push_back(order);
+    }
+    PerfCounters counters;
+    counters.start();
+    PerfSample before = counters.read();
+    size_t next = 0;
+    for (auto _ : state) {
+        const Order& order = flow[next++ & (flow.size() - 1)];
+        RiskReject verdict = risk.check(order, SimClock::now(), top_of);
+        benchmark::DoNotOptimize(verdict);
+    }
+    PerfSample sample = counters.read() - before;
+    counters.stop();
+    double messages = static_cast<double>(state.iterations());
+    state.SetItemsProcessed(static_cast<int64_t>(messages));
+    report_counters(state, counters, sample, messages);
+}
+
+//switches the level scan kernels to the benchmark's first argument for its lifetime, skipping the
+//benchmark when this CPU does not have them
+struct ScanKernels {
+    level_scan::Isa isa;
+    bool ok;
+
+    explicit ScanKernels(benchmark::State& state)
+        : isa(static_cast<level_scan::Isa>(state.range(0))), ok(level_scan::select(isa)) {
+        if (!ok) {
+            state.SkipWithError("instruction set not available here");
+        }
+        state.SetLabel(level_scan::to_string(isa));
+    }
+    ~ScanKernels() {
+        level_scan::select(level_scan::best_supported());
+    }
+};
+
+//next non-empty bitmap word, both directions, on a bitmap of words words with one bit set every gap
+//words. every query is checked against the scalar scan before timing starts
+void BM_LevelSearch(benchmark::State& state) {
+    ScanKernels kernels(state);
+    if (!kernels.ok) {
+        return;
+    }
+    size_t words = static_cast<size_t>(state.range(1));
+    size_t gap = static_cast<size_t>(state.range(2));
+    std::mt19937 gen(17);
+    std::vector<uint64_t> bits(words, 0);
+    for (size_t word = gen() % gap; word < words; word += gap) {
+        bits[word] = 1ULL << (gen() % 64);
+    }
+    std::vector<size_t> starts(1024);
+    for (size_t& start : starts) {
+        start = gen() % words;
+    }
+    for (size_t start : starts) {
+        if (level_scan::first_nonzero(bits.data(), start, words) != level_scan::scalar::first_nonzero(bits.data(), start, words)
+            || level_scan::last_nonzero(bits.data(), 0, start) != level_scan::scalar::last_nonzero(bits.data(), 0, start)) {
+            state.SkipWithError("kernel disagrees with the scalar scan");
+            return;
+        }
+    }
+    size_t next = 0;
+    for (auto _ : state) {
+        size_t start = starts[next++ & 1023];
+        benchmark::DoNotOptimize(level_scan::first_nonzero(bits.data(), start, words));
+        benchmark::DoNotOptimize(level_scan::last_nonzero(bits.data(), 0, start));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(2 * state.iterations()));
+}
+
+//how far a sweep reaches on a ladder with orders resting over levels ticks per side, for aggressors
+//wanting up to the whole side. every query is checked against the map book, which walks its levels one
+//by one, before timing starts
+void BM_SweepEstimate(benchmark::State& state) {
+    ScanKernels kernels(state);
+    if (!kernels.ok) {
+        return;
+    }
+    size_t orders = static_cast<size_t>(state.range(1));
+    size_t levels = static_cast<size_t>(state.range(2));
+    BenchBook<LadderOrderBook> ladder(orders, levels, 0);
+    BenchBook<MapOrderBook> map(orders, levels, 0);
+    std::mt19937 gen(19);
+    Quantity side_total = static_cast<Quantity>(orders * 11 / 4); //a little more than rests on either side
+    std::vector<Order> queries(1024);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        bool buy = i % 2 == 0;
+        Price reach = 1 + static_cast<Price>(gen() % (levels + 1));
+        queries[i] = make_order(i, MsgType::NEW, buy ? Side::BUY : Side::SELL,
+                                buy ? MID_PRICE + reach : MID_PRICE - reach,
+                                1 + static_cast<Quantity>(gen() % static_cast<uint32_t>(side_total)));
+    }
+    for (const Order& query : queries) {
+        SweepEstimate fast = ladder.book->sweep(query.side, query.price, query.quantity);
+        SweepEstimate walked = map.book->sweep(query.side, query.price, query.quantity);
+        if (fast.fillable != walked.fillable || fast.levels != walked.levels || fast.last_price != walked.last_price) {
+            state.SkipWithError("ladder sweep disagrees with the map book");
+            return;
+        }
+    }
+    size_t next = 0;
+    for (auto _ : state) {
+        const Order& query = queries[next++ & 1023];
+        benchmark::DoNotOptimize(ladder.book->sweep(query.side, query.price, query.quantity));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+//every kernel set, whether or not this machine has it (the missing ones are reported as skipped)
+const std::vector<int64_t> ALL_ISAS = {static_cast<int64_t>(level_scan::Isa::SCALAR), static_cast<int64_t>(level_scan::Isa::NEON),
+                                       static_cast<int64_t>(level_scan::Isa::AVX2), static_cast<int64_t>(level_scan::Isa::AVX512)};
+
+//shallow, medium and deep books: resting orders and the levels per side they are spread over
+void book_shapes(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"orders", "levels"});
+    bench->Args({16, 4});
+    bench->Args({1024, 64});
+    bench->Args({16384, 512});
+}
+
+BENCHMARK_TEMPLATE(BM_ProcessResting, MapOrderBook)->Apply(book_shapes);
+BENCHMARK_TEMPLATE(BM_ProcessResting, LadderOrderBook)->Apply(book_shapes);
+BENCHMARK_TEMPLATE(BM_ProcessCrossing, MapOrderBook)->Apply(book_shapes);
+BENCHMARK_TEMPLATE(BM_ProcessCrossing, LadderOrderBook)->Apply(book_shapes);
+BENCHMARK_TEMPLATE(BM_ProcessCrossingFeed, MapOrderBook)->Apply(book_shapes);
+BENCHMARK_TEMPLATE(BM_ProcessCrossingFeed, LadderOrderBook)->Apply(book_shapes);
+BENCHMARK_TEMPLATE(BM_ProcessOrderType, MapOrderBook)
+    ->ArgNames({"type", "orders", "levels"})->ArgsProduct({{0, 1, 2, 3, 4}, {1024, 16384}, {64}});
+BENCHMARK_TEMPLATE(BM_ProcessOrderType, LadderOrderBook)
+    ->ArgNames({"type", "orders", "levels"})->ArgsProduct({{0, 1, 2, 3, 4}, {1024, 16384}, {64}});
+BENCHMARK_TEMPLATE(BM_TopOfBook, MapOrderBook)->Apply(book_shapes);
+BENCHMARK_TEMPLATE(BM_TopOfBook, LadderOrderBook)->Apply(book_shapes);
+BENCHMARK_TEMPLATE(BM_PublishSnapshot, MapOrderBook)
+    ->ArgNames({"orders", "levels", "depth"})->Args({1024, 64, 1})->Args({1024, 64, 5})->Args({1024, 64, 16});
+BENCHMARK_TEMPLATE(BM_PublishSnapshot, LadderOrderBook)
+    ->ArgNames({"orders", "levels", "depth"})->Args({1024, 64, 1})->Args({1024, 64, 5})->Args({1024, 64, 16});
+BENCHMARK(BM_LevelSearch)->ArgNames({"isa", "words", "gap"})->ArgsProduct({ALL_ISAS, {256}, {4, 64}});
+BENCHMARK(BM_SweepEstimate)->ArgNames({"isa", "orders", "levels"})->ArgsProduct({ALL_ISAS, {1024, 16384}, {4096}});
+BENCHMARK_TEMPLATE(BM_TransportSendPoll, QueueTransport)->ArgName("batch")->Arg(1)->Arg(64);
+BENCHMARK_TEMPLATE(BM_TransportSendPoll, TokenQueueTransport)->ArgName("batch")->Arg(1)->Arg(64);
+BENCHMARK_TEMPLATE(BM_TransportSendPoll, SpscRingTransport)->ArgName("batch")->Arg(1)->Arg(64);
+BENCHMARK(BM_DecodeWireOrder)->ArgName("batch")->Arg(1)->Arg(36);
+BENCHMARK(BM_RiskCheck)->ArgName("checks")->Arg(0)->Arg(1);
+
+int main(int argc, char** argv) {
+    PerfCounters probe;
+    if (!probe.ok()) {
+        std::cerr << "Hardware counters unavailable (perf_event_open refused, kperf not loaded or unsupported), reporting time only\n";
+    }
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
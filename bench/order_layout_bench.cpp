@@ -0,0 +1,103 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include "concurrentqueue.h"
+#include "memory_pool.h"
+#include "spsc_ring.h"
+#include "order.h"
+
+//Order Layout Benchmark: how many orders per second one producer can push to one consumer through each
+//transport, for the compact hot Order against the previous layout that carried its timestamps inline
+
+//the Order struct as it was before the hot/cold split: enum-sized type/side, int producer and three
+//inline timestamps, 56 bytes with padding
+struct LegacyOrder {
+    OrderID id;
+    uint32_t symbol;
+    int type;
+    int side;
+    Price price;
+    Quantity quantity;
+    int producer_id;
+    Timestamp timestamp_produce;
+    Timestamp timestamp_consume;
+    Timestamp timestamp_processed;
+};
+
+const size_t MESSAGES = 5'000'000;
+const size_t RING_CAPACITY = 1 << 16;
+
+template <typename T>
+T make_message(size_t i) {
+    T message{};
+    message.id = i;
+    message.price = static_cast<Price>(95 + i % 11);
+    message.quantity = static_cast<Quantity>(1 + i % 10);
+    return message;
+}
+
+//runs one producer and one consumer over push/pop, returns nanoseconds per message
+template <typename T, typename Push, typename Pop>
+double run_pair(Push&& push, Pop&& pop) {
+    std::atomic<bool> start{false};
+    uint64_t checksum = 0;
+    std::thread consumer([&] {
+        while (!start.load(std::memory_order_acquire)) {
+        }
+        T message;
+        for (size_t received = 0; received < MESSAGES; ) {
+            if (pop(message)) {
+                checksum += message.id;
+                ++received;
+            }
+        }
+    });
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    for (size_t i = 0; i < MESSAGES; ++i) {
+        T message = make_message<T>(i);
+        while (!push(message)) {
+        }
+    }
+    consumer.join();
+    auto end = std::chrono::steady_clock::now();
+    if (checksum != MESSAGES * (MESSAGES - 1) / 2) {
+        std::cout << "checksum mismatch\n";
+    }
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()) / MESSAGES;
+}
+
+template <typename T>
+double bench_queue() {
+    moodycamel::ConcurrentQueue<T> queue(RING_CAPACITY);
+    return run_pair<T>([&](const T& m) { return queue.enqueue(m); }, [&](T& m) { return queue.try_dequeue(m); });
+}
+
+template <typename T>
+double bench_spsc() {
+    Arena arena(SpscRing<T>::bytes_needed(RING_CAPACITY));
+    SpscRing<T> ring(arena, RING_CAPACITY);
+    return run_pair<T>([&](const T& m) { return ring.try_push(m); }, [&](T& m) { return ring.try_pop(m); });
+}
+
+void print_row(const std::string& transport, const std::string& layout, size_t bytes, double ns) {
+    std::cout << std::left << std::setw(20) << transport << std::setw(10) << layout << std::right
+              << std::setw(8) << bytes << std::setw(12) << ns << std::setw(14) << static_cast<uint64_t>(1e6 / ns)
+              << "\n";
+}
+
+int main() {
+    static_assert(sizeof(LegacyOrder) == 56, "legacy layout reference");
+    std::cout << "One producer -> one consumer, " << MESSAGES << " messages per run\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::left << std::setw(20) << "transport" << std::setw(10) << "layout" << std::right
+              << std::setw(8) << "bytes" << std::setw(12) << "ns/msg" << std::setw(14) << "k msgs/s" << "\n";
+    print_row("concurrent-queue", "legacy", sizeof(LegacyOrder), bench_queue<LegacyOrder>());
+    print_row("concurrent-queue", "compact", sizeof(Order), bench_queue<Order>());
+    print_row("spsc-ring", "legacy", sizeof(LegacyOrder), bench_spsc<LegacyOrder>());
+    print_row("spsc-ring", "compact", sizeof(Order), bench_spsc<Order>());
+    return 0;
+}
@@ -0,0 +1,202 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <pthread.h>
+#if defined(__linux__)
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#elif defined(__APPLE__)
+#include <pthread/qos.h>
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
+
+//where the simulator's threads run and where the engine's memory lives. -1 / empty / 0 mean
+//"leave it to the scheduler", which is the original behaviour
+struct ThreadPlacement {
+    std::vector<int> engine_cores;   //engine shard i runs on engine_cores[i % size()]
+    std::vector<int> producer_cores; //producer i runs on producer_cores[i % size()]
+    int realtime_priority = 0;       //SCHED_FIFO priority (1-99) for the engine, 0 = normal scheduling
+    bool numa_local = true;          //prefer each engine core's NUMA node for its shard's arena (books + transport)
+
+    int engine_core(size_t shard) const {
+        return engine_cores.empty() ? -1 : engine_cores[shard % engine_cores.size()];
+    }
+
+    int producer_core(size_t producer) const {
+        return producer_cores.empty() ? -1 : producer_cores[producer % producer_cores.size()];
+    }
+};
+
+//what a thread actually got, platforms and permissions can refuse any part of a placement
+struct PlacementResult {
+    bool pinned = false;
+    bool realtime = false;
+};
+
+//hard-pins the calling thread to one core. macOS has no hard pinning, so there the core only
+//becomes an affinity tag (a hint to keep threads with the same tag on one L2) and this returns false
+inline bool pin_current_thread(int core) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(__APPLE__)
+    thread_affinity_policy_data_t policy = {core + 1}; //tag 0 means "no affinity"
+    thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_AFFINITY_POLICY,
+                      reinterpret_cast<thread_policy_t>(&policy), THREAD_AFFINITY_POLICY_COUNT);
+    return false;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+//SCHED_FIFO on Linux (needs CAP_SYS_NICE or an rtprio limit). macOS gets the user-interactive QoS
+//class instead, which is the closest unprivileged equivalent, and reports false
+inline bool set_realtime_priority(int priority) {
+#if defined(__linux__)
+    sched_param param{};
+    param.sched_priority = priority;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#elif defined(__APPLE__)
+    (void)priority;
+    pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+    return false;
+#else
+    (void)priority;
+    return false;
+#endif
+}
+
+//applies one thread's share of a placement, called first thing on the thread itself
+inline PlacementResult place_current_thread(int core, int realtime_priority) {
+    PlacementResult result;
+    if (core >= 0) {
+        result.pinned = pin_current_thread(core);
+    }
+    if (realtime_priority > 0) {
+        result.realtime = set_realtime_priority(realtime_priority);
+    }
+    return result;
+}
+
+//parses a kernel cpu list such as "2-5,7"
+inline std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cores;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int core = first; core <= last; ++core) {
+            cores.push_back(core);
+        }
+    }
+    return cores;
+}
+
+//cores removed from the general scheduler with isolcpus=, empty when none (or not Linux)
+inline std::vector<int> isolated_cores() {
+#if defined(__linux__)
+    std::ifstream file("/sys/devices/system/cpu/isolated");
+    std::string list;
+    if (file && std::getline(file, list)) {
+        return parse_cpu_list(list);
+    }
+#endif
+    return {};
+}
+
+//NUMA node a core belongs to, -1 if unknown
+inline int numa_node_of_core(int core) {
+#if defined(__linux__)
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(core);
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        return -1;
+    }
+    int node = -1;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0) {
+            node = std::stoi(name.substr(4));
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+#else
+    (void)core;
+    return -1;
+#endif
+}
+
+//asks the kernel to back [data, data + bytes) with pages from node (MPOL_PREFERRED). only works before
+//the pages are first touched, which is why the arena is placed straight after it is created.
+//goes through the raw syscall so the build does not need libnuma
+inline bool prefer_numa_node(void* data, size_t bytes, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+    if (node < 0 || node >= 63) {
+        return false;
+    }
+    const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t start = (reinterpret_cast<uintptr_t>(data) + page - 1) & ~(page - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(data) + bytes) & ~(page - 1);
+    if (end <= start) {
+        return false;
+    }
+    const int MPOL_PREFERRED_MODE = 1;
+    unsigned long node_mask = 1UL << node;
+    return syscall(SYS_mbind, start, end - start, MPOL_PREFERRED_MODE, &node_mask, 64, 0) == 0;
+#else
+    (void)data;
+    (void)bytes;
+    (void)node;
+    return false;
+#endif
+}
+
+//what lock_process_memory got: every page mapped now, and also every page mapped later
+struct MemoryLockResult {
+    bool locked = false;
+    bool future = false;
+};
+
+//mlockall: faults in and pins every page the process has mapped, so the run never takes a page fault or
+//a swap-in on memory set up before it. pages mapped later (thread stacks) are only locked too when the
+//lock cannot run out, as root or with an unlimited RLIMIT_MEMLOCK; under a finite limit MCL_FUTURE would
+//turn a later allocation past it into a failure. Linux only
+inline MemoryLockResult lock_process_memory() {
+    MemoryLockResult result;
+#if defined(__linux__)
+    rlimit limit{};
+    bool unlimited = geteuid() == 0 || (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY);
+    if (unlimited && mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+        result.locked = result.future = true;
+    } else {
+        result.locked = mlockall(MCL_CURRENT) == 0;
+    }
+#endif
+    return result;
+}
+
+inline void unlock_process_memory() {
+#if defined(__linux__)
+    munlockall();
+#endif
+}
@@ -0,0 +1,215 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "clock.h"
+#include "order.h"
+
+//Capture file format below: a fixed header, then one fixed-size record per dequeued order in the
+//order the engine saw them. records are the hot Order as-is plus the consume time, so replaying a
+//file needs no parsing and a mapped file can be walked as an array
+constexpr char CAPTURE_MAGIC[8] = {'L', 'L', 'S', 'I', 'M', 'C', 'A', 'P'};
+//version 2: the byte holding MsgType and Side also carries the OrderType
+constexpr uint32_t CAPTURE_VERSION = 2;
+
+struct CaptureHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t record_count; //filled in when the writer is closed, 0 if the run never finished
+    uint32_t num_symbols;
+    uint32_t reserved;
+};
+static_assert(sizeof(CaptureHeader) == 32, "capture header layout is part of the file format");
+
+struct CaptureRecord {
+    Order order;
+    uint64_t offset_ns; //consume time relative to the start of the capture, drives paced replay
+};
+static_assert(sizeof(CaptureRecord) == 32, "capture record layout is part of the file format");
+
+//Capture Writer Class below
+//the engine appends records into one of a ring of buffers and hands a full buffer to a writer thread,
+//so the matching loop only ever does a 32 byte copy. if the writer falls behind by every buffer the
+//engine waits for it (counted as stalls) rather than dropping records, a capture has to be complete
+class CaptureWriter {
+public:
+    CaptureWriter(const std::string& path, uint32_t num_symbols) : start(SimClock::now()) {
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            error_message = "cannot open " + path + " for writing";
+            return;
+        }
+        CaptureHeader header{};
+        std::memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+        header.version = CAPTURE_VERSION;
+        header.record_size = sizeof(CaptureRecord);
+        header.num_symbols = num_symbols;
+        std::fwrite(&header, sizeof(header), 1, file);
+        for (auto& buffer : buffers) {
+            buffer = std::make_unique<CaptureRecord[]>(RECORDS_PER_BUFFER);
+        }
+        writer = std::thread([this] { write_loop(); });
+    }
+    ~CaptureWriter() {
+        close();
+    }
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    bool ok() const { return file != nullptr; }
+    const std::string& error() const { return error_message; }
+
+    //engine side
+    void append(const Order& order, Timestamp consume) {
+        CaptureRecord& record = buffers[current][used];
+        record.order = order;
+        record.offset_ns = static_cast<uint64_t>(SimClock::elapsed_ns(start, consume));
+        if (++used == RECORDS_PER_BUFFER) {
+            hand_off();
+        }
+    }
+
+    //flushes what is left and patches the record count into the header. engine side, once
+    void close() {
+        if (!file) {
+            return;
+        }
+        if (used > 0) {
+            hand_off();
+        }
+        stopping.store(true, std::memory_order_release);
+        writer.join();
+        std::fseek(file, offsetof(CaptureHeader, record_count), SEEK_SET);
+        std::fwrite(&records_written, sizeof(records_written), 1, file);
+        std::fclose(file);
+        file = nullptr;
+    }
+
+    uint64_t records() const { return records_handed_off + used; }
+    uint64_t stalls() const { return stall_count; }
+private:
+    static constexpr size_t BUFFER_COUNT = 4;
+    static constexpr size_t RECORDS_PER_BUFFER = (1 << 20) / sizeof(CaptureRecord); //1 MiB each
+
+    Timestamp start;
+    std::FILE* file = nullptr;
+    std::string error_message;
+    std::unique_ptr<CaptureRecord[]> buffers[BUFFER_COUNT];
+    size_t buffer_used[BUFFER_COUNT] = {};
+    size_t current = 0; //buffer the engine is filling
+    size_t used = 0;    //records in it
+    uint64_t records_handed_off = 0;
+    uint64_t stall_count = 0;
+    std::atomic<size_t> filled{0};  //buffers handed to the writer, only the engine writes it
+    std::atomic<size_t> written{0}; //buffers the writer has finished, only the writer writes it
+    std::atomic<bool> stopping{false};
+    uint64_t records_written = 0;   //writer thread only, read after join
+    std::thread writer;
+
+    void hand_off() {
+        size_t buffer = filled.load(std::memory_order_relaxed);
+        buffer_used[buffer % BUFFER_COUNT] = used;
+        records_handed_off += used;
+        used = 0;
+        current = (buffer + 1) % BUFFER_COUNT;
+        filled.store(buffer + 1, std::memory_order_release);
+        //the next buffer must have been written out before the engine can reuse it
+        if (buffer + 1 - written.load(std::memory_order_acquire) >= BUFFER_COUNT) {
+            ++stall_count;
+            while (buffer + 1 - written.load(std::memory_order_acquire) >= BUFFER_COUNT) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void write_loop() {
+        size_t next = 0;
+        while (true) {
+            if (next < filled.load(std::memory_order_acquire)) {
+                size_t count = buffer_used[next % BUFFER_COUNT];
+                std::fwrite(buffers[next % BUFFER_COUNT].get(), sizeof(CaptureRecord), count, file);
+                records_written += count;
+                written.store(++next, std::memory_order_release);
+            } else if (stopping.load(std::memory_order_acquire)) {
+                if (next == filled.load(std::memory_order_acquire)) {
+                    return;
+                }
+            } else {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+};
+
+//Mapped Capture Class below
+//read-only mapping of a capture file, walked in place by the replay loop
+class MappedCapture {
+public:
+    explicit MappedCapture(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error_message = "cannot open " + path;
+            return;
+        }
+        struct stat info {};
+        if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(CaptureHeader)) {
+            error_message = path + " is too small to be a capture";
+            ::close(fd);
+            return;
+        }
+        size_t bytes = static_cast<size_t>(info.st_size);
+        void* data = ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            error_message = "cannot map " + path;
+            return;
+        }
+        mapping = data;
+        mapped_bytes = bytes;
+        ::madvise(mapping, mapped_bytes, MADV_SEQUENTIAL);
+        const auto* header = static_cast<const CaptureHeader*>(mapping);
+        if (std::memcmp(header->magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0
+            || header->version != CAPTURE_VERSION || header->record_size != sizeof(CaptureRecord)) {
+            error_message = path + " is not a version " + std::to_string(CAPTURE_VERSION) + " capture";
+            return;
+        }
+        //a capture cut short (no count in the header) is still usable up to its last whole record
+        uint64_t on_disk = (mapped_bytes - sizeof(CaptureHeader)) / sizeof(CaptureRecord);
+        count = header->record_count == 0 ? on_disk : std::min<uint64_t>(header->record_count, on_disk);
+        symbols = header->num_symbols;
+        first = reinterpret_cast<const CaptureRecord*>(static_cast<const char*>(mapping) + sizeof(CaptureHeader));
+    }
+    ~MappedCapture() {
+        if (mapping) {
+            ::munmap(mapping, mapped_bytes);
+        }
+    }
+    MappedCapture(const MappedCapture&) = delete;
+    MappedCapture& operator=(const MappedCapture&) = delete;
+
+    bool ok() const { return first != nullptr; }
+    const std::string& error() const { return error_message; }
+
+    const CaptureRecord* records() const { return first; }
+    uint64_t size() const { return count; }
+    uint32_t num_symbols() const { return symbols; }
+private:
+    void* mapping = nullptr;
+    size_t mapped_bytes = 0;
+    const CaptureRecord* first = nullptr;
+    uint64_t count = 0;
+    uint32_t symbols = 0;
+    std::string error_message;
+};
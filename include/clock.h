@@ -0,0 +1,245 @@
+#pragma once
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+#include "affinity.h"
+
+//Clock sources below. both expose the same static interface and return raw uint64 ticks,
+//so the Timestamp alias in order.h can point at either one without touching the hot path:
+//  now()            cheapest read, used for produce/consume stamps
+//  now_serialized() waits for earlier instructions to retire, used to close a measured region
+//  elapsed_ns(a, b) converts the tick difference b - a to nanoseconds (negative if b is earlier)
+
+//steady_clock in nanoseconds, the portable fallback
+class SteadyClock {
+public:
+    using Timestamp = uint64_t;
+    static constexpr const char* NAME = "steady_clock";
+
+    static Timestamp now() {
+        return static_cast<Timestamp>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    static Timestamp now_serialized() {
+        return now();
+    }
+    static long long elapsed_ns(Timestamp from, Timestamp to) {
+        return static_cast<long long>(to - from);
+    }
+    static Timestamp ticks_from_ns(long long ns) {
+        return static_cast<Timestamp>(ns);
+    }
+    static void calibrate() {}
+    static double ticks_per_ns() { return 1.0; }
+    static bool invariant() { return true; }
+};
+
+//invariant TSC on x86 (rdtsc/rdtscp) and the generic timer on arm64 (cntvct_el0), calibrated
+//against steady_clock at startup. conversion is a 64x64->128 bit multiply and a shift
+class TscClock {
+public:
+    using Timestamp = uint64_t;
+#if defined(__x86_64__) || defined(__i386__)
+    static constexpr const char* NAME = "tsc (rdtsc)";
+#elif defined(__aarch64__)
+    static constexpr const char* NAME = "tsc (cntvct_el0)";
+#else
+    static constexpr const char* NAME = "steady_clock (no tsc on this target)";
+#endif
+
+    static Timestamp now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t ticks;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+        return ticks;
+#else
+        return SteadyClock::now();
+#endif
+    }
+
+    static Timestamp now_serialized() {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned aux;
+        return __rdtscp(&aux);
+#elif defined(__aarch64__)
+        uint64_t ticks;
+        asm volatile("isb\n\tmrs %0, cntvct_el0" : "=r"(ticks) : : "memory");
+        return ticks;
+#else
+        return SteadyClock::now();
+#endif
+    }
+
+    static long long elapsed_ns(Timestamp from, Timestamp to) {
+        if (to >= from) {
+            return static_cast<long long>(scale(to - from));
+        }
+        return -static_cast<long long>(scale(from - to));
+    }
+
+    static Timestamp ticks_from_ns(long long ns) {
+        return static_cast<Timestamp>(static_cast<double>(ns) * ticks_per_nanosecond);
+    }
+
+    //measures the tick rate against steady_clock. on arm64 the counter frequency is architectural,
+    //so cntfrq_el0 is used directly and the measurement only confirms it
+    static void calibrate(std::chrono::milliseconds window = std::chrono::milliseconds(100)) {
+        double rate = 1.0;
+#if defined(__aarch64__)
+        uint64_t frequency;
+        asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+        rate = static_cast<double>(frequency) / 1e9;
+#elif defined(__x86_64__) || defined(__i386__)
+        auto wall_start = std::chrono::steady_clock::now();
+        Timestamp tick_start = now_serialized();
+        while (std::chrono::steady_clock::now() - wall_start < window) {
+        }
+        Timestamp tick_end = now_serialized();
+        auto wall_end = std::chrono::steady_clock::now();
+        double wall_ns = static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(wall_end - wall_start).count());
+        rate = static_cast<double>(tick_end - tick_start) / wall_ns;
+#endif
+        (void)window;
+        ticks_per_nanosecond = rate;
+        ns_per_tick_fixed = static_cast<uint64_t>((1.0 / rate) * static_cast<double>(1ULL << FIXED_SHIFT));
+    }
+
+    static double ticks_per_ns() { return ticks_per_nanosecond; }
+
+    //x86: cpuid 0x80000007 EDX bit 8 means the TSC rate is constant across P/C-states.
+    //the arm64 generic timer is always constant rate
+    static bool invariant() {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        return (edx & (1u << 8)) != 0;
+#elif defined(__aarch64__)
+        return true;
+#else
+        return false;
+#endif
+    }
+private:
+    static constexpr unsigned FIXED_SHIFT = 32;
+    static inline double ticks_per_nanosecond = 1.0;
+    static inline uint64_t ns_per_tick_fixed = 1ULL << FIXED_SHIFT;
+
+    static uint64_t scale(uint64_t ticks) {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(ticks) * ns_per_tick_fixed) >> FIXED_SHIFT);
+    }
+};
+
+//result of comparing the clock between the calling thread's core and every other core
+struct ClockDriftReport {
+    int reference_core = -1;     //first core of the process's affinity mask, the one the others are checked from
+    int cores_checked = 0;       //cores a responder could be pinned to, the only ones the skew covers
+    int cores_unpinned = 0;      //cores in the mask a responder could not be pinned to, left out
+    long long max_skew_ns = 0;   //largest offset that the round trips could prove
+    long long round_trip_ns = 0; //smallest round trip seen, the precision of the check
+    bool supported = true;       //false when threads cannot be pinned on this platform
+};
+
+//Cross-core drift check: the calling thread is pinned to the first core of the process's affinity mask (which
+//need not be core 0 under taskset or a cpuset) and a thread pinned to each other core in the mask answers its
+//ping-pongs. for a round trip t0 (reference) -> t1 (core N) -> t2 (reference), a synchronised clock gives
+//t0 <= t1 <= t2, so any t1 outside [t0, t2] is skew that can be proven, and the best round trip bounds the
+//precision. a responder that cannot be pinned would measure whatever core it lands on, so it is left out
+template <typename Clock>
+ClockDriftReport check_cross_core_drift(int rounds = 1000) {
+    ClockDriftReport report;
+#if defined(__linux__)
+    auto pin = pin_current_thread;
+    cpu_set_t original;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(original), &original) != 0) {
+        report.supported = false;
+        return report;
+    }
+    std::vector<int> cores;
+    for (int core = 0; core < CPU_SETSIZE; ++core) {
+        if (CPU_ISSET(core, &original)) {
+            cores.push_back(core);
+        }
+    }
+    if (cores.empty() || !pin(cores.front())) {
+        report.supported = false;
+        return report;
+    }
+    report.reference_core = cores.front();
+    long long best_round_trip = -1;
+    for (size_t c = 1; c < cores.size(); ++c) {
+        int core = cores[c];
+        enum : int { PINNING, PINNED, UNPINNED };
+        std::atomic<int> placed{PINNING};
+        std::atomic<int> turn{0};
+        std::atomic<uint64_t> remote_ticks{0};
+        std::thread responder([&] {
+            if (!pin(core)) {
+                placed.store(UNPINNED, std::memory_order_release);
+                return;
+            }
+            placed.store(PINNED, std::memory_order_release);
+            for (int i = 0; i < rounds; ++i) {
+                while (turn.load(std::memory_order_acquire) != 1) {
+                }
+                remote_ticks.store(Clock::now_serialized(), std::memory_order_relaxed);
+                turn.store(0, std::memory_order_release);
+            }
+        });
+        int state;
+        while ((state = placed.load(std::memory_order_acquire)) == PINNING) {
+        }
+        if (state == UNPINNED) {
+            responder.join();
+            ++report.cores_unpinned;
+            continue;
+        }
+        for (int i = 0; i < rounds; ++i) {
+            uint64_t t0 = Clock::now_serialized();
+            turn.store(1, std::memory_order_release);
+            while (turn.load(std::memory_order_acquire) != 0) {
+            }
+            uint64_t t2 = Clock::now_serialized();
+            uint64_t t1 = remote_ticks.load(std::memory_order_relaxed);
+            long long round_trip = Clock::elapsed_ns(t0, t2);
+            if (best_round_trip < 0 || round_trip < best_round_trip) {
+                best_round_trip = round_trip;
+            }
+            long long skew = 0;
+            if (t1 < t0) {
+                skew = Clock::elapsed_ns(t1, t0);
+            } else if (t1 > t2) {
+                skew = Clock::elapsed_ns(t2, t1);
+            }
+            report.max_skew_ns = std::max(report.max_skew_ns, skew);
+        }
+        responder.join();
+        ++report.cores_checked;
+    }
+    report.round_trip_ns = best_round_trip < 0 ? 0 : best_round_trip;
+    pthread_setaffinity_np(pthread_self(), sizeof(original), &original);
+#else
+    //macOS offers no hard pinning, so the check cannot place a thread on a given core
+    (void)rounds;
+    report.supported = false;
+#endif
+    return report;
+}
+
+//the clock every timestamp in the simulator comes from, chosen at build time (LLSIM_USE_TSC in CMake)
+#if defined(LLSIM_CLOCK_TSC)
+using SimClock = TscClock;
+#else
+using SimClock = SteadyClock;
+#endif
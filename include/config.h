@@ -0,0 +1,274 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <utility>
+#include <functional>
+#include <initializer_list>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <limits>
+#include <type_traits>
+
+//Scenario configuration below: key = value settings from scenario files and --key=value arguments.
+//a file has one setting per line with # comments, later settings override earlier ones, so
+//`--config=a.conf --rate=50000` runs a.conf with a different rate
+
+//one setting and where it came from, for error messages
+struct ConfigEntry {
+    std::string key;
+    std::string value;
+    std::string source; //"file:line" or "command line"
+};
+
+inline std::string trim(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        return "";
+    }
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+//Config Class below
+//collects entries in the order they were given, the caller decides what each key means
+class Config {
+public:
+    //profile_dir is where --profile=<name> looks for <name>.conf
+    explicit Config(std::string profile_dir) : profile_dir(std::move(profile_dir)) {}
+
+    bool load_file(const std::string& path, std::string& error) {
+        std::ifstream file(path);
+        if (!file) {
+            error = "cannot open scenario file " + path;
+            return false;
+        }
+        std::string line;
+        for (int number = 1; std::getline(file, line); ++number) {
+            line = trim(line.substr(0, line.find('#')));
+            if (line.empty()) {
+                continue;
+            }
+            size_t equals = line.find('=');
+            std::string source = path + ":" + std::to_string(number);
+            if (equals == std::string::npos) {
+                error = source + ": expected key = value";
+                return false;
+            }
+            add(trim(line.substr(0, equals)), trim(line.substr(equals + 1)), source);
+        }
+        return true;
+    }
+
+    //--key=value or --key value, plus --config=<file>, --profile=<name> and --help
+    bool parse_args(int argc, char** argv, std::string& error) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                help_requested = true;
+                continue;
+            }
+            if (arg.compare(0, 2, "--") != 0 || arg.size() == 2) {
+                error = "unexpected argument " + arg + " (settings are --key=value)";
+                return false;
+            }
+            std::string key = arg.substr(2);
+            std::string value;
+            size_t equals = key.find('=');
+            if (equals != std::string::npos) {
+                value = key.substr(equals + 1);
+                key = key.substr(0, equals);
+            } else if (i + 1 < argc) {
+                value = argv[++i];
+            } else {
+                error = "--" + key + " needs a value";
+                return false;
+            }
+            if (key == "config") {
+                if (!load_file(value, error)) {
+                    return false;
+                }
+            } else if (key == "profile") {
+                if (!load_file(profile_dir + "/" + value + ".conf", error)) {
+                    return false;
+                }
+            } else {
+                add(key, value, "command line");
+            }
+        }
+        return true;
+    }
+
+    void add(const std::string& key, const std::string& value, const std::string& source) {
+        entries_list.push_back(ConfigEntry{key, value, source});
+    }
+
+    const std::vector<ConfigEntry>& entries() const { return entries_list; }
+    bool help() const { return help_requested; }
+private:
+    std::string profile_dir;
+    std::vector<ConfigEntry> entries_list;
+    bool help_requested = false;
+};
+
+//Value parsing below: each returns false when the text is not a valid value of the type
+
+inline bool parse_value(const std::string& text, long long& out) {
+    errno = 0;
+    char* end = nullptr;
+    long long value = std::strtoll(text.c_str(), &end, 10);
+    if (text.empty() || errno != 0 || *end != '\0') {
+        return false;
+    }
+    out = value;
+    return true;
+}
+
+inline bool parse_value(const std::string& text, double& out) {
+    errno = 0;
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (text.empty() || errno != 0 || *end != '\0') {
+        return false;
+    }
+    out = value;
+    return true;
+}
+
+inline bool parse_value(const std::string& text, bool& out) {
+    if (text == "true" || text == "on" || text == "yes" || text == "1") {
+        out = true;
+    } else if (text == "false" || text == "off" || text == "no" || text == "0") {
+        out = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline bool parse_value(const std::string& text, std::string& out) {
+    out = text;
+    return true;
+}
+
+//every other integer type, range checked
+template <typename T>
+std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, long long>, bool>
+parse_value(const std::string& text, T& out) {
+    long long value = 0;
+    if (!parse_value(text, value) || value < static_cast<long long>(std::numeric_limits<T>::min())
+        || static_cast<unsigned long long>(value) > static_cast<unsigned long long>(std::numeric_limits<T>::max())) {
+        return false;
+    }
+    out = static_cast<T>(value);
+    return true;
+}
+
+//a number with an optional ns/us/ms/s suffix, a bare number is in the duration's own unit
+template <typename Rep, typename Period>
+bool parse_value(const std::string& text, std::chrono::duration<Rep, Period>& out) {
+    size_t digits = text.find_first_not_of("0123456789.");
+    std::string number = text.substr(0, digits);
+    std::string unit = digits == std::string::npos ? "" : text.substr(digits);
+    double value = 0.0;
+    if (!parse_value(number, value)) {
+        return false;
+    }
+    using Nanos = std::chrono::duration<double, std::nano>;
+    Nanos nanos;
+    if (unit.empty()) {
+        nanos = std::chrono::duration<double, Period>(value);
+    } else if (unit == "ns") {
+        nanos = Nanos(value);
+    } else if (unit == "us") {
+        nanos = std::chrono::duration<double, std::micro>(value);
+    } else if (unit == "ms") {
+        nanos = std::chrono::duration<double, std::milli>(value);
+    } else if (unit == "s") {
+        nanos = std::chrono::duration<double>(value);
+    } else {
+        return false;
+    }
+    out = std::chrono::duration_cast<std::chrono::duration<Rep, Period>>(nanos);
+    return true;
+}
+
+//comma separated, "" is an empty list
+template <typename T>
+bool parse_value(const std::string& text, std::vector<T>& out) {
+    std::vector<T> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        T value{};
+        if (!parse_value(trim(item), value)) {
+            return false;
+        }
+        values.push_back(value);
+    }
+    out = std::move(values);
+    return true;
+}
+
+//Config Key below: one setting a Target understands, bound to the field it sets
+template <typename Target>
+struct ConfigKey {
+    const char* key;
+    const char* help;
+    std::function<bool(Target&, const std::string&)> apply;
+};
+
+//a key that parses straight into the field field(target) refers to
+template <typename Target, typename Field>
+ConfigKey<Target> config_key(const char* key, const char* help, Field field) {
+    return ConfigKey<Target>{key, help, [field](Target& target, const std::string& text) {
+        return parse_value(text, field(target));
+    }};
+}
+
+//a key that takes one of a fixed set of names, Enum is the field's own type
+template <typename Target, typename Field, typename Enum = std::decay_t<std::invoke_result_t<Field, Target&>>>
+ConfigKey<Target> config_choice(const char* key, const char* help, Field field,
+                                std::initializer_list<std::pair<const char*, Enum>> choices) {
+    std::vector<std::pair<std::string, Enum>> names(choices.begin(), choices.end());
+    return ConfigKey<Target>{key, help, [field, names](Target& target, const std::string& text) {
+        for (const auto& [name, value] : names) {
+            if (text == name) {
+                field(target) = value;
+                return true;
+            }
+        }
+        return false;
+    }};
+}
+
+//applies one setting, error names the key and where it came from
+template <typename Target>
+bool apply_config_entry(const std::vector<ConfigKey<Target>>& keys, Target& target, const ConfigEntry& entry,
+                        std::string& error) {
+    for (const ConfigKey<Target>& key : keys) {
+        if (entry.key == key.key) {
+            if (key.apply(target, entry.value)) {
+                return true;
+            }
+            error = entry.source + ": bad value '" + entry.value + "' for " + entry.key + " (" + key.help + ")";
+            return false;
+        }
+    }
+    error = entry.source + ": unknown setting " + entry.key + " (--help lists them)";
+    return false;
+}
+
+template <typename Target>
+void print_config_keys(const std::vector<ConfigKey<Target>>& keys) {
+    for (const ConfigKey<Target>& key : keys) {
+        std::cout << "  --" << std::left << std::setw(26) << key.key << key.help << "\n";
+    }
+    std::cout << std::right;
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include "order.h"
+#include "memory_pool.h"
+#include "spsc_ring.h"
+#include "latency_histogram.h"
+#include "price_level.h"
+#include "journal.h"
+
+//what happened to a message
+enum class ExecType {
+    ACK,          //the (remaining) quantity now rests in the book
+    PARTIAL_FILL, //some quantity traded, some is still working
+    FILL,         //nothing left to trade
+    CANCELED,     //by request, or an IOC/market remainder and a FOK that could not fill
+    MODIFIED,
+    REJECTED      //unknown id on cancel/modify, no pool space to rest the order, or a post-only order that would trade
+};
+
+inline const char* to_string(ExecType type) {
+    switch (type) {
+        case ExecType::ACK: return "ack";
+        case ExecType::PARTIAL_FILL: return "partial fill";
+        case ExecType::FILL: return "fill";
+        case ExecType::CANCELED: return "canceled";
+        case ExecType::MODIFIED: return "modified";
+        case ExecType::REJECTED: return "rejected";
+    }
+    return "?";
+}
+
+//one report to one producer. final_report marks the last report the engine sends for a message,
+//which is what closes the round trip on the producer side
+struct ExecutionReport {
+    OrderID id;
+    SymbolID symbol;
+    ExecType type;
+    Side side;
+    Price price;                 //fill price, or the order price for acks
+    Quantity last_quantity;      //traded in this report, 0 for acks/cancels/rejects
+    Quantity leaves_quantity;    //still working after this report
+    bool passive;                //the resting side of a fill, caused by someone else's order
+    bool final_report;
+    Timestamp timestamp_produce; //produce stamp of the message that caused the report
+    Timestamp timestamp_report;  //when the engine emitted it
+};
+
+using ReportRing = SpscRing<ExecutionReport>;
+
+//Execution Reporter Class below
+//the engine side of the return path: one SPSC ring per producer, carved from the shard's arena, so
+//emitting a report is a copy into a preallocated slot. the engine never waits on a slow producer:
+//if its ring is full the report is dropped and counted instead
+class ExecutionReporter {
+public:
+    ExecutionReporter(Arena& arena, size_t num_producers, size_t capacity_per_producer) {
+        rings.reserve(num_producers);
+        for (size_t i = 0; i < num_producers; ++i) {
+            rings.push_back(std::make_unique<ReportRing>(arena, capacity_per_producer));
+        }
+    }
+    ExecutionReporter(const ExecutionReporter&) = delete;
+    ExecutionReporter& operator=(const ExecutionReporter&) = delete;
+
+    static size_t bytes_needed(size_t num_producers, size_t capacity_per_producer) {
+        return num_producers * ReportRing::bytes_needed(capacity_per_producer);
+    }
+
+    //called by the engine before each message, the hot Order does not carry its produce stamp
+    void begin(Timestamp produce) {
+        current_produce = produce;
+    }
+
+    //trades also go to journal when one is attached, reports or not
+    void attach_journal(JournalWriter* writer) {
+        journal = writer;
+    }
+
+    //one match: a report to the resting order's owner and one to the aggressor.
+    //called after the quantities are updated and before a filled resting node is released
+    void fill(const Order& aggressor, const OrderNode& resting, Price price, Quantity matched, Quantity remaining) {
+        ++fill_count;
+        if (journal) {
+            journal->trade(aggressor.id, resting.id, price, matched);
+        }
+        Timestamp now = SimClock::now();
+        emit(resting.producer_id, ExecutionReport{resting.id, aggressor.symbol,
+             resting.quantity == 0 ? ExecType::FILL : ExecType::PARTIAL_FILL, resting.side, price, matched,
+             resting.quantity, true, false, current_produce, now});
+        emit(aggressor.producer_id, ExecutionReport{aggressor.id, aggressor.symbol,
+             remaining == 0 ? ExecType::FILL : ExecType::PARTIAL_FILL, aggressor.side, price, matched,
+             remaining, false, remaining == 0, current_produce, now});
+    }
+
+    //final report for a message that did not end in a full fill: ACK, CANCELED, MODIFIED or REJECTED
+    void done(const Order& order, ExecType type, Quantity leaves) {
+        emit(order.producer_id, ExecutionReport{order.id, order.symbol, type, order.side, order.price, 0, leaves,
+             false, true, current_produce, SimClock::now()});
+    }
+
+    ReportRing& ring(size_t producer) { return *rings[producer]; }
+    uint64_t dropped() const { return dropped_reports; }
+    uint64_t fills() const { return fill_count; }
+private:
+    std::vector<std::unique_ptr<ReportRing>> rings;
+    JournalWriter* journal = nullptr;
+    uint64_t dropped_reports = 0;
+    uint64_t fill_count = 0;
+    Timestamp current_produce = 0;
+
+    void emit(int producer, const ExecutionReport& report) {
+        if (producer < 0 || static_cast<size_t>(producer) >= rings.size()) {
+            return;
+        }
+        if (!rings[static_cast<size_t>(producer)]->try_push(report)) {
+            ++dropped_reports;
+        }
+    }
+};
+
+//producer-side view of the return path, filled in as reports arrive
+struct RoundTripStats {
+    uint64_t reports = 0;
+    LatencyHistogram round_trip;  //produce -> final report received, for the producer's own messages
+    LatencyHistogram return_leg;  //engine emit -> received, every report
+    LatencyHistogram passive_fill; //someone else's order produced -> our resting order's fill received
+
+    //stamps receipt of a bulk of reports, counting only those caused by a message produced in [from, until)
+    void receive(const ExecutionReport* batch, size_t count, Timestamp from = 0, Timestamp until = ~Timestamp{0}) {
+        Timestamp now = SimClock::now();
+        for (size_t i = 0; i < count; ++i) {
+            const ExecutionReport& report = batch[i];
+            if (report.timestamp_produce < from || report.timestamp_produce >= until) {
+                continue;
+            }
+            ++reports;
+            return_leg.record_ns(SimClock::elapsed_ns(report.timestamp_report, now));
+            if (report.passive) {
+                passive_fill.record_ns(SimClock::elapsed_ns(report.timestamp_produce, now));
+            } else if (report.final_report) {
+                round_trip.record_ns(SimClock::elapsed_ns(report.timestamp_produce, now));
+            }
+        }
+    }
+};
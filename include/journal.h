@@ -0,0 +1,434 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "clock.h"
+#include "order.h"
+#include "memory_pool.h"
+#include "spsc_ring.h"
+#include "price_level.h"
+#include "latency_histogram.h"
+
+//Journal file format below: a fixed header, then one fixed-size record per event in the order the engine
+//produced them. ORDER is a message the engine accepted (after any risk checks), TRADE a match it caused,
+//and SNAPSHOT_BEGIN / SNAPSHOT_ORDER... / SNAPSHOT_END every resting order of the shard's books at one point.
+//sequence numbers run 0, 1, 2... and every record carries a checksum, so a reader stops at the first torn or
+//missing record: the durable prefix. recovery loads the last complete snapshot and replays the ORDER records
+//after it
+constexpr char JOURNAL_MAGIC[8] = {'L', 'L', 'S', 'I', 'M', 'J', 'R', 'N'};
+constexpr uint32_t JOURNAL_VERSION = 1;
+
+struct JournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t num_symbols;
+    uint32_t reserved[3];
+};
+static_assert(sizeof(JournalHeader) == 32, "journal header layout is part of the file format");
+
+enum class JournalEvent : uint8_t { ORDER, TRADE, SNAPSHOT_BEGIN, SNAPSHOT_ORDER, SNAPSHOT_END };
+
+//one match, following the ORDER record of the aggressor that caused it
+struct JournalTrade {
+    OrderID aggressor;
+    OrderID resting;
+    Price price;
+    Quantity quantity;
+};
+
+struct JournalRecord {
+    uint64_t sequence;
+    uint64_t offset_ns; //engine time relative to the start of the journal
+    uint32_t checksum;  //of every other byte, filled in by the writer thread
+    JournalEvent kind;
+    uint8_t reserved[3];
+    union {
+        Order order;        //ORDER and SNAPSHOT_ORDER (a resting order as a NEW limit order)
+        JournalTrade trade; //TRADE
+    };
+};
+static_assert(sizeof(JournalRecord) == 48, "journal record layout is part of the file format");
+
+//FNV-1a over the record with the checksum field left out
+inline uint32_t journal_checksum(const JournalRecord& record) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&record);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(JournalRecord); ++i) {
+        if (i == offsetof(JournalRecord, checksum)) {
+            i += sizeof(record.checksum) - 1;
+            continue;
+        }
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+//when the writer thread makes what it wrote durable: never (the page cache only, synced once at close),
+//after every batch it writes (everything that queued up during the previous sync goes in one group commit),
+//or at most once per commit interval
+enum class JournalSync { NONE, BATCH, INTERVAL };
+
+inline const char* to_string(JournalSync sync) {
+    switch (sync) {
+        case JournalSync::NONE: return "none";
+        case JournalSync::BATCH: return "batch";
+        case JournalSync::INTERVAL: return "interval";
+    }
+    return "?";
+}
+
+//what a journal did over a run
+struct JournalStats {
+    uint64_t records = 0;
+    uint64_t snapshots = 0;
+    uint64_t stalls = 0; //appends that found the ring full and waited for the writer
+    uint64_t writes = 0;
+    uint64_t syncs = 0;
+    uint64_t bytes = 0;
+    uint64_t write_errors = 0;
+    bool direct = false; //O_DIRECT was asked for and the file system took it
+    LatencyHistogram sync_time; //one fdatasync call
+    LatencyHistogram durable;   //engine append -> synced, or -> written with JournalSync::NONE
+
+    void add(const JournalStats& other) {
+        records += other.records;
+        snapshots += other.snapshots;
+        stalls += other.stalls;
+        writes += other.writes;
+        syncs += other.syncs;
+        bytes += other.bytes;
+        write_errors += other.write_errors;
+        direct = direct || other.direct;
+        sync_time.merge(other.sync_time);
+        durable.merge(other.durable);
+    }
+};
+
+//Journal Writer Class below
+//the engine appends records into an SPSC ring carved from its shard's arena, a copy and an index publish,
+//and never waits on the disk: a writer thread drains the ring into a staging buffer, writes it with one
+//pwrite and syncs it according to the JournalSync policy. like a capture, a journal has to be complete, so
+//if the writer falls a whole ring behind the engine waits (counted as stalls) instead of dropping records.
+//with direct set the file is opened O_DIRECT and written in whole 4 KiB blocks from an aligned buffer, the
+//last partial block rewritten by the next write, and truncated to its real length at close.
+//the writer is the seam for an io_uring submission path (linked write + fdatasync per group), it only needs
+//to replace write_staged() and sync()
+class JournalWriter {
+public:
+    JournalWriter(Arena& arena, const std::string& path, uint32_t num_symbols, size_t ring_capacity,
+                  JournalSync sync_policy, std::chrono::microseconds commit_interval, bool direct,
+                  uint64_t snapshot_every)
+        : ring(arena, ring_capacity), policy(sync_policy),
+          interval_ns(std::chrono::duration_cast<std::chrono::nanoseconds>(commit_interval).count()),
+          snapshot_every(snapshot_every), start(SimClock::now()) {
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+        if (direct) {
+            fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+            counts.direct = fd >= 0;
+        }
+#endif
+        if (fd < 0) {
+            fd = ::open(path.c_str(), flags, 0644);
+        }
+        if (fd < 0) {
+            error_message = "cannot open " + path + " for writing";
+            return;
+        }
+        block = counts.direct ? DIRECT_BLOCK : 1;
+        staging = static_cast<unsigned char*>(std::aligned_alloc(DIRECT_BLOCK, STAGING_BYTES));
+        JournalHeader header{};
+        std::memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+        header.version = JOURNAL_VERSION;
+        header.record_size = sizeof(JournalRecord);
+        header.num_symbols = num_symbols;
+        std::memcpy(staging, &header, sizeof(header));
+        staged = sizeof(header);
+        unsynced.reserve(ring.capacity());
+        writer = std::thread([this] { write_loop(); });
+    }
+    ~JournalWriter() {
+        close();
+        std::free(staging);
+    }
+    JournalWriter(const JournalWriter&) = delete;
+    JournalWriter& operator=(const JournalWriter&) = delete;
+
+    static size_t bytes_needed(size_t ring_capacity) {
+        return SpscRing<JournalRecord>::bytes_needed(ring_capacity);
+    }
+
+    bool ok() const { return fd >= 0; }
+    const std::string& error() const { return error_message; }
+
+    //engine side below
+
+    //an accepted message, before the book processes it. its trades follow through trade()
+    void order(const Order& order, Timestamp consume) {
+        current_offset = static_cast<uint64_t>(SimClock::elapsed_ns(start, consume));
+        JournalRecord record = make(JournalEvent::ORDER);
+        record.order = order;
+        append(record);
+        ++orders_since_snapshot;
+    }
+
+    void trade(OrderID aggressor, OrderID resting, Price price, Quantity quantity) {
+        JournalRecord record = make(JournalEvent::TRADE);
+        record.trade = JournalTrade{aggressor, resting, price, quantity};
+        append(record);
+    }
+
+    bool snapshot_due() const {
+        return snapshot_every > 0 && orders_since_snapshot >= snapshot_every;
+    }
+
+    //every resting order of the given books, in an order that rebuilds them. the engine is inside this for
+    //as long as it takes to copy the books into the ring
+    template <typename Book>
+    void snapshot(const std::vector<std::unique_ptr<Book>>& books, const std::vector<SymbolID>& symbols) {
+        current_offset = static_cast<uint64_t>(SimClock::elapsed_ns(start, SimClock::now()));
+        append(make(JournalEvent::SNAPSHOT_BEGIN));
+        for (SymbolID symbol : symbols) {
+            books[symbol]->for_each_resting([&](const OrderNode& node, Price price) {
+                JournalRecord record = make(JournalEvent::SNAPSHOT_ORDER);
+                record.order = Order{};
+                record.order.id = node.id;
+                record.order.price = price;
+                record.order.quantity = node.quantity;
+                record.order.symbol = symbol;
+                record.order.producer_id = static_cast<uint8_t>(node.producer_id);
+                record.order.type = MsgType::NEW;
+                record.order.side = node.side;
+                record.order.order_type = OrderType::LIMIT;
+                append(record);
+            });
+        }
+        append(make(JournalEvent::SNAPSHOT_END));
+        orders_since_snapshot = 0;
+        ++counts.snapshots;
+    }
+
+    //stops the writer once it has written and synced everything appended. engine side, once
+    void close() {
+        if (fd < 0) {
+            return;
+        }
+        stopping.store(true, std::memory_order_release);
+        writer.join();
+        ::close(fd);
+        fd = -1;
+    }
+
+    //read once closed
+    const JournalStats& stats() const { return counts; }
+private:
+    static constexpr size_t DIRECT_BLOCK = 4096;
+    static constexpr size_t STAGING_BYTES = 1 << 20;
+
+    SpscRing<JournalRecord> ring;
+    JournalSync policy;
+    long long interval_ns;
+    uint64_t snapshot_every;
+    Timestamp start;
+    //engine side
+    uint64_t next_sequence = 0;
+    uint64_t current_offset = 0; //of the message being processed, trades share it
+    uint64_t orders_since_snapshot = 0;
+    //writer side
+    int fd = -1;
+    size_t block = 1;              //write granularity: 1, or DIRECT_BLOCK with O_DIRECT
+    unsigned char* staging = nullptr;
+    size_t staged = 0;             //bytes in staging, starting at file offset written
+    uint64_t written = 0;          //file offset of staging[0], always a multiple of block
+    bool dirty = false;            //staging holds records not written yet
+    std::vector<uint64_t> unsynced; //offset_ns of records written but not yet durable
+    std::atomic<bool> stopping{false};
+    std::string error_message;
+    JournalStats counts; //records and snapshots by the engine, the rest by the writer until joined
+    std::thread writer;
+
+    JournalRecord make(JournalEvent kind) {
+        JournalRecord record{};
+        record.sequence = next_sequence++;
+        record.offset_ns = current_offset;
+        record.kind = kind;
+        return record;
+    }
+
+    void append(const JournalRecord& record) {
+        if (!ring.try_push(record)) {
+            ++counts.stalls;
+            while (!ring.try_push(record)) {
+                std::this_thread::yield();
+            }
+        }
+        ++counts.records;
+    }
+
+    void write_loop() {
+        Timestamp last_sync = SimClock::now();
+        while (true) {
+            //read before draining, so everything appended before close() is in this pass or an earlier one
+            bool stop = stopping.load(std::memory_order_acquire);
+            size_t room = (STAGING_BYTES - staged) / sizeof(JournalRecord);
+            auto* out = reinterpret_cast<JournalRecord*>(staging + staged);
+            size_t count = ring.try_pop_bulk(out, room);
+            for (size_t i = 0; i < count; ++i) {
+                out[i].checksum = journal_checksum(out[i]);
+                unsynced.push_back(out[i].offset_ns);
+            }
+            staged += count * sizeof(JournalRecord);
+            dirty = dirty || count > 0;
+            //write once the ring is drained or the staging buffer is full
+            if (dirty && (count < room || staged + sizeof(JournalRecord) > STAGING_BYTES)) {
+                write_staged();
+                if (policy == JournalSync::BATCH) {
+                    sync();
+                } else if (policy == JournalSync::NONE) {
+                    record_durable();
+                }
+            }
+            if (policy == JournalSync::INTERVAL && !unsynced.empty()
+                && SimClock::elapsed_ns(last_sync, SimClock::now()) >= interval_ns) {
+                sync();
+                last_sync = SimClock::now();
+            }
+            if (count == 0) {
+                if (stop) {
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+        if (dirty) {
+            write_staged();
+        }
+        sync();
+        if (block > 1 && ::ftruncate(fd, static_cast<off_t>(written + staged)) != 0) {
+            ++counts.write_errors;
+        }
+    }
+
+    //one pwrite of everything staged, padded to whole blocks. a partial last block stays staged and is
+    //written again, with whatever follows it, by the next call
+    void write_staged() {
+        size_t length = (staged + block - 1) / block * block;
+        std::memset(staging + staged, 0, length - staged);
+        if (::pwrite(fd, staging, length, static_cast<off_t>(written)) != static_cast<ssize_t>(length)) {
+            ++counts.write_errors;
+        }
+        ++counts.writes;
+        counts.bytes += staged;
+        size_t keep = staged % block;
+        size_t advance = staged - keep;
+        std::memmove(staging, staging + advance, keep);
+        written += advance;
+        staged = keep;
+        counts.bytes -= keep; //counted again when rewritten
+        dirty = false;
+    }
+
+    void sync() {
+        Timestamp begin = SimClock::now();
+#if defined(__APPLE__)
+        int result = ::fsync(fd);
+#else
+        int result = ::fdatasync(fd);
+#endif
+        if (result != 0) {
+            ++counts.write_errors;
+        }
+        counts.sync_time.record_ns(SimClock::elapsed_ns(begin, SimClock::now()));
+        ++counts.syncs;
+        record_durable();
+    }
+
+    void record_durable() {
+        auto now_offset = static_cast<long long>(SimClock::elapsed_ns(start, SimClock::now()));
+        for (uint64_t offset : unsynced) {
+            counts.durable.record_ns(now_offset - static_cast<long long>(offset));
+        }
+        unsynced.clear();
+    }
+};
+
+//Mapped Journal Class below
+//read-only mapping of a journal file, cut to its durable prefix: the records up to the first one whose
+//sequence or checksum is wrong, as left by a crash between writes or in the middle of one
+class MappedJournal {
+public:
+    explicit MappedJournal(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error_message = "cannot open " + path;
+            return;
+        }
+        struct stat info {};
+        if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(JournalHeader)) {
+            error_message = path + " is too small to be a journal";
+            ::close(fd);
+            return;
+        }
+        size_t bytes = static_cast<size_t>(info.st_size);
+        void* data = ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            error_message = "cannot map " + path;
+            return;
+        }
+        mapping = data;
+        mapped_bytes = bytes;
+        ::madvise(mapping, mapped_bytes, MADV_SEQUENTIAL);
+        const auto* header = static_cast<const JournalHeader*>(mapping);
+        if (std::memcmp(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0
+            || header->version != JOURNAL_VERSION || header->record_size != sizeof(JournalRecord)) {
+            error_message = path + " is not a version " + std::to_string(JOURNAL_VERSION) + " journal";
+            return;
+        }
+        symbols = header->num_symbols;
+        first = reinterpret_cast<const JournalRecord*>(static_cast<const char*>(mapping) + sizeof(JournalHeader));
+        uint64_t on_disk = (mapped_bytes - sizeof(JournalHeader)) / sizeof(JournalRecord);
+        while (count < on_disk && first[count].sequence == count
+               && first[count].kind <= JournalEvent::SNAPSHOT_END
+               && first[count].checksum == journal_checksum(first[count])) {
+            ++count;
+        }
+        discarded = mapped_bytes - sizeof(JournalHeader) - count * sizeof(JournalRecord);
+    }
+    ~MappedJournal() {
+        if (mapping) {
+            ::munmap(mapping, mapped_bytes);
+        }
+    }
+    MappedJournal(const MappedJournal&) = delete;
+    MappedJournal& operator=(const MappedJournal&) = delete;
+
+    bool ok() const { return first != nullptr; }
+    const std::string& error() const { return error_message; }
+
+    const JournalRecord* records() const { return first; }
+    uint64_t size() const { return count; }
+    uint32_t num_symbols() const { return symbols; }
+    size_t discarded_bytes() const { return discarded; } //past the durable prefix
+private:
+    void* mapping = nullptr;
+    size_t mapped_bytes = 0;
+    const JournalRecord* first = nullptr;
+    uint64_t count = 0;
+    uint32_t symbols = 0;
+    size_t discarded = 0;
+    std::string error_message;
+};
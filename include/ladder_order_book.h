@@ -0,0 +1,587 @@
+#pragma once
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include "order.h"
+#include "price_level.h"
+#include "execution_report.h"
+#include "level_feed.h"
+#include "matching.h"
+#include "level_scan.h"
+
+//Order Book Class below (flat price ladder backend)
+//levels are stored in contiguous arrays indexed by tick offset from base_price, with a bitmap
+//per side so the next non-empty level can be found a word (64 levels) at a time, and a vector of words
+//at a time through the level_scan kernels. each level's total is mirrored into a dense per-tick array
+//so the sweep estimate can sum it with the same kernels.
+//the arrays are carved from the arena once, sized for the widest window, so a re-centre only moves levels
+//inside them. best bid/ask indices are cached so top-of-book is O(1) and the hot path never allocates.
+//each level is a FIFO of resting orders, so matching follows price-time priority
+//accessed by one thread only, the matching engine
+class LadderOrderBook {
+public:
+    static constexpr const char* NAME = "ladder";
+
+    //limits.max_levels is the initial window width, centred on centre_price. re-centres may double it up to
+    //limits.max_window, an order that would need it wider still is rejected like one the map has no level for.
+    //reports, when set, receives an execution report for every fill, ack, cancel and reject
+    explicit LadderOrderBook(Arena& arena, const BookLimits& limits = {}, ExecutionReporter* reports = nullptr,
+                             Price centre_price = 100)
+        : reports(reports),
+          num_levels(round_up_levels(limits.max_levels)),
+          max_window(std::max(round_up_levels(limits.max_window), num_levels)),
+          base_price(centre_price - static_cast<Price>(num_levels / 2)),
+          bid_levels(arena.allocate_array<PriceLevel>(max_window)),
+          ask_levels(arena.allocate_array<PriceLevel>(max_window)),
+          bid_bits(arena.allocate_array<uint64_t>(max_window / 64)),
+          ask_bits(arena.allocate_array<uint64_t>(max_window / 64)),
+          bid_totals(arena.allocate_array<Quantity>(max_window)),
+          ask_totals(arena.allocate_array<Quantity>(max_window)),
+          pool(arena, "ladder orders", limits.max_orders, limits.policy),
+          index(arena, limits.max_orders) {
+        std::uninitialized_fill_n(bid_levels, max_window, PriceLevel{});
+        std::uninitialized_fill_n(ask_levels, max_window, PriceLevel{});
+        std::fill_n(bid_bits, max_window / 64, 0);
+        std::fill_n(ask_bits, max_window / 64, 0);
+        std::fill_n(bid_totals, max_window, 0);
+        std::fill_n(ask_totals, max_window, 0);
+        assign_prices();
+    }
+    LadderOrderBook(const LadderOrderBook&) = delete;
+    LadderOrderBook& operator=(const LadderOrderBook&) = delete;
+
+    //arena bytes needed for a book of this size: the order pool and index, and per side the levels, bitmap
+    //and totals for the widest window
+    static size_t arena_bytes(const BookLimits& limits) {
+        size_t window = std::max(round_up_levels(limits.max_window), round_up_levels(limits.max_levels));
+        return OrderNodePool::bytes_needed(limits.max_orders) + OrderIndex::bytes_needed(limits.max_orders)
+               + 2 * (Arena::reserve_for(window * sizeof(PriceLevel)) + Arena::reserve_for(window / 64 * sizeof(uint64_t))
+                      + Arena::reserve_for(window * sizeof(Quantity)));
+    }
+
+    void process_order(Order& order) {
+        switch (order.type) {
+            case MsgType::NEW:
+                if (order.side == Side::BUY) {
+                    match<Side::BUY>(order);
+                } else {
+                    match<Side::SELL>(order);
+                }
+                break;
+            case MsgType::CANCEL: {
+                bool canceled = cancel(order.id);
+                if (reports) {
+                    reports->done(order, canceled ? ExecType::CANCELED : ExecType::REJECTED, 0);
+                }
+                break;
+            }
+            case MsgType::MODIFY: {
+                bool modified = modify(order.id, order.quantity);
+                if (reports) {
+                    ExecType type = !modified ? ExecType::REJECTED
+                                              : (order.quantity > 0 ? ExecType::MODIFIED : ExecType::CANCELED);
+                    reports->done(order, type, modified ? std::max(order.quantity, 0) : 0);
+                }
+                break;
+            }
+        }
+    }
+    //removes a resting order, returns false if it is no longer in the book
+    bool cancel(OrderID id) {
+        OrderNode* node = index.find(id);
+        if (!node) {
+            return false;
+        }
+        remove_node(node);
+        return true;
+    }
+    //sets the remaining quantity of a resting order. reducing keeps time priority, increasing loses it
+    bool modify(OrderID id, Quantity quantity) {
+        OrderNode* node = index.find(id);
+        if (!node) {
+            return false;
+        }
+        if (quantity <= 0) {
+            remove_node(node);
+            return true;
+        }
+        PriceLevel* level = node->level;
+        if (quantity <= node->quantity) {
+            level->total_quantity -= node->quantity - quantity;
+            node->quantity = quantity;
+        } else {
+            level->erase(node);
+            node->quantity = quantity;
+            level->push_back(node);
+        }
+        level_changed(node->side, *level);
+        return true;
+    }
+    size_t resting_orders() const {
+        return pool.in_use();
+    }
+    //non-empty levels on both sides, counted through the bitmaps
+    size_t price_levels() const {
+        return count_set(bid_bits, 0, num_levels - 1) + count_set(ask_bits, 0, num_levels - 1);
+    }
+    //times a price outside the window moved or widened it
+    uint64_t recentres() const {
+        return recentre_count;
+    }
+    //best price and quantity on each side
+    TopOfBook top_of_book() const {
+        TopOfBook top;
+        if (best_bid != NONE) {
+            top.bid_price = price_at(best_bid);
+            top.bid_quantity = bid_levels[best_bid].total_quantity;
+        }
+        if (best_ask != NONE) {
+            top.ask_price = price_at(best_ask);
+            top.ask_quantity = ask_levels[best_ask].total_quantity;
+        }
+        return top;
+    }
+    //the best max_levels levels of one side, best first, found through the bitmaps. returns how many were written
+    size_t depth(Side side, DepthLevel* out, size_t max_levels) const {
+        return side == Side::BUY ? copy_levels<Side::BUY>(out, max_levels) : copy_levels<Side::SELL>(out, max_levels);
+    }
+    //how much of the resting side an aggressor of side aggressor with this limit and quantity would take
+    SweepEstimate sweep(Side aggressor, Price limit, Quantity quantity) const {
+        return aggressor == Side::BUY ? sweep_side<Side::SELL>(limit, quantity) : sweep_side<Side::BUY>(limit, quantity);
+    }
+    //every resting order, bids then asks, best level first and in time priority within a level, as
+    //visit(node, price). adding them back to an empty book in this order rebuilds this one
+    template <typename Visit>
+    void for_each_resting(Visit&& visit) const {
+        visit_side<Side::BUY>(visit);
+        visit_side<Side::SELL>(visit);
+    }
+    //feed, when set, receives a LevelUpdate for every level this book changes, tagged with symbol
+    void attach_feed(LevelFeed* feed, SymbolID symbol) {
+        level_feed = feed;
+        feed_symbol = symbol;
+    }
+    //function to output the current top-of-book
+    void print_top_of_book() const {
+        ::print_top_of_book(top_of_book());
+    }
+private:
+    static constexpr size_t NONE = static_cast<size_t>(-1);
+
+    ExecutionReporter* reports;
+    size_t num_levels; //current window, the first num_levels entries of each array
+    size_t max_window; //the most num_levels may grow to, and the length of each array
+    Price base_price; //price held at index 0
+    PriceLevel* bid_levels;
+    PriceLevel* ask_levels;
+    //one bit per level, set when the level has resting quantity
+    uint64_t* bid_bits;
+    uint64_t* ask_bits;
+    //total_quantity of every level by tick, 0 when empty
+    Quantity* bid_totals;
+    Quantity* ask_totals;
+    size_t best_bid = NONE;
+    size_t best_ask = NONE;
+    OrderNodePool pool;
+    OrderIndex index;
+    LevelFeed* level_feed = nullptr;
+    SymbolID feed_symbol = 0;
+    uint64_t recentre_count = 0;
+
+    static size_t round_up_levels(size_t levels) {
+        size_t n = 64;
+        while (n < levels) {
+            n <<= 1;
+        }
+        return n;
+    }
+
+    Price price_at(size_t index) const {
+        return base_price + static_cast<Price>(index);
+    }
+
+    static void set_bit(uint64_t* bits, size_t index) {
+        bits[index >> 6] |= (1ULL << (index & 63));
+    }
+
+    static void clear_bit(uint64_t* bits, size_t index) {
+        bits[index >> 6] &= ~(1ULL << (index & 63));
+    }
+
+    //lowest set index >= from inside the window, or NONE
+    size_t next_set_at_or_above(const uint64_t* bits, size_t from) const {
+        size_t words = num_levels / 64;
+        size_t word = from >> 6;
+        if (word >= words) {
+            return NONE;
+        }
+        uint64_t mask = bits[word] & (~0ULL << (from & 63));
+        if (mask == 0) {
+            word = level_scan::first_nonzero(bits, word + 1, words);
+            if (word == words) {
+                return NONE;
+            }
+            mask = bits[word];
+        }
+        return (word << 6) + static_cast<size_t>(__builtin_ctzll(mask));
+    }
+
+    //highest set index <= from, or NONE
+    static size_t next_set_at_or_below(const uint64_t* bits, size_t from) {
+        if (from == NONE) {
+            return NONE;
+        }
+        size_t word = from >> 6;
+        uint64_t mask = bits[word] & (~0ULL >> (63 - (from & 63)));
+        if (mask == 0) {
+            size_t below = level_scan::last_nonzero(bits, 0, word);
+            if (below == word) {
+                return NONE;
+            }
+            word = below;
+            mask = bits[word];
+        }
+        return (word << 6) + 63 - static_cast<size_t>(__builtin_clzll(mask));
+    }
+
+    //per-side members picked at compile time, so one body serves bids and asks
+    template <Side S>
+    PriceLevel* levels_of() { return S == Side::BUY ? bid_levels : ask_levels; }
+    template <Side S>
+    const PriceLevel* levels_of() const { return S == Side::BUY ? bid_levels : ask_levels; }
+    template <Side S>
+    uint64_t* bits_of() { return S == Side::BUY ? bid_bits : ask_bits; }
+    template <Side S>
+    const uint64_t* bits_of() const { return S == Side::BUY ? bid_bits : ask_bits; }
+    template <Side S>
+    size_t& best_of() { return S == Side::BUY ? best_bid : best_ask; }
+    template <Side S>
+    size_t best_of() const { return S == Side::BUY ? best_bid : best_ask; }
+
+    //true when slot is a better price than the current best of side S (or that side is empty)
+    template <Side S>
+    bool improves(size_t slot) const {
+        size_t best = best_of<S>();
+        return best == NONE || (S == Side::BUY ? slot > best : slot < best);
+    }
+
+    //the next occupied level behind slot on side S: downwards for bids, upwards for asks
+    template <Side S>
+    size_t next_worse(size_t slot) const {
+        if constexpr (S == Side::BUY) {
+            return slot == 0 ? NONE : next_set_at_or_below(bid_bits, slot - 1);
+        } else {
+            return next_set_at_or_above(ask_bits, slot + 1);
+        }
+    }
+
+    template <Side S>
+    size_t copy_levels(DepthLevel* out, size_t max_levels) const {
+        size_t written = 0;
+        for (size_t slot = best_of<S>(); slot != NONE && written < max_levels; slot = next_worse<S>(slot)) {
+            const PriceLevel& level = levels_of<S>()[slot];
+            out[written++] = DepthLevel{price_at(slot), level.total_quantity, level.order_count};
+        }
+        return written;
+    }
+
+    template <Side S, typename Visit>
+    void visit_side(Visit& visit) const {
+        for (size_t slot = best_of<S>(); slot != NONE; slot = next_worse<S>(slot)) {
+            for (const OrderNode* node = levels_of<S>()[slot].head; node; node = node->next) {
+                visit(*node, price_at(slot));
+            }
+        }
+    }
+
+    //S is the resting side: walks its totals from the best level towards limit until quantity is covered
+    template <Side S>
+    SweepEstimate sweep_side(Price limit, Quantity quantity) const {
+        SweepEstimate estimate;
+        size_t best = best_of<S>();
+        if (best == NONE || quantity <= 0 || !BookSide<S>::marketable(limit, price_at(best))) {
+            return estimate;
+        }
+        level_scan::Span span;
+        size_t last;
+        //clamped to the window in 64 bits, a market order's sentinel limit would overflow limit - base_price
+        long long offset = static_cast<long long>(limit) - base_price;
+        if constexpr (S == Side::SELL) {
+            size_t top = offset >= static_cast<long long>(num_levels) ? num_levels - 1 : static_cast<size_t>(offset);
+            span = level_scan::sweep_up(ask_totals, best, top - best + 1, quantity);
+            last = next_set_at_or_below(ask_bits, best + span.slots - 1);
+            estimate.levels = count_set(ask_bits, best, last);
+        } else {
+            size_t bottom = offset <= 0 ? 0 : static_cast<size_t>(offset);
+            span = level_scan::sweep_down(bid_totals, best, best - bottom + 1, quantity);
+            last = next_set_at_or_above(bid_bits, best + 1 - span.slots);
+            estimate.levels = count_set(bid_bits, last, best);
+        }
+        estimate.fillable = static_cast<Quantity>(std::min<long long>(span.quantity, quantity));
+        estimate.last_price = price_at(last);
+        return estimate;
+    }
+
+    //set bits in [lo, hi]
+    static uint32_t count_set(const uint64_t* bits, size_t lo, size_t hi) {
+        uint32_t count = 0;
+        for (size_t word = lo >> 6; word <= hi >> 6; ++word) {
+            uint64_t mask = bits[word];
+            if (word == lo >> 6) {
+                mask &= ~0ULL << (lo & 63);
+            }
+            if (word == hi >> 6) {
+                mask &= ~0ULL >> (63 - (hi & 63));
+            }
+            count += static_cast<uint32_t>(__builtin_popcountll(mask));
+        }
+        return count;
+    }
+
+    //the matching kernel's view of one side: the cached best, and the bitmap to find the next one
+    template <Side S>
+    struct LadderLevels {
+        LadderOrderBook& book;
+        PriceLevel* best() {
+            size_t slot = book.best_of<S>();
+            return slot == NONE ? nullptr : &book.levels_of<S>()[slot];
+        }
+        void pop_best() {
+            size_t& slot = book.best_of<S>();
+            clear_bit(book.bits_of<S>(), slot);
+            slot = book.next_worse<S>(slot);
+        }
+    };
+
+    void level_changed(Side side, const PriceLevel& level) {
+        if (side == Side::BUY) {
+            bid_totals[static_cast<size_t>(&level - bid_levels)] = level.total_quantity;
+        } else {
+            ask_totals[static_cast<size_t>(&level - ask_levels)] = level.total_quantity;
+        }
+        if (level_feed) {
+            level_feed->level_changed(feed_symbol, side, level.price, level.total_quantity);
+        }
+    }
+
+    //returns false if the order could not be rested, its id is taken by a resting order included
+    bool add_to_book(const Order& order) {
+        OrderNode* node = pool.acquire();
+        if (!node) {
+            return false; //pool exhausted, the remainder is not rested
+        }
+        node->id = order.id;
+        node->side = order.side;
+        node->quantity = order.quantity;
+        node->producer_id = order.producer_id;
+        size_t slot = index_for(order.price);
+        if (slot == NONE) {
+            pool.release(node); //too far from the resting levels for the widest window
+            return false;
+        }
+        if (!index.insert(order.id, node)) {
+            pool.release(node); //duplicate id, the resting order keeps it
+            return false;
+        }
+        if (order.side == Side::BUY) {
+            place<Side::BUY>(slot, node);
+        } else {
+            place<Side::SELL>(slot, node);
+        }
+        return true;
+    }
+
+    template <Side S>
+    void place(size_t slot, OrderNode* node) {
+        PriceLevel& level = levels_of<S>()[slot];
+        level.push_back(node);
+        level_changed(S, level);
+        set_bit(bits_of<S>(), slot);
+        if (improves<S>(slot)) {
+            best_of<S>() = slot;
+        }
+    }
+
+    //rests the remainder of an incoming order and acks (or rejects) it
+    void rest(const Order& order) {
+        bool rested = add_to_book(order);
+        if (reports) {
+            reports->done(order, rested ? ExecType::ACK : ExecType::REJECTED, rested ? order.quantity : 0);
+        }
+    }
+
+    void remove_node(OrderNode* node) {
+        PriceLevel* level = node->level;
+        level->erase(node);
+        index.erase(node->id);
+        level_changed(node->side, *level);
+        pool.release(node);
+        if (!level->empty()) {
+            return;
+        }
+        if (node->side == Side::BUY) {
+            level_emptied<Side::BUY>(level);
+        } else {
+            level_emptied<Side::SELL>(level);
+        }
+    }
+
+    //the level emptied, so clear its bit and move the cached best if it was the top
+    template <Side S>
+    void level_emptied(PriceLevel* level) {
+        size_t slot = static_cast<size_t>(level - levels_of<S>());
+        clear_bit(bits_of<S>(), slot);
+        if (slot == best_of<S>()) {
+            best_of<S>() = next_worse<S>(slot);
+        }
+    }
+
+    //one kernel for both sides: S is the aggressor's side, it walks the other side from its cached best
+    template <Side S>
+    void match(Order& order) {
+        using Resting = RestingSide<S>;
+        LadderLevels<Resting::side> levels{*this};
+        Price limit = match_limit<S>(order);
+        //the order types that may not trade as they arrive are decided before anything changes
+        if (order.order_type == OrderType::POST_ONLY && crosses<Resting>(levels, limit)) {
+            finish(order, ExecType::REJECTED);
+            return;
+        }
+        if (order.order_type == OrderType::FOK && sweep(S, limit, order.quantity).fillable < order.quantity) {
+            finish(order, ExecType::CANCELED);
+            return;
+        }
+        order.quantity = match_against<Resting>(levels, limit, order.quantity, index, pool,
+            [&](const OrderNode& resting, Price price, Quantity matched, Quantity remaining) {
+                if (reports) {
+                    reports->fill(order, resting, price, matched, remaining);
+                }
+            },
+            [&](const PriceLevel& level) { level_changed(Resting::side, level); });
+        if (order.quantity == 0) {
+            return;
+        }
+        //a limit or post-only remainder rests on the aggressor's own side, any other is cancelled
+        if (rests_remainder(order.order_type)) {
+            rest(order);
+        } else {
+            finish(order, ExecType::CANCELED);
+        }
+    }
+
+    //final report for a new order that ends without resting or filling completely
+    void finish(const Order& order, ExecType type) {
+        if (reports) {
+            reports->done(order, type, 0);
+        }
+    }
+
+    //maps a price to its ladder index, re-centring the ladder if the price is outside the window.
+    //NONE when the price cannot share a window of at most max_window levels with the resting ones
+    size_t index_for(Price price) {
+        long long offset = static_cast<long long>(price) - base_price;
+        if (offset < 0 || offset >= static_cast<long long>(num_levels)) {
+            if (!recentre(price)) {
+                return NONE;
+            }
+            offset = static_cast<long long>(price) - base_price;
+        }
+        return static_cast<size_t>(offset);
+    }
+
+    //cold path: shift the window so that every resting level and the new price fit around the centre.
+    //the window only doubles when the book is too deep, and never past max_window, the length of the arrays,
+    //so the occupied levels are moved inside them and nothing is allocated.
+    //returns false, leaving the book as it was, when that would take a window wider than max_window
+    bool recentre(Price price) {
+        Price lo = price;
+        Price hi = price;
+        size_t lowest_bid = next_set_at_or_above(bid_bits, 0);
+        size_t highest_ask = next_set_at_or_below(ask_bits, num_levels - 1);
+        if (lowest_bid != NONE) {
+            lo = std::min(lo, price_at(lowest_bid));
+            hi = std::max(hi, price_at(best_bid));
+        }
+        if (highest_ask != NONE) {
+            lo = std::min(lo, price_at(best_ask));
+            hi = std::max(hi, price_at(highest_ask));
+        }
+        size_t span = static_cast<size_t>(static_cast<long long>(hi) - lo) + 1;
+        if (span > max_window / 2) {
+            return false;
+        }
+        size_t new_levels = num_levels;
+        while (span > new_levels / 2) {
+            new_levels <<= 1;
+        }
+        long long wide_base = static_cast<long long>(lo) + static_cast<long long>(span / 2)
+                              - static_cast<long long>(new_levels / 2);
+        if (wide_base < std::numeric_limits<Price>::min()
+            || wide_base + static_cast<long long>(new_levels) - 1 > std::numeric_limits<Price>::max()) {
+            return false;
+        }
+        ++recentre_count;
+        Price new_base = static_cast<Price>(wide_base);
+
+        //every level outside [first, last] is empty, and the new window holds all of them, so moving that
+        //range by the change of base is an exact re-index
+        size_t first = std::min(lowest_bid, best_ask);
+        size_t last = std::max(best_bid == NONE ? 0 : best_bid, highest_ask == NONE ? 0 : highest_ask);
+        if (first != NONE) {
+            long long shift = static_cast<long long>(base_price) - new_base;
+            size_t to = static_cast<size_t>(static_cast<long long>(first) + shift);
+            size_t count = last - first + 1;
+            for (PriceLevel* levels : {bid_levels, ask_levels}) {
+                if (shift > 0) {
+                    std::move_backward(levels + first, levels + last + 1, levels + to + count);
+                } else {
+                    std::move(levels + first, levels + last + 1, levels + to);
+                }
+                //the old slots the moved range no longer covers
+                for (size_t i = first; i <= last; ++i) {
+                    if (i < to || i >= to + count) {
+                        levels[i] = PriceLevel{};
+                    }
+                }
+            }
+        }
+        num_levels = new_levels;
+        base_price = new_base;
+        assign_prices();
+        rebuild_bitmaps();
+        return true;
+    }
+
+    //stamps each level with its price and re-points resting nodes at the level's new address
+    void assign_prices() {
+        for (size_t i = 0; i < num_levels; ++i) {
+            bid_levels[i].price = price_at(i);
+            ask_levels[i].price = price_at(i);
+            bid_levels[i].relink();
+            ask_levels[i].relink();
+        }
+    }
+
+    //bitmaps and per-tick totals, after the levels have moved
+    void rebuild_bitmaps() {
+        std::fill_n(bid_bits, num_levels / 64, 0);
+        std::fill_n(ask_bits, num_levels / 64, 0);
+        std::fill_n(bid_totals, num_levels, 0);
+        std::fill_n(ask_totals, num_levels, 0);
+        for (size_t i = 0; i < num_levels; ++i) {
+            if (!bid_levels[i].empty()) {
+                set_bit(bid_bits, i);
+                bid_totals[i] = bid_levels[i].total_quantity;
+            }
+            if (!ask_levels[i].empty()) {
+                set_bit(ask_bits, i);
+                ask_totals[i] = ask_levels[i].total_quantity;
+            }
+        }
+        best_bid = next_set_at_or_below(bid_bits, num_levels - 1);
+        best_ask = next_set_at_or_above(ask_bits, 0);
+    }
+};
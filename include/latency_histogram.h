@@ -0,0 +1,109 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+//Latency Histogram Class below
+//HDR-style log-linear histogram over the whole uint64 range in fixed memory.
+//values below SUB_BUCKET_COUNT are counted exactly, above that every power of two is split into
+//SUB_BUCKET_COUNT/2 linear buckets, so any reported value is within 1/64 (~1.6%) of the real one.
+//record() is O(1) with no allocation, and histograms can be merged by adding their counts
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 7;
+    static constexpr uint64_t SUB_BUCKET_COUNT = 1ULL << SUB_BUCKET_BITS;
+    static constexpr uint64_t SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+    static constexpr size_t BUCKET_COUNT = SUB_BUCKET_COUNT + (64 - SUB_BUCKET_BITS) * SUB_BUCKET_HALF;
+
+    void record(uint64_t value) {
+        ++counts[index_of(value)];
+        ++total;
+        sum += value;
+        min_value = std::min(min_value, value);
+        max_value = std::max(max_value, value);
+    }
+
+    //records a latency that may be negative if the clock stepped, those are clamped to zero
+    void record_ns(long long latency_ns) {
+        record(latency_ns > 0 ? static_cast<uint64_t>(latency_ns) : 0);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        sum += other.sum;
+        min_value = std::min(min_value, other.min_value);
+        max_value = std::max(max_value, other.max_value);
+    }
+
+    void reset() {
+        counts.fill(0);
+        total = 0;
+        sum = 0;
+        min_value = std::numeric_limits<uint64_t>::max();
+        max_value = 0;
+    }
+
+    //value at the given percentile (0-100], e.g. 99.99. reports the top of the bucket, capped at max
+    uint64_t value_at_percentile(double percentile) const {
+        if (total == 0) {
+            return 0;
+        }
+        double clamped = std::min(std::max(percentile, 0.0), 100.0);
+        uint64_t rank = static_cast<uint64_t>(std::ceil(clamped / 100.0 * static_cast<double>(total)));
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return std::min(std::max(highest_in_bucket(i), min_value), max_value);
+            }
+        }
+        return max_value;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? min_value : 0; }
+    uint64_t max() const { return max_value; }
+    double mean() const { return total ? static_cast<double>(sum) / static_cast<double>(total) : 0.0; }
+
+    //bucket helpers, also used to line other per-order measurements up with latency buckets
+    static size_t index_of(uint64_t value) {
+        if (value < SUB_BUCKET_COUNT) {
+            return static_cast<size_t>(value);
+        }
+        unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(value));
+        unsigned shift = msb - (SUB_BUCKET_BITS - 1);
+        uint64_t mantissa = value >> shift; //in [SUB_BUCKET_HALF, SUB_BUCKET_COUNT)
+        return static_cast<size_t>(SUB_BUCKET_COUNT + (shift - 1) * SUB_BUCKET_HALF + (mantissa - SUB_BUCKET_HALF));
+    }
+
+    static uint64_t lowest_in_bucket(size_t index) {
+        if (index < SUB_BUCKET_COUNT) {
+            return index;
+        }
+        size_t offset = index - SUB_BUCKET_COUNT;
+        unsigned shift = static_cast<unsigned>(offset / SUB_BUCKET_HALF) + 1;
+        uint64_t mantissa = SUB_BUCKET_HALF + offset % SUB_BUCKET_HALF;
+        return mantissa << shift;
+    }
+
+    static uint64_t highest_in_bucket(size_t index) {
+        if (index < SUB_BUCKET_COUNT) {
+            return index;
+        }
+        unsigned shift = static_cast<unsigned>((index - SUB_BUCKET_COUNT) / SUB_BUCKET_HALF) + 1;
+        return lowest_in_bucket(index) + ((1ULL << shift) - 1);
+    }
+private:
+    std::array<uint64_t, BUCKET_COUNT> counts{};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t min_value = std::numeric_limits<uint64_t>::max();
+    uint64_t max_value = 0;
+};
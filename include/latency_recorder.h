@@ -0,0 +1,168 @@
+#pragma once
+#include <new>
+#include <cstddef>
+#include "memory_pool.h"
+#include "latency_histogram.h"
+#include "order.h"
+#include "order_timeline.h"
+
+//the latencies taken from each order's timestamps. SEND_LAG and CORRECTED only differ from zero and
+//END_TO_END when producers run open loop: they start at the time the schedule meant the order to go out,
+//so a stall that holds producers back still shows up in the latency (coordinated-omission correction).
+//RISK_CHECK and RISK_HOP are only recorded with risk checks on (risk_check.h): the checks themselves, and
+//for a pipelined risk thread the hop from it to the engine, which queue wait then includes
+enum class LatencyStage { QUEUE_WAIT, MATCHING, END_TO_END, SEND_LAG, CORRECTED, RISK_CHECK, RISK_HOP };
+constexpr size_t LATENCY_STAGE_COUNT = 7;
+
+inline const char* to_string(LatencyStage stage) {
+    switch (stage) {
+        case LatencyStage::QUEUE_WAIT: return "queue wait";
+        case LatencyStage::MATCHING: return "matching";
+        case LatencyStage::END_TO_END: return "end-to-end";
+        case LatencyStage::SEND_LAG: return "send lag";
+        case LatencyStage::CORRECTED: return "from intended";
+        case LatencyStage::RISK_CHECK: return "risk check";
+        case LatencyStage::RISK_HOP: return "risk -> engine";
+    }
+    return "?";
+}
+
+//message categories the breakdown is split by: new buys, new sells, and cancels/modifies
+enum class FlowKind { BUY, SELL, AMEND };
+constexpr size_t FLOW_KIND_COUNT = 3;
+
+inline const char* to_string(FlowKind kind) {
+    switch (kind) {
+        case FlowKind::BUY: return "buy";
+        case FlowKind::SELL: return "sell";
+        case FlowKind::AMEND: return "cancel/modify";
+    }
+    return "?";
+}
+
+inline FlowKind flow_kind_of(const Order& order) {
+    if (order.type != MsgType::NEW) {
+        return FlowKind::AMEND;
+    }
+    return order.side == Side::BUY ? FlowKind::BUY : FlowKind::SELL;
+}
+
+//Latency Recorder Class below
+//the engine records every order into whole-run histograms carved from the arena at startup, so memory
+//stays fixed however long the run: the headline end-to-end latency, and queue wait (produce->consume),
+//matching (consume->processed) and end-to-end each split by flow kind and by producer.
+//open_loop adds send lag (intended->produce) and intended->processed, which then also becomes the
+//headline latency. live interval reports come from the metrics registry (metrics.h), not from here
+class LatencyRecorder {
+public:
+    LatencyRecorder(Arena& arena, size_t num_producers, bool open_loop = false)
+        : total(create(arena)),
+          producers(num_producers), open_loop(open_loop),
+          by_kind(create_array(arena, LATENCY_STAGE_COUNT * FLOW_KIND_COUNT)),
+          by_producer(create_array(arena, LATENCY_STAGE_COUNT * num_producers)) {}
+    LatencyRecorder(const LatencyRecorder&) = delete;
+    LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+
+    static size_t bytes_needed(size_t num_producers) {
+        return Arena::reserve_for(sizeof(LatencyHistogram))
+               + Arena::reserve_for(LATENCY_STAGE_COUNT * FLOW_KIND_COUNT * sizeof(LatencyHistogram))
+               + Arena::reserve_for(LATENCY_STAGE_COUNT * num_producers * sizeof(LatencyHistogram));
+    }
+
+    //engine side, called once the order's timeline has all three timestamps. returns the headline latency
+    long long record(const Order& order, const OrderTimeline& timeline) {
+        //matching is timed from the end of the risk checks when they ran on the engine thread
+        Timestamp match_start = timeline.risk_out > timeline.consume ? timeline.risk_out : timeline.consume;
+        long long queue_ns = SimClock::elapsed_ns(timeline.produce, timeline.consume);
+        long long match_ns = SimClock::elapsed_ns(match_start, timeline.processed);
+        long long end_to_end_ns = SimClock::elapsed_ns(timeline.produce, timeline.processed);
+        long long corrected_ns = end_to_end_ns;
+        if (open_loop) {
+            corrected_ns = SimClock::elapsed_ns(timeline.intended, timeline.processed);
+        }
+        total->record_ns(corrected_ns);
+
+        size_t kind = static_cast<size_t>(flow_kind_of(order));
+        record_stage(LatencyStage::QUEUE_WAIT, kind, order.producer_id, queue_ns);
+        record_stage(LatencyStage::MATCHING, kind, order.producer_id, match_ns);
+        record_stage(LatencyStage::END_TO_END, kind, order.producer_id, end_to_end_ns);
+        if (open_loop) {
+            record_stage(LatencyStage::SEND_LAG, kind, order.producer_id,
+                         SimClock::elapsed_ns(timeline.intended, timeline.produce));
+            record_stage(LatencyStage::CORRECTED, kind, order.producer_id, corrected_ns);
+        }
+        if (timeline.risk_out != 0) {
+            record_stage(LatencyStage::RISK_CHECK, kind, order.producer_id,
+                         SimClock::elapsed_ns(timeline.risk_in, timeline.risk_out));
+            if (timeline.risk_out <= timeline.consume) {
+                record_stage(LatencyStage::RISK_HOP, kind, order.producer_id,
+                             SimClock::elapsed_ns(timeline.risk_out, timeline.consume));
+            }
+        }
+        return corrected_ns;
+    }
+
+    //whole-run results below, read once the engine thread has been joined
+    const LatencyHistogram& totals() const { return *total; }
+
+    const LatencyHistogram& stage(LatencyStage stage, FlowKind kind) const {
+        return by_kind[stage_slot(stage, FLOW_KIND_COUNT) + static_cast<size_t>(kind)];
+    }
+
+    const LatencyHistogram& stage(LatencyStage stage, size_t producer) const {
+        return by_producer[stage_slot(stage, producers) + producer];
+    }
+
+    //all flow kinds of one stage merged together
+    LatencyHistogram stage_total(LatencyStage stage) const {
+        LatencyHistogram merged;
+        for (size_t kind = 0; kind < FLOW_KIND_COUNT; ++kind) {
+            merged.merge(by_kind[stage_slot(stage, FLOW_KIND_COUNT) + kind]);
+        }
+        return merged;
+    }
+
+    size_t producer_count() const { return producers; }
+    bool is_open_loop() const { return open_loop; }
+
+    //folds another recorder's whole-run histograms into this one (same producer count), used to
+    //aggregate the engine shards once they have been joined
+    void merge(const LatencyRecorder& other) {
+        total->merge(*other.total);
+        for (size_t i = 0; i < LATENCY_STAGE_COUNT * FLOW_KIND_COUNT; ++i) {
+            by_kind[i].merge(other.by_kind[i]);
+        }
+        for (size_t i = 0; i < LATENCY_STAGE_COUNT * producers && i < LATENCY_STAGE_COUNT * other.producers; ++i) {
+            by_producer[i].merge(other.by_producer[i]);
+        }
+    }
+private:
+    LatencyHistogram* total;
+    size_t producers;
+    bool open_loop;
+    LatencyHistogram* by_kind;     //[stage][flow kind]
+    LatencyHistogram* by_producer; //[stage][producer]
+
+    static size_t stage_slot(LatencyStage stage, size_t width) {
+        return static_cast<size_t>(stage) * width;
+    }
+
+    void record_stage(LatencyStage stage, size_t kind, uint8_t producer, long long ns) {
+        by_kind[stage_slot(stage, FLOW_KIND_COUNT) + kind].record_ns(ns);
+        if (producer < producers) {
+            by_producer[stage_slot(stage, producers) + static_cast<size_t>(producer)].record_ns(ns);
+        }
+    }
+
+    static LatencyHistogram* create(Arena& arena) {
+        return new (arena.allocate(sizeof(LatencyHistogram))) LatencyHistogram();
+    }
+
+    static LatencyHistogram* create_array(Arena& arena, size_t count) {
+        auto* histograms = static_cast<LatencyHistogram*>(arena.allocate(count * sizeof(LatencyHistogram)));
+        for (size_t i = 0; i < count; ++i) {
+            new (histograms + i) LatencyHistogram();
+        }
+        return histograms;
+    }
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+#include "order.h"
+#include "memory_pool.h"
+#include "spsc_ring.h"
+#include "latency_histogram.h"
+
+//one price level changing: the new total at the price, 0 when the level emptied
+struct LevelUpdate {
+    Timestamp time;    //engine clock of the message that changed it
+    uint64_t sequence; //per shard, consecutive unless the ring was full and updates were dropped
+    Price price;
+    Quantity quantity;
+    SymbolID symbol;
+    Side side;
+};
+
+using LevelUpdateRing = SpscRing<LevelUpdate>;
+
+//Level Feed Class below
+//the engine side of the L2 feed: the books call level_changed() whenever add_to_book, a cancel/modify or
+//a match loop leaves a level with a new total, and the update is copied into a preallocated ring. like the
+//execution reporter the engine never waits: a full ring drops the update, which the sequence gap shows
+class LevelFeed {
+public:
+    LevelFeed(Arena& arena, size_t capacity) : ring(arena, capacity) {}
+    LevelFeed(const LevelFeed&) = delete;
+    LevelFeed& operator=(const LevelFeed&) = delete;
+
+    static size_t bytes_needed(size_t capacity) {
+        return LevelUpdateRing::bytes_needed(capacity);
+    }
+
+    //called by the engine before each message, the updates it causes reuse its consume stamp
+    void begin(Timestamp now) {
+        current_time = now;
+    }
+
+    void level_changed(SymbolID symbol, Side side, Price price, Quantity quantity) {
+        if (!ring.try_push(LevelUpdate{current_time, next_sequence, price, quantity, symbol, side})) {
+            ++dropped_updates;
+        }
+        ++next_sequence;
+    }
+
+    LevelUpdateRing& updates() { return ring; }
+    uint64_t published() const { return next_sequence; }
+    uint64_t dropped() const { return dropped_updates; }
+private:
+    LevelUpdateRing ring;
+    uint64_t next_sequence = 0;
+    uint64_t dropped_updates = 0;
+    Timestamp current_time = 0;
+};
+
+//what the downstream side of the feed saw
+struct FeedStats {
+    uint64_t published = 0; //emitted by the engines, including dropped ones
+    uint64_t received = 0;  //taken off the engines' rings
+    uint64_t delivered = 0; //handed downstream after conflation
+    uint64_t gaps = 0;      //updates missing from the sequence, dropped on a full ring
+    LatencyHistogram delivery; //level change -> delivered downstream
+};
+
+//Feed Conflater Class below
+//merges updates to the same level (symbol, side, price) that arrive within one window, keeping only the
+//latest total, and delivers the survivors in first-seen order when the window closes. the output rate is
+//then bounded by the distinct levels touched per window, however fast the book churns. a zero window
+//delivers every update as it arrives. runs on the feed thread, never on the engine
+class FeedConflater {
+public:
+    explicit FeedConflater(std::chrono::nanoseconds window) : window_ticks(SimClock::ticks_from_ns(window.count())) {
+        pending.reserve(INITIAL_LEVELS);
+        slots.reserve(INITIAL_LEVELS);
+    }
+
+    template <typename Deliver>
+    void add(const LevelUpdate& update, Timestamp now, Deliver&& deliver) {
+        if (window_ticks == 0) {
+            deliver(update);
+            return;
+        }
+        if (pending.empty()) {
+            window_end = now + window_ticks;
+        }
+        auto [slot, inserted] = slots.try_emplace(key_of(update), pending.size());
+        if (inserted) {
+            pending.push_back(update);
+        } else {
+            //the level's change time stays the first one, that is how long the conflated update was held
+            Timestamp first = pending[slot->second].time;
+            pending[slot->second] = update;
+            pending[slot->second].time = first;
+        }
+    }
+
+    //delivers everything pending once the window is over (or unconditionally when force is set)
+    template <typename Deliver>
+    void flush(Timestamp now, Deliver&& deliver, bool force = false) {
+        if (pending.empty() || (!force && now < window_end)) {
+            return;
+        }
+        for (const LevelUpdate& update : pending) {
+            deliver(update);
+        }
+        pending.clear();
+        slots.clear();
+    }
+private:
+    static constexpr size_t INITIAL_LEVELS = 1024;
+
+    Timestamp window_ticks;
+    Timestamp window_end = 0;
+    std::vector<LevelUpdate> pending;
+    std::unordered_map<uint64_t, size_t> slots; //level key -> index into pending
+
+    static uint64_t key_of(const LevelUpdate& update) {
+        return (static_cast<uint64_t>(update.symbol) << 33) | (static_cast<uint64_t>(update.side) << 32)
+               | static_cast<uint32_t>(update.price);
+    }
+};
@@ -0,0 +1,383 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(LLSIM_SCALAR_SCAN)
+#include <immintrin.h>
+#define LLSIM_SCAN_X86 1
+#elif defined(__aarch64__) && defined(__ARM_NEON) && !defined(LLSIM_SCALAR_SCAN)
+#include <arm_neon.h>
+#define LLSIM_SCAN_NEON 1
+#endif
+#include "order.h"
+
+//Level scan kernels below: the two loops the ladder runs over long stretches of memory when a book is deep
+//or sparse, the search for the next non-empty word of a level bitmap and the walk over per-tick totals
+//that tells how far a sweep reaches. each has a scalar version and vector versions; NEON is picked at
+//build time on arm64 (every arm64 core has it), AVX2/AVX-512 at run time on x86 since the build machine
+//need not be the one the engine runs on. -DLLSIM_SIMD=OFF builds the scalar versions only.
+//debug builds (no NDEBUG) check every vector result against the scalar one
+namespace level_scan {
+
+enum class Isa { SCALAR, NEON, AVX2, AVX512 };
+
+inline const char* to_string(Isa isa) {
+    switch (isa) {
+        case Isa::SCALAR: return "scalar";
+        case Isa::NEON: return "neon";
+        case Isa::AVX2: return "avx2";
+        case Isa::AVX512: return "avx512";
+    }
+    return "?";
+}
+
+//how far a sweep walked: slots is the ticks visited, including the one where the running total reached
+//the wanted quantity, and quantity the running total over them (it can overshoot on the last slot)
+struct Span {
+    size_t slots;
+    long long quantity;
+};
+
+//scalar reference versions, also the tails of the vector ones
+namespace scalar {
+//first non-zero word in [begin, end), end if there is none
+inline size_t first_nonzero(const uint64_t* words, size_t begin, size_t end) {
+    for (; begin < end; ++begin) {
+        if (words[begin]) {
+            return begin;
+        }
+    }
+    return end;
+}
+
+//last non-zero word in [begin, end), end if there is none
+inline size_t last_nonzero(const uint64_t* words, size_t begin, size_t end) {
+    for (size_t i = end; i > begin; --i) {
+        if (words[i - 1]) {
+            return i - 1;
+        }
+    }
+    return end;
+}
+
+//walks totals[from], totals[from + 1], ... for at most count slots until the running total reaches wanted
+inline Span sweep_up(const Quantity* totals, size_t from, size_t count, long long wanted, Span done = {0, 0}) {
+    for (size_t i = done.slots; i < count; ++i) {
+        done.quantity += totals[from + i];
+        if (done.quantity >= wanted) {
+            return Span{i + 1, done.quantity};
+        }
+    }
+    return Span{count, done.quantity};
+}
+
+//the same walking downwards, totals[from], totals[from - 1], ... (count <= from + 1)
+inline Span sweep_down(const Quantity* totals, size_t from, size_t count, long long wanted, Span done = {0, 0}) {
+    for (size_t i = done.slots; i < count; ++i) {
+        done.quantity += totals[from - i];
+        if (done.quantity >= wanted) {
+            return Span{i + 1, done.quantity};
+        }
+    }
+    return Span{count, done.quantity};
+}
+}
+
+//the vector versions test or sum a whole register of words/totals at a time and hand the register where
+//the answer lies (and any tail) to the scalar loop, so they return exactly what the scalar versions do
+#if defined(LLSIM_SCAN_X86)
+namespace avx2 {
+__attribute__((target("avx2"))) inline size_t first_nonzero(const uint64_t* words, size_t begin, size_t end) {
+    for (; begin + 4 <= end; begin += 4) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + begin));
+        if (!_mm256_testz_si256(v, v)) {
+            break;
+        }
+    }
+    return scalar::first_nonzero(words, begin, end);
+}
+
+__attribute__((target("avx2"))) inline size_t last_nonzero(const uint64_t* words, size_t begin, size_t end) {
+    size_t top = end;
+    for (; top >= begin + 4; top -= 4) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + top - 4));
+        if (!_mm256_testz_si256(v, v)) {
+            break;
+        }
+    }
+    size_t found = scalar::last_nonzero(words, begin, top);
+    return found == top ? end : found;
+}
+
+//sum of 8 totals, widened to 64 bits so deep levels cannot overflow
+__attribute__((target("avx2"))) inline long long sum8(const Quantity* totals) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(totals));
+    __m256i wide = _mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)),
+                                    _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(wide), _mm256_extracti128_si256(wide, 1));
+    return _mm_cvtsi128_si64(half) + _mm_extract_epi64(half, 1);
+}
+
+__attribute__((target("avx2"))) inline Span sweep_up(const Quantity* totals, size_t from, size_t count, long long wanted) {
+    Span done{0, 0};
+    for (; done.slots + 8 <= count; done.slots += 8) {
+        long long block = sum8(totals + from + done.slots);
+        if (done.quantity + block >= wanted) {
+            break;
+        }
+        done.quantity += block;
+    }
+    return scalar::sweep_up(totals, from, count, wanted, done);
+}
+
+__attribute__((target("avx2"))) inline Span sweep_down(const Quantity* totals, size_t from, size_t count, long long wanted) {
+    Span done{0, 0};
+    for (; done.slots + 8 <= count; done.slots += 8) {
+        long long block = sum8(totals + from - done.slots - 7);
+        if (done.quantity + block >= wanted) {
+            break;
+        }
+        done.quantity += block;
+    }
+    return scalar::sweep_down(totals, from, count, wanted, done);
+}
+}
+
+namespace avx512 {
+__attribute__((target("avx512f"))) inline size_t first_nonzero(const uint64_t* words, size_t begin, size_t end) {
+    for (; begin + 8 <= end; begin += 8) {
+        __m512i v = _mm512_loadu_si512(words + begin);
+        __mmask8 nonzero = _mm512_test_epi64_mask(v, v);
+        if (nonzero) {
+            return begin + static_cast<size_t>(__builtin_ctz(nonzero));
+        }
+    }
+    return scalar::first_nonzero(words, begin, end);
+}
+
+__attribute__((target("avx512f"))) inline size_t last_nonzero(const uint64_t* words, size_t begin, size_t end) {
+    size_t top = end;
+    for (; top >= begin + 8; top -= 8) {
+        __m512i v = _mm512_loadu_si512(words + top - 8);
+        __mmask8 nonzero = _mm512_test_epi64_mask(v, v);
+        if (nonzero) {
+            return top - 8 + 31 - static_cast<size_t>(__builtin_clz(nonzero));
+        }
+    }
+    size_t found = scalar::last_nonzero(words, begin, top);
+    return found == top ? end : found;
+}
+
+//sum of 16 totals, widened to 64 bits. the zero-masked forms stand in for the plain widen, cast, extract and
+//reduce intrinsics, whose undefined pass-through operand GCC 12 reports as maybe-uninitialized
+__attribute__((target("avx512f"))) inline long long sum16(const Quantity* totals) {
+    const __mmask8 all = 0xFF;
+    __m512i v = _mm512_loadu_si512(totals);
+    __m512i wide = _mm512_add_epi64(_mm512_maskz_cvtepi32_epi64(all, _mm512_maskz_extracti64x4_epi64(all, v, 0)),
+                                    _mm512_maskz_cvtepi32_epi64(all, _mm512_maskz_extracti64x4_epi64(all, v, 1)));
+    __m256i quarter = _mm256_add_epi64(_mm512_maskz_extracti64x4_epi64(all, wide, 0),
+                                       _mm512_maskz_extracti64x4_epi64(all, wide, 1));
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(quarter), _mm256_extracti128_si256(quarter, 1));
+    return _mm_cvtsi128_si64(half) + _mm_extract_epi64(half, 1);
+}
+
+__attribute__((target("avx512f"))) inline Span sweep_up(const Quantity* totals, size_t from, size_t count, long long wanted) {
+    Span done{0, 0};
+    for (; done.slots + 16 <= count; done.slots += 16) {
+        long long block = sum16(totals + from + done.slots);
+        if (done.quantity + block >= wanted) {
+            break;
+        }
+        done.quantity += block;
+    }
+    return scalar::sweep_up(totals, from, count, wanted, done);
+}
+
+__attribute__((target("avx512f"))) inline Span sweep_down(const Quantity* totals, size_t from, size_t count, long long wanted) {
+    Span done{0, 0};
+    for (; done.slots + 16 <= count; done.slots += 16) {
+        long long block = sum16(totals + from - done.slots - 15);
+        if (done.quantity + block >= wanted) {
+            break;
+        }
+        done.quantity += block;
+    }
+    return scalar::sweep_down(totals, from, count, wanted, done);
+}
+}
+#elif defined(LLSIM_SCAN_NEON)
+namespace neon {
+inline bool any4(const uint64_t* words) {
+    uint64x2_t v = vorrq_u64(vld1q_u64(words), vld1q_u64(words + 2));
+    return vmaxvq_u32(vreinterpretq_u32_u64(v)) != 0;
+}
+
+inline size_t first_nonzero(const uint64_t* words, size_t begin, size_t end) {
+    for (; begin + 4 <= end && !any4(words + begin); begin += 4) {
+    }
+    return scalar::first_nonzero(words, begin, end);
+}
+
+inline size_t last_nonzero(const uint64_t* words, size_t begin, size_t end) {
+    size_t top = end;
+    for (; top >= begin + 4 && !any4(words + top - 4); top -= 4) {
+    }
+    size_t found = scalar::last_nonzero(words, begin, top);
+    return found == top ? end : found;
+}
+
+//sum of 8 totals, widened to 64 bits
+inline long long sum8(const Quantity* totals) {
+    int64x2_t wide = vaddq_s64(vpaddlq_s32(vld1q_s32(totals)), vpaddlq_s32(vld1q_s32(totals + 4)));
+    return vaddvq_s64(wide);
+}
+
+inline Span sweep_up(const Quantity* totals, size_t from, size_t count, long long wanted) {
+    Span done{0, 0};
+    for (; done.slots + 8 <= count; done.slots += 8) {
+        long long block = sum8(totals + from + done.slots);
+        if (done.quantity + block >= wanted) {
+            break;
+        }
+        done.quantity += block;
+    }
+    return scalar::sweep_up(totals, from, count, wanted, done);
+}
+
+inline Span sweep_down(const Quantity* totals, size_t from, size_t count, long long wanted) {
+    Span done{0, 0};
+    for (; done.slots + 8 <= count; done.slots += 8) {
+        long long block = sum8(totals + from - done.slots - 7);
+        if (done.quantity + block >= wanted) {
+            break;
+        }
+        done.quantity += block;
+    }
+    return scalar::sweep_down(totals, from, count, wanted, done);
+}
+}
+#endif
+
+//the widest kernels this build and this CPU support
+inline Isa best_supported() {
+#if defined(LLSIM_SCAN_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return Isa::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return Isa::AVX2;
+    }
+#elif defined(LLSIM_SCAN_NEON)
+    return Isa::NEON;
+#endif
+    return Isa::SCALAR;
+}
+
+inline bool supported(Isa isa) {
+    switch (isa) {
+        case Isa::SCALAR: return true;
+        case Isa::NEON: return best_supported() == Isa::NEON;
+        case Isa::AVX2: return best_supported() == Isa::AVX2 || best_supported() == Isa::AVX512;
+        case Isa::AVX512: return best_supported() == Isa::AVX512;
+    }
+    return false;
+}
+
+namespace detail {
+inline Isa selected = best_supported();
+}
+
+inline Isa active() { return detail::selected; }
+
+//picks the kernels to use, e.g. to compare them in a benchmark. call it before the engine threads start.
+//returns false (and changes nothing) if isa is not available here
+inline bool select(Isa isa) {
+    if (!supported(isa)) {
+        return false;
+    }
+    detail::selected = isa;
+    return true;
+}
+
+//words looked at one by one before the vector kernels take over: in a dense book the next level is
+//almost always this close, and the vector setup would only cost time
+constexpr size_t SCALAR_PROBE = 4;
+
+//dispatching entry points used by the books
+inline size_t first_nonzero(const uint64_t* words, size_t begin, size_t end) {
+    size_t probe_end = std::min(end, begin + SCALAR_PROBE);
+    size_t probed = scalar::first_nonzero(words, begin, probe_end);
+    if (probed != probe_end || probe_end == end) {
+        return probed == probe_end ? end : probed;
+    }
+    begin = probe_end;
+    size_t found;
+    switch (detail::selected) {
+#if defined(LLSIM_SCAN_X86)
+        case Isa::AVX512: found = avx512::first_nonzero(words, begin, end); break;
+        case Isa::AVX2: found = avx2::first_nonzero(words, begin, end); break;
+#elif defined(LLSIM_SCAN_NEON)
+        case Isa::NEON: found = neon::first_nonzero(words, begin, end); break;
+#endif
+        default: return scalar::first_nonzero(words, begin, end);
+    }
+    assert(found == scalar::first_nonzero(words, begin, end));
+    return found;
+}
+
+inline size_t last_nonzero(const uint64_t* words, size_t begin, size_t end) {
+    size_t probe_begin = end - std::min(end - begin, SCALAR_PROBE);
+    size_t probed = scalar::last_nonzero(words, probe_begin, end);
+    if (probed != end || probe_begin == begin) {
+        return probed;
+    }
+    size_t top = probe_begin;
+    size_t found;
+    switch (detail::selected) {
+#if defined(LLSIM_SCAN_X86)
+        case Isa::AVX512: found = avx512::last_nonzero(words, begin, top); break;
+        case Isa::AVX2: found = avx2::last_nonzero(words, begin, top); break;
+#elif defined(LLSIM_SCAN_NEON)
+        case Isa::NEON: found = neon::last_nonzero(words, begin, top); break;
+#endif
+        default: found = scalar::last_nonzero(words, begin, top); break;
+    }
+    found = found == top ? end : found;
+    assert(found == scalar::last_nonzero(words, begin, end));
+    return found;
+}
+
+inline Span sweep_up(const Quantity* totals, size_t from, size_t count, long long wanted) {
+    Span span;
+    switch (detail::selected) {
+#if defined(LLSIM_SCAN_X86)
+        case Isa::AVX512: span = avx512::sweep_up(totals, from, count, wanted); break;
+        case Isa::AVX2: span = avx2::sweep_up(totals, from, count, wanted); break;
+#elif defined(LLSIM_SCAN_NEON)
+        case Isa::NEON: span = neon::sweep_up(totals, from, count, wanted); break;
+#endif
+        default: return scalar::sweep_up(totals, from, count, wanted);
+    }
+    assert(span.slots == scalar::sweep_up(totals, from, count, wanted).slots
+           && span.quantity == scalar::sweep_up(totals, from, count, wanted).quantity);
+    return span;
+}
+
+inline Span sweep_down(const Quantity* totals, size_t from, size_t count, long long wanted) {
+    Span span;
+    switch (detail::selected) {
+#if defined(LLSIM_SCAN_X86)
+        case Isa::AVX512: span = avx512::sweep_down(totals, from, count, wanted); break;
+        case Isa::AVX2: span = avx2::sweep_down(totals, from, count, wanted); break;
+#elif defined(LLSIM_SCAN_NEON)
+        case Isa::NEON: span = neon::sweep_down(totals, from, count, wanted); break;
+#endif
+        default: return scalar::sweep_down(totals, from, count, wanted);
+    }
+    assert(span.slots == scalar::sweep_down(totals, from, count, wanted).slots
+           && span.quantity == scalar::sweep_down(totals, from, count, wanted).quantity);
+    return span;
+}
+}
@@ -0,0 +1,324 @@
+#pragma once
+#include <iostream>
+#include <map>
+#include <algorithm>
+#include "order.h"
+#include "price_level.h"
+#include "execution_report.h"
+#include "level_feed.h"
+#include "matching.h"
+
+//Order Book Class below (std::map backend)
+//each level is a FIFO of resting orders, so matching follows price-time priority
+//map nodes, order nodes and the order index all come from pools carved out of the arena
+//accessed by one thread only, the matching engine
+class MapOrderBook {
+public:
+    static constexpr const char* NAME = "map";
+
+    //reports, when set, receives an execution report for every fill, ack, cancel and reject
+    explicit MapOrderBook(Arena& arena, const BookLimits& limits = {}, ExecutionReporter* reports = nullptr)
+        : reports(reports),
+          level_pool(arena, "map levels", LEVEL_NODE_SIZE, limits.max_levels, limits.policy),
+          bids(LevelAllocator(level_pool)),
+          asks(LevelAllocator(level_pool)),
+          pool(arena, "map orders", limits.max_orders, limits.policy),
+          index(arena, limits.max_orders) {}
+    MapOrderBook(const MapOrderBook&) = delete;
+    MapOrderBook& operator=(const MapOrderBook&) = delete;
+
+    //arena bytes needed for a book of this size
+    static size_t arena_bytes(const BookLimits& limits) {
+        return SlabPool::bytes_needed(LEVEL_NODE_SIZE, limits.max_levels)
+               + OrderNodePool::bytes_needed(limits.max_orders)
+               + OrderIndex::bytes_needed(limits.max_orders);
+    }
+
+    void process_order(Order& order) {
+        switch (order.type) {
+            case MsgType::NEW:
+                if (order.side == Side::BUY) {
+                    match<Side::BUY>(order);
+                } else {
+                    match<Side::SELL>(order);
+                }
+                break;
+            case MsgType::CANCEL: {
+                bool canceled = cancel(order.id);
+                if (reports) {
+                    reports->done(order, canceled ? ExecType::CANCELED : ExecType::REJECTED, 0);
+                }
+                break;
+            }
+            case MsgType::MODIFY: {
+                bool modified = modify(order.id, order.quantity);
+                if (reports) {
+                    ExecType type = !modified ? ExecType::REJECTED
+                                              : (order.quantity > 0 ? ExecType::MODIFIED : ExecType::CANCELED);
+                    reports->done(order, type, modified ? std::max(order.quantity, 0) : 0);
+                }
+                break;
+            }
+        }
+    }
+    //removes a resting order, returns false if it is no longer in the book
+    bool cancel(OrderID id) {
+        OrderNode* node = index.find(id);
+        if (!node) {
+            return false;
+        }
+        remove_node(node);
+        return true;
+    }
+    //sets the remaining quantity of a resting order. reducing keeps time priority, increasing loses it
+    bool modify(OrderID id, Quantity quantity) {
+        OrderNode* node = index.find(id);
+        if (!node) {
+            return false;
+        }
+        if (quantity <= 0) {
+            remove_node(node);
+            return true;
+        }
+        PriceLevel* level = node->level;
+        if (quantity <= node->quantity) {
+            level->total_quantity -= node->quantity - quantity;
+            node->quantity = quantity;
+        } else {
+            level->erase(node);
+            node->quantity = quantity;
+            level->push_back(node);
+        }
+        level_changed(node->side, *level);
+        return true;
+    }
+    size_t resting_orders() const {
+        return pool.in_use();
+    }
+    //non-empty levels on both sides
+    size_t price_levels() const {
+        return bids.size() + asks.size();
+    }
+    //the map has no window to move, kept so both books report the same counters
+    uint64_t recentres() const {
+        return 0;
+    }
+    //best price and quantity on each side
+    TopOfBook top_of_book() const {
+        TopOfBook top;
+        if (!bids.empty()) {
+            top.bid_price = bids.begin()->first;
+            top.bid_quantity = bids.begin()->second.total_quantity;
+        }
+        if (!asks.empty()) {
+            top.ask_price = asks.begin()->first;
+            top.ask_quantity = asks.begin()->second.total_quantity;
+        }
+        return top;
+    }
+    //the best max_levels levels of one side, best first. returns how many were written
+    size_t depth(Side side, DepthLevel* out, size_t max_levels) const {
+        if (side == Side::BUY) {
+            return copy_levels(bids.begin(), bids.end(), out, max_levels);
+        }
+        return copy_levels(asks.begin(), asks.end(), out, max_levels);
+    }
+    //how much of the resting side an aggressor of side aggressor with this limit and quantity would take
+    SweepEstimate sweep(Side aggressor, Price limit, Quantity quantity) const {
+        return aggressor == Side::BUY ? sweep_side<AskSide>(asks, limit, quantity)
+                                      : sweep_side<BidSide>(bids, limit, quantity);
+    }
+    //every resting order, bids then asks, best level first and in time priority within a level, as
+    //visit(node, price). adding them back to an empty book in this order rebuilds this one
+    template <typename Visit>
+    void for_each_resting(Visit&& visit) const {
+        visit_side(bids, visit);
+        visit_side(asks, visit);
+    }
+    //feed, when set, receives a LevelUpdate for every level this book changes, tagged with symbol
+    void attach_feed(LevelFeed* feed, SymbolID symbol) {
+        level_feed = feed;
+        feed_symbol = symbol;
+    }
+    //function to output the current top-of-book
+    void print_top_of_book() const {
+        ::print_top_of_book(top_of_book());
+    }
+private:
+    using LevelAllocator = PoolAllocator<std::pair<const Price, PriceLevel>>;
+    //each side's map is ordered best first by its own comparator, so both are walked from begin()
+    template <typename BookSideT>
+    using LevelMap = std::map<Price, PriceLevel, typename BookSideT::compare, LevelAllocator>;
+    static constexpr size_t LEVEL_NODE_SIZE = tree_node_size<std::pair<const Price, PriceLevel>>();
+
+    ExecutionReporter* reports;
+    //shared by both sides, declared first so it outlives the maps
+    SlabPool level_pool;
+    //sort bids from highest to lowest price
+    LevelMap<BidSide> bids;
+    //gets sorted from lowest to highest
+    LevelMap<AskSide> asks;
+    OrderNodePool pool;
+    OrderIndex index;
+    LevelFeed* level_feed = nullptr;
+    SymbolID feed_symbol = 0;
+
+    template <typename Map, typename Visit>
+    static void visit_side(const Map& book, Visit& visit) {
+        for (const auto& level : book) {
+            for (const OrderNode* node = level.second.head; node; node = node->next) {
+                visit(*node, level.first);
+            }
+        }
+    }
+
+    template <typename Iterator>
+    static size_t copy_levels(Iterator first, Iterator last, DepthLevel* out, size_t max_levels) {
+        size_t written = 0;
+        for (; first != last && written < max_levels; ++first) {
+            out[written++] = DepthLevel{first->first, first->second.total_quantity, first->second.order_count};
+        }
+        return written;
+    }
+
+    template <typename Resting, typename Map>
+    static SweepEstimate sweep_side(const Map& book, Price limit, Quantity quantity) {
+        SweepEstimate estimate;
+        long long taken = 0;
+        for (auto level = book.begin(); level != book.end() && taken < quantity
+             && Resting::marketable(limit, level->first); ++level) {
+            taken += level->second.total_quantity;
+            ++estimate.levels;
+            estimate.last_price = level->first;
+        }
+        estimate.fillable = static_cast<Quantity>(std::min<long long>(taken, quantity));
+        return estimate;
+    }
+
+    template <Side S>
+    auto& levels_of() {
+        if constexpr (S == Side::BUY) {
+            return bids;
+        } else {
+            return asks;
+        }
+    }
+
+    //the matching kernel's view of one side's map
+    template <typename Map>
+    struct MapLevels {
+        Map& map;
+        PriceLevel* best() { return map.empty() ? nullptr : &map.begin()->second; }
+        void pop_best() { map.erase(map.begin()); }
+    };
+
+    void level_changed(Side side, const PriceLevel& level) {
+        if (level_feed) {
+            level_feed->level_changed(feed_symbol, side, level.price, level.total_quantity);
+        }
+    }
+
+    //returns false if the order could not be rested, its id is taken by a resting order included
+    bool add_to_book(const Order& order) {
+        OrderNode* node = pool.acquire();
+        if (!node) {
+            return false; //pool exhausted, the remainder is not rested
+        }
+        node->id = order.id;
+        node->side = order.side;
+        node->quantity = order.quantity;
+        node->producer_id = order.producer_id;
+        if (!index.insert(order.id, node)) {
+            pool.release(node); //duplicate id, the resting order keeps it
+            return false;
+        }
+        bool placed = order.side == Side::BUY ? place(bids, order, node) : place(asks, order, node);
+        if (!placed) {
+            index.erase(order.id);
+            pool.release(node); //level pool exhausted under the REJECT policy
+            return false;
+        }
+        return true;
+    }
+
+    //appends node to the level at the order's price, creating the level if needed
+    template <typename Map>
+    bool place(Map& book, const Order& order, OrderNode* node) {
+        auto level_iter = book.find(order.price);
+        if (level_iter == book.end()) {
+            try {
+                level_iter = book.emplace(order.price, PriceLevel{}).first;
+            } catch (const std::bad_alloc&) {
+                return false;
+            }
+            level_iter->second.price = order.price;
+        }
+        level_iter->second.push_back(node);
+        level_changed(order.side, level_iter->second);
+        return true;
+    }
+
+    //rests the remainder of an incoming order and acks (or rejects) it
+    void rest(const Order& order) {
+        bool rested = add_to_book(order);
+        if (reports) {
+            reports->done(order, rested ? ExecType::ACK : ExecType::REJECTED, rested ? order.quantity : 0);
+        }
+    }
+
+    void remove_node(OrderNode* node) {
+        PriceLevel* level = node->level;
+        level->erase(node);
+        index.erase(node->id);
+        level_changed(node->side, *level);
+        if (level->empty()) {
+            if (node->side == Side::BUY) {
+                bids.erase(level->price);
+            } else {
+                asks.erase(level->price);
+            }
+        }
+        pool.release(node);
+    }
+
+    //one kernel for both sides: S is the aggressor's side, it trades against the other side's map
+    template <Side S>
+    void match(Order& order) {
+        using Resting = RestingSide<S>;
+        auto& book = levels_of<Resting::side>();
+        MapLevels<std::remove_reference_t<decltype(book)>> levels{book};
+        Price limit = match_limit<S>(order);
+        //the order types that may not trade as they arrive are decided before anything changes
+        if (order.order_type == OrderType::POST_ONLY && crosses<Resting>(levels, limit)) {
+            finish(order, ExecType::REJECTED);
+            return;
+        }
+        if (order.order_type == OrderType::FOK && sweep(S, limit, order.quantity).fillable < order.quantity) {
+            finish(order, ExecType::CANCELED);
+            return;
+        }
+        order.quantity = match_against<Resting>(levels, limit, order.quantity, index, pool,
+            [&](const OrderNode& resting, Price price, Quantity matched, Quantity remaining) {
+                if (reports) {
+                    reports->fill(order, resting, price, matched, remaining);
+                }
+            },
+            [&](const PriceLevel& level) { level_changed(Resting::side, level); });
+        if (order.quantity == 0) {
+            return;
+        }
+        //a limit or post-only remainder rests on the aggressor's own side, any other is cancelled
+        if (rests_remainder(order.order_type)) {
+            rest(order);
+        } else {
+            finish(order, ExecType::CANCELED);
+        }
+    }
+
+    //final report for a new order that ends without resting or filling completely
+    void finish(const Order& order, ExecType type) {
+        if (reports) {
+            reports->done(order, type, 0);
+        }
+    }
+};
@@ -0,0 +1,264 @@
+#pragma once
+#include <atomic>
+#include <new>
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "memory_pool.h"
+#include "price_level.h"
+#include "order.h"
+
+//Market data snapshots below: after each batch the engine writes the best levels of every book it touched
+//into that symbol's slot, and readers (strategy threads, a monitor in another process) copy a slot out
+//whenever they like. each slot is a seqlock, so the engine never waits for a reader and a reader never
+//keeps a torn copy. the segment is plain data with no pointers, so it can live in POSIX shared memory
+constexpr char MARKET_DATA_MAGIC[8] = {'L', 'L', 'S', 'I', 'M', 'M', 'K', 'T'};
+constexpr uint32_t MARKET_DATA_VERSION = 1;
+//most levels per side a snapshot holds, the published depth can be set lower
+constexpr size_t MAX_SNAPSHOT_DEPTH = 16;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "seqlock sequences are shared across processes");
+
+//one symbol's book as last published
+struct BookSnapshot {
+    Timestamp published; //engine clock when it was written
+    uint64_t updates;    //snapshots of this symbol so far, 0 = never published
+    uint32_t bid_count;  //levels filled in below
+    uint32_t ask_count;
+    DepthLevel bids[MAX_SNAPSHOT_DEPTH]; //best first
+    DepthLevel asks[MAX_SNAPSHOT_DEPTH];
+
+    TopOfBook top() const {
+        TopOfBook top;
+        if (bid_count > 0) {
+            top.bid_price = bids[0].price;
+            top.bid_quantity = bids[0].quantity;
+        }
+        if (ask_count > 0) {
+            top.ask_price = asks[0].price;
+            top.ask_quantity = asks[0].quantity;
+        }
+        return top;
+    }
+};
+
+//Snapshot Slot Class below
+//a sequence number that is odd while the writer is inside and the snapshot it guards. one writer
+//(the engine shard that owns the symbol), any number of readers
+class alignas(CACHE_LINE_SIZE) SnapshotSlot {
+public:
+    //writer side: fill(snapshot) writes straight into the slot between the two sequence bumps
+    template <typename Fill>
+    void write(Fill&& fill) {
+        uint64_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        fill(snapshot);
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    //reader side: false if the writer was inside during the copy, the caller tries again
+    bool try_read(BookSnapshot& out) const {
+        uint64_t before = sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            return false;
+        }
+        std::memcpy(&out, &snapshot, sizeof(out));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return sequence.load(std::memory_order_relaxed) == before;
+    }
+
+    void read(BookSnapshot& out) const {
+        while (!try_read(out)) {
+        }
+    }
+private:
+    std::atomic<uint64_t> sequence{0};
+    BookSnapshot snapshot{};
+};
+
+//what publishing cost one engine shard
+struct PublishStats {
+    uint64_t snapshots = 0;
+    long long publish_ns = 0; //time spent writing them, summed
+
+    void add(size_t count, long long ns) {
+        snapshots += count;
+        publish_ns += ns;
+    }
+};
+
+//first bytes of a segment, written last when it is created so a reader never attaches to a half-built one
+struct MarketDataHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_size;
+    uint32_t num_symbols;
+    uint32_t depth; //levels per side the engine publishes
+    uint64_t reserved;
+};
+static_assert(sizeof(MarketDataHeader) <= CACHE_LINE_SIZE, "the header sits in the segment's first cache line");
+
+namespace market_data_detail {
+inline size_t segment_bytes(size_t num_symbols) {
+    return CACHE_LINE_SIZE + num_symbols * sizeof(SnapshotSlot);
+}
+
+inline SnapshotSlot* first_slot(void* segment) {
+    return reinterpret_cast<SnapshotSlot*>(static_cast<char*>(segment) + CACHE_LINE_SIZE);
+}
+}
+
+//Market Data Publisher Class below
+//owns the segment: private memory when shm_name is empty, otherwise the POSIX shared memory object
+//shm_name (e.g. "/llsim_md"), unlinked again when the publisher goes away
+class MarketDataPublisher {
+public:
+    MarketDataPublisher(size_t num_symbols, size_t depth, const std::string& shm_name)
+        : shm_name(shm_name), symbols(num_symbols), levels(std::min(depth, MAX_SNAPSHOT_DEPTH)),
+          bytes(market_data_detail::segment_bytes(num_symbols)) {
+        void* data = MAP_FAILED;
+        if (shm_name.empty()) {
+            data = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        } else {
+            int fd = ::shm_open(shm_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+            if (fd < 0) {
+                error_message = "cannot create shared memory " + shm_name;
+                return;
+            }
+            if (::ftruncate(fd, static_cast<off_t>(bytes)) == 0) {
+                data = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            ::close(fd);
+        }
+        if (data == MAP_FAILED) {
+            error_message = "cannot map " + std::to_string(bytes) + " bytes of market data";
+            unlink();
+            return;
+        }
+        segment = data;
+        slots = market_data_detail::first_slot(segment);
+        for (size_t i = 0; i < symbols; ++i) {
+            new (slots + i) SnapshotSlot();
+        }
+        MarketDataHeader header{};
+        std::memcpy(header.magic, MARKET_DATA_MAGIC, sizeof(header.magic));
+        header.version = MARKET_DATA_VERSION;
+        header.slot_size = sizeof(SnapshotSlot);
+        header.num_symbols = static_cast<uint32_t>(symbols);
+        header.depth = static_cast<uint32_t>(levels);
+        std::memcpy(segment, &header, sizeof(header));
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    ~MarketDataPublisher() {
+        if (segment) {
+            ::munmap(segment, bytes);
+        }
+        unlink();
+    }
+    MarketDataPublisher(const MarketDataPublisher&) = delete;
+    MarketDataPublisher& operator=(const MarketDataPublisher&) = delete;
+
+    bool ok() const { return segment != nullptr; }
+    const std::string& error() const { return error_message; }
+    size_t depth() const { return levels; }
+    size_t num_symbols() const { return symbols; }
+
+    //engine side, only from the shard that owns symbol
+    template <typename Book>
+    void publish(SymbolID symbol, const Book& book, Timestamp now) {
+        size_t depth = levels;
+        slots[symbol].write([&](BookSnapshot& snapshot) {
+            snapshot.published = now;
+            ++snapshot.updates;
+            snapshot.bid_count = static_cast<uint32_t>(book.depth(Side::BUY, snapshot.bids, depth));
+            snapshot.ask_count = static_cast<uint32_t>(book.depth(Side::SELL, snapshot.asks, depth));
+        });
+    }
+
+    //in-process readers
+    const SnapshotSlot& slot(SymbolID symbol) const { return slots[symbol]; }
+private:
+    std::string shm_name;
+    size_t symbols;
+    size_t levels;
+    size_t bytes;
+    void* segment = nullptr;
+    SnapshotSlot* slots = nullptr;
+    std::string error_message;
+
+    void unlink() {
+        if (!shm_name.empty()) {
+            ::shm_unlink(shm_name.c_str());
+        }
+    }
+};
+
+//Market Data Reader Class below
+//read-only view of a publisher's shared memory segment from another process
+class MarketDataReader {
+public:
+    explicit MarketDataReader(const std::string& shm_name) {
+        int fd = ::shm_open(shm_name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            error_message = "no market data at " + shm_name + " (is a simulation publishing there?)";
+            return;
+        }
+        struct stat info {};
+        if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < market_data_detail::segment_bytes(0)) {
+            error_message = shm_name + " is too small to be a market data segment";
+            ::close(fd);
+            return;
+        }
+        size_t size = static_cast<size_t>(info.st_size);
+        void* data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            error_message = "cannot map " + shm_name;
+            return;
+        }
+        segment = data;
+        bytes = size;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        MarketDataHeader header;
+        std::memcpy(&header, segment, sizeof(header));
+        if (std::memcmp(header.magic, MARKET_DATA_MAGIC, sizeof(MARKET_DATA_MAGIC)) != 0
+            || header.version != MARKET_DATA_VERSION || header.slot_size != sizeof(SnapshotSlot)
+            || market_data_detail::segment_bytes(header.num_symbols) > bytes) {
+            error_message = shm_name + " is not a version " + std::to_string(MARKET_DATA_VERSION) + " market data segment";
+            return;
+        }
+        symbols = header.num_symbols;
+        levels = header.depth;
+        slots = market_data_detail::first_slot(segment);
+    }
+    ~MarketDataReader() {
+        if (segment) {
+            ::munmap(segment, bytes);
+        }
+    }
+    MarketDataReader(const MarketDataReader&) = delete;
+    MarketDataReader& operator=(const MarketDataReader&) = delete;
+
+    bool ok() const { return slots != nullptr; }
+    const std::string& error() const { return error_message; }
+    size_t num_symbols() const { return symbols; }
+    size_t depth() const { return levels; }
+
+    void read(SymbolID symbol, BookSnapshot& out) const {
+        slots[symbol].read(out);
+    }
+private:
+    void* segment = nullptr;
+    size_t bytes = 0;
+    const SnapshotSlot* slots = nullptr;
+    size_t symbols = 0;
+    size_t levels = 0;
+    std::string error_message;
+};
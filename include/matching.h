@@ -0,0 +1,93 @@
+#pragma once
+#include <functional>
+#include <type_traits>
+#include <cstdint>
+#include <limits>
+#include "order.h"
+#include "price_level.h"
+
+//Matching kernel below: one price-time matching loop shared by both sides of both books, specialised at
+//compile time so the side, the price comparison and the level container are all resolved by the compiler.
+//only the choice between the two instantiations is made at run time, once per order
+
+//compile-time description of one side of a book. PriceT is whatever the levels are keyed by: the
+//kernel only compares prices, so any ordered type (int32, int64, a fixed-point wrapper) works unchanged
+template <Side S, typename PriceT = Price>
+struct BookSide {
+    static constexpr Side side = S;
+    static constexpr Side opposite = S == Side::BUY ? Side::SELL : Side::BUY;
+    using price_type = PriceT;
+    //order of this side's levels, best first: bids high to low, asks low to high
+    using compare = std::conditional_t<S == Side::BUY, std::greater<PriceT>, std::less<PriceT>>;
+
+    //true when a level at level_price is at least as good as limit, i.e. an aggressor from the other
+    //side with that limit trades against it
+    static constexpr bool marketable(PriceT limit, PriceT level_price) {
+        return !compare{}(limit, level_price);
+    }
+};
+
+using BidSide = BookSide<Side::BUY>;
+using AskSide = BookSide<Side::SELL>;
+
+//the side an aggressor of side S trades against
+template <Side S>
+using RestingSide = BookSide<BookSide<S>::opposite>;
+
+//the limit an aggressor of side S is matched with: its price, or no limit at all for a market order
+template <Side S>
+constexpr Price match_limit(const Order& order) {
+    if (order.order_type != OrderType::MARKET) {
+        return order.price;
+    }
+    return S == Side::BUY ? std::numeric_limits<Price>::max() : std::numeric_limits<Price>::min();
+}
+
+//true when an aggressor with limit would trade with the resting side's best level on arrival
+template <typename Resting, typename Levels>
+inline bool crosses(Levels& levels, typename Resting::price_type limit) {
+    PriceLevel* level = levels.best();
+    return level && Resting::marketable(limit, level->price);
+}
+
+//whether what is left of an order after matching rests in the book. market, IOC and FOK remainders
+//are cancelled instead (FOK only has one when its pre-check failed and it never matched)
+constexpr bool rests_remainder(OrderType type) {
+    return type == OrderType::LIMIT || type == OrderType::POST_ONLY;
+}
+
+//walks the resting side best level first while it is marketable against limit, filling quantity in
+//price-time priority. Levels is the book's view of that side:
+//  PriceLevel* best()  the best level, nullptr when the side is empty
+//  void pop_best()     drops the best level once it has emptied
+//on_fill(resting, price, matched, remaining) sees every fill, on_level(level) every level touched, after
+//its fills and before it is dropped. returns the quantity left over
+template <typename Resting, typename Levels, typename OnFill, typename OnLevel>
+inline Quantity match_against(Levels& levels, typename Resting::price_type limit, Quantity quantity,
+                              OrderIndex& index, OrderNodePool& pool, OnFill&& on_fill, OnLevel&& on_level) {
+    while (quantity > 0) {
+        PriceLevel* level = levels.best();
+        if (!level || !Resting::marketable(limit, level->price)) {
+            break;
+        }
+        typename Resting::price_type price = level->price;
+        quantity = fill_level(*level, quantity, index, pool,
+            [&](const OrderNode& resting, Quantity matched, Quantity remaining) {
+                on_fill(resting, price, matched, remaining);
+            });
+        on_level(*level);
+        if (level->empty()) {
+            levels.pop_best();
+        }
+    }
+    return quantity;
+}
+
+//what an aggressor with a given limit and quantity would take from the resting side without trading:
+//fillable is min(quantity, resting quantity within the limit), levels the non-empty levels it reaches
+//and last_price the worst of them (0 when levels is 0)
+struct SweepEstimate {
+    Quantity fillable = 0;
+    uint32_t levels = 0;
+    Price last_price = 0;
+};
@@ -0,0 +1,297 @@
+#pragma once
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+//what a pool does when every block is handed out
+enum class ExhaustionPolicy {
+    REJECT,        //return nullptr and let the caller drop the request
+    HEAP_FALLBACK, //fall back to operator new (counted, so spikes are visible in the report)
+    ABORT          //treat it as a sizing bug and stop the process
+};
+
+inline const char* to_string(ExhaustionPolicy policy) {
+    switch (policy) {
+        case ExhaustionPolicy::REJECT: return "reject";
+        case ExhaustionPolicy::HEAP_FALLBACK: return "heap-fallback";
+        case ExhaustionPolicy::ABORT: return "abort";
+    }
+    return "?";
+}
+
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+class SlabPool;
+
+//Arena Class below
+//one region reserved at startup, carved up with a bump pointer. nothing is ever freed back to it,
+//so it is only used to size pools and fixed buffers before the simulation starts
+class Arena {
+public:
+    explicit Arena(size_t capacity_bytes)
+        : capacity(capacity_bytes),
+          base(static_cast<std::byte*>(::operator new(capacity_bytes, std::align_val_t(CACHE_LINE_SIZE)))) {}
+    ~Arena() {
+        ::operator delete(base, std::align_val_t(CACHE_LINE_SIZE));
+    }
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    //throws std::bad_alloc if the arena was sized too small, which can only happen during setup
+    void* allocate(size_t bytes, size_t alignment = CACHE_LINE_SIZE) {
+        size_t start = (offset + alignment - 1) & ~(alignment - 1);
+        if (start + bytes > capacity) {
+            throw std::bad_alloc();
+        }
+        offset = start + bytes;
+        return base + start;
+    }
+
+    template <typename T>
+    T* allocate_array(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), std::max(alignof(T), CACHE_LINE_SIZE)));
+    }
+
+    //touches every page once so none faults on the hot path. the bytes are read and written back
+    //unchanged, so it is safe over memory already handed out, as long as no other thread is using it yet
+    void prefault() {
+        const size_t page = 4096;
+        for (size_t at = 0; at < capacity; at += page) {
+            volatile std::byte* touch = base + at;
+            *touch = *touch;
+        }
+    }
+
+    //worst-case bytes a request will take, for sizing the arena up front
+    static constexpr size_t reserve_for(size_t bytes) {
+        return bytes + CACHE_LINE_SIZE;
+    }
+
+    //pools register themselves so they can be reported together. only happens while books are built, so
+    //the registry grows with however many books share the arena
+    void register_pool(const SlabPool* pool) {
+        pools.push_back(pool);
+    }
+
+    void unregister_pool(const SlabPool* pool) {
+        auto it = std::find(pools.begin(), pools.end(), pool);
+        if (it != pools.end()) {
+            *it = pools.back();
+            pools.pop_back();
+        }
+    }
+
+    void* data() const { return base; }
+    size_t bytes_used() const { return offset; }
+    size_t bytes_capacity() const { return capacity; }
+
+    inline void print_usage() const;
+private:
+    size_t capacity;
+    size_t offset = 0;
+    std::byte* base;
+    std::vector<const SlabPool*> pools;
+};
+
+//SlabPool Class below
+//fixed-size blocks carved from the arena with an intrusive free list, O(1) allocate and deallocate.
+//tracks occupancy and high-water mark so the startup sizing can be checked after a run
+class SlabPool {
+public:
+    SlabPool(Arena& arena, const char* name, size_t block_size, size_t capacity,
+             ExhaustionPolicy policy = ExhaustionPolicy::REJECT)
+        : arena(arena), pool_name(name), block(round_block(block_size)), blocks(capacity), policy(policy) {
+        begin = static_cast<std::byte*>(arena.allocate(block * capacity));
+        end = begin + block * capacity;
+        for (size_t i = 0; i < capacity; ++i) {
+            auto* link = reinterpret_cast<FreeBlock*>(begin + i * block);
+            link->next = (i + 1 < capacity) ? reinterpret_cast<FreeBlock*>(begin + (i + 1) * block) : nullptr;
+        }
+        free_head = capacity > 0 ? reinterpret_cast<FreeBlock*>(begin) : nullptr;
+        arena.register_pool(this);
+    }
+    ~SlabPool() {
+        arena.unregister_pool(this);
+    }
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    static size_t bytes_needed(size_t block_size, size_t capacity) {
+        return Arena::reserve_for(round_block(block_size) * capacity);
+    }
+
+    void* allocate() {
+        FreeBlock* head = free_head;
+        if (head) {
+            free_head = head->next;
+            if (++used > high_water) {
+                high_water = used;
+            }
+            return head;
+        }
+        return exhausted();
+    }
+
+    void deallocate(void* ptr) {
+        auto* bytes = static_cast<std::byte*>(ptr);
+        if (bytes < begin || bytes >= end) {
+            //came from the heap fallback
+            ::operator delete(ptr);
+            --used;
+            return;
+        }
+        auto* link = static_cast<FreeBlock*>(ptr);
+        link->next = free_head;
+        free_head = link;
+        --used;
+    }
+
+    const char* name() const { return pool_name; }
+    size_t block_size() const { return block; }
+    size_t capacity() const { return blocks; }
+    //includes live heap fallback blocks, so it can exceed capacity under HEAP_FALLBACK
+    size_t in_use() const { return used; }
+    size_t high_water_mark() const { return high_water; }
+    size_t heap_fallbacks() const { return heap_allocations; }
+    size_t rejected() const { return rejections; }
+    ExhaustionPolicy exhaustion_policy() const { return policy; }
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    Arena& arena;
+    const char* pool_name;
+    size_t block;
+    size_t blocks;
+    ExhaustionPolicy policy;
+    std::byte* begin = nullptr;
+    std::byte* end = nullptr;
+    FreeBlock* free_head = nullptr;
+    size_t used = 0;
+    size_t high_water = 0;
+    size_t heap_allocations = 0;
+    size_t rejections = 0;
+
+    static size_t round_block(size_t size) {
+        size = std::max(size, sizeof(FreeBlock));
+        return (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+    }
+
+    //cold path, kept out of line so allocate() stays small enough to inline
+    __attribute__((noinline)) void* exhausted() {
+        switch (policy) {
+            case ExhaustionPolicy::REJECT:
+                ++rejections;
+                return nullptr;
+            case ExhaustionPolicy::HEAP_FALLBACK:
+                ++heap_allocations;
+                if (++used > high_water) {
+                    high_water = used;
+                }
+                return ::operator new(block);
+            case ExhaustionPolicy::ABORT:
+                std::cerr << "Pool '" << pool_name << "' exhausted (capacity " << blocks << ")\n";
+                std::abort();
+        }
+        return nullptr;
+    }
+};
+
+//typed view over a SlabPool
+template <typename T>
+class FixedPool {
+public:
+    FixedPool(Arena& arena, const char* name, size_t capacity, ExhaustionPolicy policy = ExhaustionPolicy::REJECT)
+        : slab(arena, name, sizeof(T), capacity, policy) {}
+
+    static size_t bytes_needed(size_t capacity) {
+        return SlabPool::bytes_needed(sizeof(T), capacity);
+    }
+
+    //returns nullptr when exhausted under the REJECT policy
+    T* acquire() {
+        void* p = slab.allocate();
+        return p ? new (p) T{} : nullptr;
+    }
+
+    void release(T* object) {
+        object->~T();
+        slab.deallocate(object);
+    }
+
+    size_t in_use() const { return slab.in_use(); }
+    size_t capacity() const { return slab.capacity(); }
+    const SlabPool& stats() const { return slab; }
+private:
+    SlabPool slab;
+};
+
+//STL allocator that serves single-object allocations (e.g. std::map nodes) from a SlabPool.
+//anything larger than a block, or array allocations, goes to the heap
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(SlabPool& pool) noexcept : pool(&pool) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) noexcept : pool(other.pool) {}
+
+    T* allocate(size_t n) {
+        if (n == 1 && sizeof(T) <= pool->block_size()) {
+            void* p = pool->allocate();
+            if (!p) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(p);
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        if (n == 1 && sizeof(T) <= pool->block_size()) {
+            pool->deallocate(p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& other) const noexcept { return pool == other.pool; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>& other) const noexcept { return pool != other.pool; }
+private:
+    template <typename U> friend class PoolAllocator;
+    SlabPool* pool;
+};
+
+//std::map/std::set node size: the value plus colour and three links
+template <typename Value>
+constexpr size_t tree_node_size() {
+    return sizeof(Value) + 4 * sizeof(void*);
+}
+
+void Arena::print_usage() const {
+    std::cout << "\n--- Memory Pools ---\n";
+    std::cout << "Arena: " << offset / 1024 << " KiB used of " << capacity / 1024 << " KiB\n";
+    for (const SlabPool* p : pools) {
+        std::cout << std::left << std::setw(16) << p->name() << std::right
+                  << " in use " << std::setw(8) << p->in_use()
+                  << "  high water " << std::setw(8) << p->high_water_mark()
+                  << "  capacity " << std::setw(8) << p->capacity()
+                  << "  policy " << to_string(p->exhaustion_policy());
+        if (p->rejected() > 0) {
+            std::cout << "  rejected " << p->rejected();
+        }
+        if (p->heap_fallbacks() > 0) {
+            std::cout << "  heap fallbacks " << p->heap_fallbacks();
+        }
+        std::cout << "\n";
+    }
+}
@@ -0,0 +1,193 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "memory_pool.h"
+#include "latency_histogram.h"
+
+//what a thread counts. counters only ever grow, readers take rates from the difference of two snapshots
+enum class MetricCounter {
+    ORDERS_PROCESSED, //engine
+    IDLE_POLLS,       //engine, polls that found the transport empty
+    ORDERS_SENT,      //producer
+    SEND_RETRIES      //producer, sends refused by a full ring
+};
+constexpr size_t METRIC_COUNTER_COUNT = 4;
+
+//point-in-time values, refreshed only when a reader asks for a snapshot
+enum class MetricGauge {
+    TRANSPORT_DEPTH, //engine, orders waiting in its transport
+    RESTING_ORDERS   //engine, orders resting across its books
+};
+constexpr size_t METRIC_GAUGE_COUNT = 2;
+
+//histograms are per interval: publishing hands the reader everything since the previous snapshot
+enum class MetricHistogram {
+    LATENCY //engine, the headline end-to-end latency of each order
+};
+constexpr size_t METRIC_HISTOGRAM_COUNT = 1;
+
+enum class MetricRole { ENGINE, PRODUCER };
+
+struct MetricValues {
+    uint64_t counters[METRIC_COUNTER_COUNT] = {};
+    int64_t gauges[METRIC_GAUGE_COUNT] = {};
+    LatencyHistogram histograms[METRIC_HISTOGRAM_COUNT];
+
+    uint64_t operator[](MetricCounter counter) const { return counters[static_cast<size_t>(counter)]; }
+    int64_t operator[](MetricGauge gauge) const { return gauges[static_cast<size_t>(gauge)]; }
+    const LatencyHistogram& operator[](MetricHistogram histogram) const {
+        return histograms[static_cast<size_t>(histogram)];
+    }
+};
+
+//Thread Metrics Class below
+//one thread's slot. the owner updates its live values with plain stores, nothing is shared on that path.
+//a reader asks for a snapshot by bumping the requested epoch, and the owner answers from its own loop
+//(poll()) by copying the live values into the published copy under a seqlock, so the writer never waits
+//on a reader and a reader never sees a half-written copy. the reader's copy can race with a publish,
+//which the sequence check detects and retries
+class alignas(CACHE_LINE_SIZE) ThreadMetrics {
+public:
+    ThreadMetrics(MetricRole role, size_t index) : role(role), index(index) {}
+    ThreadMetrics(const ThreadMetrics&) = delete;
+    ThreadMetrics& operator=(const ThreadMetrics&) = delete;
+
+    //owner side below
+    void add(MetricCounter counter, uint64_t count = 1) {
+        live.counters[static_cast<size_t>(counter)] += count;
+    }
+
+    void set(MetricGauge gauge, int64_t value) {
+        live.gauges[static_cast<size_t>(gauge)] = value;
+    }
+
+    void record_ns(MetricHistogram histogram, long long value_ns) {
+        live.histograms[static_cast<size_t>(histogram)].record_ns(value_ns);
+    }
+
+    //called from the owner's loop, one relaxed load unless a reader is waiting. refresh_gauges runs just
+    //before publishing, so gauges that are costly to read (queue depth, book sizes) are only read then
+    template <typename Refresh>
+    void poll(Refresh&& refresh_gauges) {
+        if (requested.load(std::memory_order_relaxed) != answered) {
+            refresh_gauges();
+            publish();
+        }
+    }
+
+    void poll() {
+        poll([] {});
+    }
+
+    //owner side, once at thread exit: a last publish, after which readers stop waiting for this slot
+    void retire() {
+        publish();
+        retired.store(true, std::memory_order_release);
+    }
+
+    //reader side below
+    void request() {
+        requested.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    //true once the owner has answered every request so far (or has exited)
+    bool answered_all() const {
+        return published.load(std::memory_order_acquire) == requested.load(std::memory_order_acquire)
+               || retired.load(std::memory_order_acquire);
+    }
+
+    //copies the last published values
+    void read(MetricValues& out) const {
+        while (true) {
+            uint64_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            out = shared;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) {
+                return;
+            }
+        }
+    }
+
+    const MetricRole role;
+    const size_t index; //shard or producer number
+private:
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> requested{0}; //bumped by readers
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> sequence{0};  //odd while a publish is copying
+    std::atomic<uint32_t> published{0};
+    std::atomic<bool> retired{false};
+    uint32_t answered = 0; //owner only
+    MetricValues live;     //owner only
+    MetricValues shared;   //written by the owner under the sequence, read by readers
+
+    void publish() {
+        uint32_t epoch = requested.load(std::memory_order_acquire);
+        uint64_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        shared = live;
+        sequence.store(seq + 2, std::memory_order_release);
+        //histograms are per interval, the reader now holds this one
+        for (LatencyHistogram& histogram : live.histograms) {
+            histogram.reset();
+        }
+        answered = epoch;
+        published.store(epoch, std::memory_order_release);
+    }
+};
+
+//one thread's values in a snapshot
+struct MetricsSample {
+    MetricRole role;
+    size_t index;
+    bool fresh; //false if the thread did not answer in time and these are its previous values
+    MetricValues values;
+};
+
+//Metrics Registry Class below
+//fixed set of slots created up front, one per thread that will report. threads claim theirs by role and
+//index, and a reporter thread snapshots all of them
+class MetricsRegistry {
+public:
+    MetricsRegistry() = default;
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    //setup only, before the threads start
+    ThreadMetrics& add_thread(MetricRole role, size_t index) {
+        slots.push_back(std::make_unique<ThreadMetrics>(role, index));
+        return *slots.back();
+    }
+
+    //asks every slot to publish, waits up to timeout for the answers and copies them into out.
+    //threads asleep for longer than the timeout are reported with their last published values
+    void snapshot(std::vector<MetricsSample>& out, std::chrono::microseconds timeout) {
+        for (auto& slot : slots) {
+            slot->request();
+        }
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        out.resize(slots.size());
+        for (size_t i = 0; i < slots.size(); ++i) {
+            ThreadMetrics& slot = *slots[i];
+            while (!slot.answered_all() && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::yield();
+            }
+            out[i].role = slot.role;
+            out[i].index = slot.index;
+            out[i].fresh = slot.answered_all();
+            slot.read(out[i].values);
+        }
+    }
+
+    size_t size() const { return slots.size(); }
+private:
+    std::vector<std::unique_ptr<ThreadMetrics>> slots;
+};
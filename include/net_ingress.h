@@ -0,0 +1,495 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "order.h"
+#include "latency_histogram.h"
+
+//Network ingress below: a gateway-style front door for the engine. senders put fixed-size binary order
+//messages on UDP datagrams or a TCP stream, the engine's network thread decodes each one straight out of
+//the receive buffer into the hot Order and forwards it through the shard transports like any producer.
+//every message carries the sender's clock at send time, so on one host (or with the sender and engine on
+//a shared clock) the engine times wire -> match with the same recorder as everything else
+
+//which socket the network ingress listens on, or which one a load client sends to
+enum class NetProtocol { NONE, UDP, TCP };
+
+inline const char* to_string(NetProtocol protocol) {
+    switch (protocol) {
+        case NetProtocol::NONE: return "none";
+        case NetProtocol::UDP: return "udp";
+        case NetProtocol::TCP: return "tcp";
+    }
+    return "?";
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the wire protocol is little-endian and decoded in place"
+#endif
+
+//Wire protocol below, little-endian. an order message is 40 bytes:
+//   0 u8 magic 'O'   1 u8 MsgType   2 u8 Side   3 u8 OrderType   4 u16 symbol   6 u16 reserved
+//   8 u32 sequence (per sender, gaps are lost datagrams)   12 i32 quantity   16 u64 id   24 i32 price
+//  28 u32 reserved  32 u64 sender clock at send
+//a report message (engine -> sender, final reports only) is 32 bytes:
+//   0 u8 magic 'R'   1 u8 ExecType   2 u16 reserved   4 i32 leaves quantity   8 u64 id
+//  16 u64 the order's send stamp, echoed   24 u64 engine clock when the report was emitted
+//a datagram or a stream write carries any whole number of messages back to back
+constexpr size_t WIRE_ORDER_SIZE = 40;
+constexpr size_t WIRE_REPORT_SIZE = 32;
+constexpr uint8_t WIRE_ORDER_MAGIC = 'O';
+constexpr uint8_t WIRE_REPORT_MAGIC = 'R';
+//largest datagram either side builds or accepts
+constexpr size_t MAX_DATAGRAM = 1472;
+
+namespace wire_detail {
+template <typename T>
+inline T load(const unsigned char* bytes, size_t offset) {
+    T value;
+    std::memcpy(&value, bytes + offset, sizeof(T));
+    return value;
+}
+
+template <typename T>
+inline void store(unsigned char* bytes, size_t offset, T value) {
+    std::memcpy(bytes + offset, &value, sizeof(T));
+}
+}
+
+//decodes one order message into order, its send stamp into sent and its sequence into sequence.
+//false for anything the engine must not see: a bad magic, or fields valid_order_fields refuses
+inline bool decode_order(const unsigned char* bytes, size_t num_symbols, Order& order, Timestamp& sent,
+                         uint32_t& sequence) {
+    using wire_detail::load;
+    uint8_t type = bytes[1];
+    uint8_t side = bytes[2];
+    uint8_t order_type = bytes[3];
+    uint16_t symbol = load<uint16_t>(bytes, 4);
+    int32_t quantity = load<int32_t>(bytes, 12);
+    if (bytes[0] != WIRE_ORDER_MAGIC || !valid_order_fields(type, side, order_type, symbol, quantity, num_symbols)) {
+        return false;
+    }
+    order.type = static_cast<MsgType>(type);
+    order.side = static_cast<Side>(side);
+    order.order_type = static_cast<OrderType>(order_type);
+    order.symbol = symbol;
+    sequence = load<uint32_t>(bytes, 8);
+    order.quantity = quantity;
+    order.id = load<uint64_t>(bytes, 16);
+    order.price = load<int32_t>(bytes, 24);
+    sent = load<uint64_t>(bytes, 32);
+    return true;
+}
+
+inline void encode_order(const Order& order, uint32_t sequence, Timestamp sent, unsigned char* bytes) {
+    using wire_detail::store;
+    bytes[0] = WIRE_ORDER_MAGIC;
+    bytes[1] = static_cast<uint8_t>(order.type);
+    bytes[2] = static_cast<uint8_t>(order.side);
+    bytes[3] = static_cast<uint8_t>(order.order_type);
+    store<uint16_t>(bytes, 4, order.symbol);
+    store<uint16_t>(bytes, 6, 0);
+    store<uint32_t>(bytes, 8, sequence);
+    store<int32_t>(bytes, 12, order.quantity);
+    store<uint64_t>(bytes, 16, order.id);
+    store<int32_t>(bytes, 24, order.price);
+    store<uint32_t>(bytes, 28, 0);
+    store<uint64_t>(bytes, 32, sent);
+}
+
+//the send stamp is written last, so a sender can encode a batch and stamp it just before the send call
+inline void stamp_order(unsigned char* bytes, Timestamp sent) {
+    wire_detail::store<uint64_t>(bytes, 32, sent);
+}
+
+//one final report as it travels back to the sender
+struct WireReport {
+    uint8_t type; //ExecType
+    Quantity leaves;
+    OrderID id;
+    Timestamp sent;    //the order's send stamp
+    Timestamp emitted; //engine clock when the report was emitted
+};
+
+inline bool decode_report(const unsigned char* bytes, WireReport& report) {
+    using wire_detail::load;
+    if (bytes[0] != WIRE_REPORT_MAGIC) {
+        return false;
+    }
+    report.type = bytes[1];
+    report.leaves = load<int32_t>(bytes, 4);
+    report.id = load<uint64_t>(bytes, 8);
+    report.sent = load<uint64_t>(bytes, 16);
+    report.emitted = load<uint64_t>(bytes, 24);
+    return true;
+}
+
+inline void encode_report(const WireReport& report, unsigned char* bytes) {
+    using wire_detail::store;
+    bytes[0] = WIRE_REPORT_MAGIC;
+    bytes[1] = report.type;
+    store<uint16_t>(bytes, 2, 0);
+    store<int32_t>(bytes, 4, report.leaves);
+    store<uint64_t>(bytes, 8, report.id);
+    store<uint64_t>(bytes, 16, report.sent);
+    store<uint64_t>(bytes, 24, report.emitted);
+}
+
+//what the engine's network thread saw over a run
+struct NetworkStats {
+    uint64_t messages = 0;    //orders decoded and forwarded
+    uint64_t malformed = 0;   //messages dropped by decode_order
+    uint64_t gaps = 0;        //orders missing from the sender's sequence (lost datagrams)
+    uint64_t receives = 0;    //receive calls that returned data (recvmmsg batches count once)
+    uint64_t replies = 0;     //report messages sent back
+    uint64_t stray_bytes = 0; //left after the last whole message of a datagram, or cut off by a disconnect
+    LatencyHistogram wire;    //sender clock at send -> engine clock at receive
+};
+
+namespace net_detail {
+inline bool set_nonblocking(int fd) {
+    int flags = ::fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+inline bool make_address(const std::string& address, uint16_t port, sockaddr_in& out) {
+    std::memset(&out, 0, sizeof(out));
+    out.sin_family = AF_INET;
+    out.sin_port = htons(port);
+    return ::inet_pton(AF_INET, address.c_str(), &out.sin_addr) == 1;
+}
+
+inline std::string describe(const std::string& address, uint16_t port) {
+    return address + ":" + std::to_string(port);
+}
+}
+
+//Receivers below: the seam between the network thread and the kernel. a receiver has
+//  poll(on_frame)     calls on_frame(bytes, received) for every whole order message that has arrived, without
+//                     blocking, and returns how many there were. received is the engine clock right after the
+//                     receive call returned
+//  reply(bytes, size) sends report messages back to the current peer, best effort
+//  ok(), error(), NAME, receives(), stray_bytes()
+//the network thread is templated on it, so an io_uring receiver (multishot recv into a registered buffer
+//ring, frames parsed in place in the completed buffers) or a DPDK one (rte_eth_rx_burst on a dedicated
+//queue, frames parsed in the mbufs) slots in beside these two without touching the engine
+
+//UDP Receiver Class below
+//a bound, non-blocking UDP socket drained batch datagrams per call with recvmmsg (one recvfrom per datagram
+//where there is no recvmmsg). replies go to whoever sent the most recent datagram
+class UdpReceiver {
+public:
+#if defined(__linux__)
+    static constexpr const char* NAME = "udp (recvmmsg)";
+#else
+    static constexpr const char* NAME = "udp (recvfrom)";
+#endif
+
+    UdpReceiver(const std::string& address, uint16_t port, size_t batch)
+        : buffers(batch * MAX_DATAGRAM), sizes(batch, 0), peers(batch) {
+#if defined(__linux__)
+        headers.resize(batch);
+        vectors.resize(batch);
+        for (size_t i = 0; i < batch; ++i) {
+            vectors[i].iov_base = buffers.data() + i * MAX_DATAGRAM;
+            vectors[i].iov_len = MAX_DATAGRAM;
+            std::memset(&headers[i], 0, sizeof(headers[i]));
+            headers[i].msg_hdr.msg_iov = &vectors[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+            headers[i].msg_hdr.msg_name = &peers[i];
+            headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        }
+#endif
+        sockaddr_in local;
+        if (!net_detail::make_address(address, port, local)) {
+            error_message = "not an IPv4 address: " + address;
+            return;
+        }
+        fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+        int reuse = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        int buffer_bytes = 4 << 20; //absorb bursts while the thread is descheduled, the kernel may cap it
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_bytes, sizeof(buffer_bytes));
+        if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0
+            || !net_detail::set_nonblocking(fd)) {
+            error_message = "cannot bind udp " + net_detail::describe(address, port) + ": " + std::strerror(errno);
+            close_socket();
+        }
+    }
+    ~UdpReceiver() { close_socket(); }
+    UdpReceiver(const UdpReceiver&) = delete;
+    UdpReceiver& operator=(const UdpReceiver&) = delete;
+
+    bool ok() const { return fd >= 0; }
+    const std::string& error() const { return error_message; }
+    uint64_t receives() const { return receive_calls; }
+    //bytes left over after the last whole message of a datagram
+    uint64_t stray_bytes() const { return stray; }
+
+    template <typename OnFrame>
+    size_t poll(OnFrame&& on_frame) {
+        size_t count = receive();
+        if (count == 0) {
+            return 0;
+        }
+        ++receive_calls;
+        Timestamp received = SimClock::now();
+        size_t frames = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const unsigned char* datagram = buffers.data() + i * MAX_DATAGRAM;
+            size_t whole = sizes[i] / WIRE_ORDER_SIZE;
+            for (size_t j = 0; j < whole; ++j) {
+                on_frame(datagram + j * WIRE_ORDER_SIZE, received);
+            }
+            frames += whole;
+            stray += sizes[i] % WIRE_ORDER_SIZE;
+        }
+        peer = peers[count - 1];
+        has_peer = true;
+        return frames;
+    }
+
+    bool reply(const unsigned char* bytes, size_t size) {
+        if (!has_peer) {
+            return false;
+        }
+        return ::sendto(fd, bytes, size, 0, reinterpret_cast<const sockaddr*>(&peer), sizeof(peer))
+               == static_cast<ssize_t>(size);
+    }
+private:
+    int fd = -1;
+    std::vector<unsigned char> buffers; //batch datagrams of MAX_DATAGRAM bytes
+    std::vector<size_t> sizes;
+    std::vector<sockaddr_in> peers;
+#if defined(__linux__)
+    std::vector<mmsghdr> headers;
+    std::vector<iovec> vectors;
+#endif
+    sockaddr_in peer{};
+    bool has_peer = false;
+    uint64_t receive_calls = 0;
+    uint64_t stray = 0;
+    std::string error_message;
+
+    //datagrams now in buffers, 0 when none are waiting
+    size_t receive() {
+#if defined(__linux__)
+        for (auto& header : headers) {
+            header.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        }
+        int count = ::recvmmsg(fd, headers.data(), static_cast<unsigned>(headers.size()), MSG_DONTWAIT, nullptr);
+        if (count <= 0) {
+            return 0;
+        }
+        for (int i = 0; i < count; ++i) {
+            sizes[static_cast<size_t>(i)] = headers[static_cast<size_t>(i)].msg_len;
+        }
+        return static_cast<size_t>(count);
+#else
+        size_t count = 0;
+        while (count < sizes.size()) {
+            socklen_t length = sizeof(sockaddr_in);
+            ssize_t size = ::recvfrom(fd, buffers.data() + count * MAX_DATAGRAM, MAX_DATAGRAM, MSG_DONTWAIT,
+                                      reinterpret_cast<sockaddr*>(&peers[count]), &length);
+            if (size <= 0) {
+                break;
+            }
+            sizes[count++] = static_cast<size_t>(size);
+        }
+        return count;
+#endif
+    }
+
+    void close_socket() {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+};
+
+//TCP Receiver Class below
+//a non-blocking listening socket and one peer at a time: a new connection replaces the current one.
+//the stream is read into a buffer and parsed in place, a message split across reads waits for its tail
+class TcpReceiver {
+public:
+    static constexpr const char* NAME = "tcp (recv)";
+
+    TcpReceiver(const std::string& address, uint16_t port, size_t batch)
+        : buffer(std::max<size_t>(batch, 1) * MAX_DATAGRAM) {
+        sockaddr_in local;
+        if (!net_detail::make_address(address, port, local)) {
+            error_message = "not an IPv4 address: " + address;
+            return;
+        }
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0
+            || ::listen(listener, 4) != 0 || !net_detail::set_nonblocking(listener)) {
+            error_message = "cannot listen on tcp " + net_detail::describe(address, port) + ": " + std::strerror(errno);
+            close_fd(listener);
+        }
+    }
+    ~TcpReceiver() {
+        close_fd(connection);
+        close_fd(listener);
+    }
+    TcpReceiver(const TcpReceiver&) = delete;
+    TcpReceiver& operator=(const TcpReceiver&) = delete;
+
+    bool ok() const { return listener >= 0; }
+    const std::string& error() const { return error_message; }
+    uint64_t receives() const { return receive_calls; }
+    uint64_t stray_bytes() const { return stray; }
+
+    template <typename OnFrame>
+    size_t poll(OnFrame&& on_frame) {
+        accept_peer();
+        if (connection < 0) {
+            return 0;
+        }
+        ssize_t size = ::recv(connection, buffer.data() + pending, buffer.size() - pending, MSG_DONTWAIT);
+        if (size == 0 || (size < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            stray += pending; //the peer went away mid-message
+            pending = 0;
+            close_fd(connection);
+            return 0;
+        }
+        if (size < 0) {
+            return 0;
+        }
+        ++receive_calls;
+        Timestamp received = SimClock::now();
+        size_t available = pending + static_cast<size_t>(size);
+        size_t whole = available / WIRE_ORDER_SIZE;
+        for (size_t i = 0; i < whole; ++i) {
+            on_frame(buffer.data() + i * WIRE_ORDER_SIZE, received);
+        }
+        pending = available - whole * WIRE_ORDER_SIZE;
+        std::memmove(buffer.data(), buffer.data() + whole * WIRE_ORDER_SIZE, pending);
+        return whole;
+    }
+
+    bool reply(const unsigned char* bytes, size_t size) {
+        return connection >= 0 && ::send(connection, bytes, size, MSG_DONTWAIT) == static_cast<ssize_t>(size);
+    }
+private:
+    int listener = -1;
+    int connection = -1;
+    std::vector<unsigned char> buffer;
+    size_t pending = 0; //bytes of a message whose tail has not arrived yet
+    uint64_t receive_calls = 0;
+    uint64_t stray = 0;
+    std::string error_message;
+
+    void accept_peer() {
+        int accepted = ::accept(listener, nullptr, nullptr);
+        if (accepted < 0) {
+            return;
+        }
+        close_fd(connection);
+        stray += pending;
+        pending = 0;
+        int no_delay = 1;
+        ::setsockopt(accepted, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+        net_detail::set_nonblocking(accepted);
+        connection = accepted;
+    }
+
+    static void close_fd(int& fd) {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+};
+
+//Net Link Class below
+//the load client's end: a connected UDP or TCP socket. send() blocks until the bytes are handed to the
+//kernel, receive() takes whatever report messages have come back without waiting
+class NetLink {
+public:
+    NetLink(NetProtocol protocol, const std::string& address, uint16_t port) : protocol(protocol) {
+        sockaddr_in remote;
+        if (!net_detail::make_address(address, port, remote)) {
+            error_message = "not an IPv4 address: " + address;
+            return;
+        }
+        fd = ::socket(AF_INET, protocol == NetProtocol::TCP ? SOCK_STREAM : SOCK_DGRAM, 0);
+        if (fd >= 0 && protocol == NetProtocol::TCP) {
+            int no_delay = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+        }
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&remote), sizeof(remote)) != 0) {
+            error_message = "cannot connect " + std::string(to_string(protocol)) + " to "
+                            + net_detail::describe(address, port) + ": " + std::strerror(errno);
+            if (fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+    }
+    ~NetLink() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+    NetLink(const NetLink&) = delete;
+    NetLink& operator=(const NetLink&) = delete;
+
+    bool ok() const { return fd >= 0; }
+    const std::string& error() const { return error_message; }
+
+    //one datagram, or one write to the stream
+    bool send(const unsigned char* bytes, size_t size) {
+        size_t written = 0;
+        while (written < size) {
+            ssize_t result = ::send(fd, bytes + written, size - written, 0);
+            if (result < 0) {
+                //an unreachable udp port reports back as ECONNREFUSED on a later send, the datagram is lost
+                return false;
+            }
+            written += static_cast<size_t>(result);
+        }
+        return true;
+    }
+
+    //calls on_report for every whole report message waiting, returns how many
+    template <typename OnReport>
+    size_t receive(OnReport&& on_report) {
+        unsigned char* data = buffer + pending;
+        ssize_t size = ::recv(fd, data, sizeof(buffer) - pending, MSG_DONTWAIT);
+        if (size <= 0) {
+            return 0;
+        }
+        size_t available = pending + static_cast<size_t>(size);
+        size_t whole = available / WIRE_REPORT_SIZE;
+        for (size_t i = 0; i < whole; ++i) {
+            WireReport report;
+            if (decode_report(buffer + i * WIRE_REPORT_SIZE, report)) {
+                on_report(report);
+            }
+        }
+        //a datagram holds whole reports, only the stream can split one
+        pending = protocol == NetProtocol::TCP ? available - whole * WIRE_REPORT_SIZE : 0;
+        std::memmove(buffer, buffer + whole * WIRE_REPORT_SIZE, pending);
+        return whole;
+    }
+private:
+    NetProtocol protocol;
+    int fd = -1;
+    unsigned char buffer[MAX_DATAGRAM];
+    size_t pending = 0;
+    std::string error_message;
+};
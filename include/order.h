@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "clock.h"
+
+using Price = int;
+using Quantity = int;
+using OrderID = uint64_t;
+using SymbolID = uint16_t;
+//raw ticks of the build's clock source, see clock.h. convert differences with SimClock::elapsed_ns
+using Timestamp = SimClock::Timestamp;
+
+//Defining an order below
+enum class Side : uint8_t { BUY, SELL };
+//NEW places an order, CANCEL removes resting order `id`, MODIFY sets its remaining quantity
+enum class MsgType : uint8_t { NEW, CANCEL, MODIFY };
+//how a NEW order trades and what happens to its remainder
+enum class OrderType : uint8_t {
+    LIMIT,    //trades up to its price, the remainder rests
+    MARKET,   //trades at any price, the remainder is cancelled
+    IOC,      //immediate-or-cancel: trades up to its price, the remainder is cancelled
+    FOK,      //fill-or-kill: trades its whole quantity up to its price or nothing at all
+    POST_ONLY //rests at its price, rejected instead if it would trade on arrival
+};
+constexpr size_t ORDER_TYPE_COUNT = 5;
+
+inline const char* to_string(OrderType type) {
+    switch (type) {
+        case OrderType::LIMIT: return "limit";
+        case OrderType::MARKET: return "market";
+        case OrderType::IOC: return "ioc";
+        case OrderType::FOK: return "fok";
+        case OrderType::POST_ONLY: return "post-only";
+    }
+    return "?";
+}
+
+//whether raw fields from outside the process make an order an engine may see: enums in range, a symbol the
+//run trades, a NEW for a positive quantity and a MODIFY for none below zero (a book rests a NEW for zero or
+//less as is, and a negative resting quantity turns into a negative fill)
+inline bool valid_order_fields(uint8_t type, uint8_t side, uint8_t order_type, size_t symbol, Quantity quantity,
+                               size_t num_symbols) {
+    if (type > static_cast<uint8_t>(MsgType::MODIFY) || side > 1 || order_type >= ORDER_TYPE_COUNT
+        || symbol >= num_symbols) {
+        return false;
+    }
+    if (type == static_cast<uint8_t>(MsgType::NEW)) {
+        return quantity > 0;
+    }
+    return type != static_cast<uint8_t>(MsgType::MODIFY) || quantity >= 0;
+}
+
+//the hot representation: what is copied through the transport and into the book. no padding, fields
+//ordered widest first, and no instrumentation - the timestamps live in the cold OrderTimeline table
+//(order_timeline.h), found through producer_id and sequence
+struct Order {
+    OrderID id;          //the order's id, or the target of a CANCEL/MODIFY
+    Price price;
+    Quantity quantity;
+    uint32_t sequence;   //per-producer message number, indexes that producer's timeline slots
+    SymbolID symbol;     //instrument, decides which engine shard and book the order goes to
+    uint8_t producer_id; //client that sent the order, used for return reports and per-producer latency
+    MsgType type : 3;
+    Side side : 1;
+    OrderType order_type : 4; //NEW only, LIMIT when zero-initialised
+};
+static_assert(sizeof(Order) == 24, "the hot Order layout must stay at 24 bytes, eight orders per three cache lines");
+
+//producer_id is 8 bits wide
+constexpr size_t MAX_PRODUCERS = 256;
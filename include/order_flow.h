@@ -0,0 +1,282 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include "order.h"
+
+enum class PriceDistribution {
+    UNIFORM, //every tick in mid +- range equally likely
+    NORMAL   //centred on mid with price_stddev ticks, clamped to mid +- range
+};
+
+enum class QuantityDistribution {
+    UNIFORM,  //min..max equally likely
+    GEOMETRIC //mostly small orders with a long tail, mean_quantity on average, clamped to min..max
+};
+
+//how producers decide when to send
+enum class Pacing {
+    CLOSED_LOOP, //wait a gap after each send, so a slow send delays every later order (the original behaviour)
+    OPEN_LOOP    //send on a schedule fixed by the rate alone and measure latency from the scheduled time
+};
+
+//spacing of open-loop arrivals (bursts of burst_size when it is above 1)
+enum class ArrivalProcess {
+    CONSTANT, //evenly spaced at the rate
+    POISSON   //exponential gaps with the rate as mean
+};
+
+inline const char* to_string(Pacing pacing) {
+    return pacing == Pacing::OPEN_LOOP ? "open loop" : "closed loop";
+}
+
+inline const char* to_string(ArrivalProcess arrival) {
+    return arrival == ArrivalProcess::POISSON ? "poisson" : "constant";
+}
+
+inline const char* to_string(PriceDistribution distribution) {
+    return distribution == PriceDistribution::NORMAL ? "normal" : "uniform";
+}
+
+inline const char* to_string(QuantityDistribution distribution) {
+    return distribution == QuantityDistribution::GEOMETRIC ? "geometric" : "uniform";
+}
+
+//cancels and modifies pick one of this many of the client's latest orders
+constexpr size_t RECENT_ORDER_IDS = 64;
+
+//what each producer sends and how fast. the defaults are the original flow: uniform 95-105,
+//1-10 lots, even sides, 10% cancels and 10% modifies, one order per producer gap
+struct OrderFlowProfile {
+    double rate = 0.0; //orders per second per producer, 0 = one order per producer_gap
+    Price mid_price = 100;
+    PriceDistribution price_distribution = PriceDistribution::UNIFORM;
+    int price_range = 5;       //ticks either side of mid
+    double price_stddev = 2.0; //NORMAL only
+    QuantityDistribution quantity_distribution = QuantityDistribution::UNIFORM;
+    Quantity min_quantity = 1;
+    Quantity max_quantity = 10;
+    double mean_quantity = 3.0; //GEOMETRIC only
+    int buy_percent = 50;       //side skew of new orders
+    int cancel_percent = 10;
+    int modify_percent = 10;
+    //shares of new orders sent as each non-limit type, the rest are limit orders
+    int market_percent = 0;
+    int ioc_percent = 0;
+    int fok_percent = 0;
+    int post_only_percent = 0;
+    size_t burst_size = 1; //orders sent back to back, then burst_size gaps of silence, same average rate
+    //one-sided build-ups: this many new orders all on one side, then one IOC on the other side priced
+    //through the whole band and sized to the build-up, then the sides swap. 0 = sides drawn per buy_percent
+    size_t build_up_orders = 0;
+    double trend = 0.0; //ticks the mid moves per 1000 new orders from each producer, negative = down
+    Pacing pacing = Pacing::CLOSED_LOOP;
+    ArrivalProcess arrival = ArrivalProcess::CONSTANT; //OPEN_LOOP only
+
+    //"" when the profile is usable, otherwise what is wrong with it
+    std::string validate() const {
+        if (rate < 0.0) {
+            return "rate must not be negative";
+        }
+        if (price_range < 0 || price_stddev <= 0.0) {
+            return "price_range must not be negative and price_stddev must be positive";
+        }
+        if (min_quantity < 1 || max_quantity < min_quantity) {
+            return "quantities must satisfy 1 <= min_quantity <= max_quantity";
+        }
+        if (quantity_distribution == QuantityDistribution::GEOMETRIC && mean_quantity <= min_quantity) {
+            return "mean_quantity must be above min_quantity";
+        }
+        if (buy_percent < 0 || buy_percent > 100 || cancel_percent < 0 || modify_percent < 0
+            || cancel_percent + modify_percent > 100) {
+            return "percentages must be 0-100 and cancel_percent + modify_percent at most 100";
+        }
+        if (market_percent < 0 || ioc_percent < 0 || fok_percent < 0 || post_only_percent < 0
+            || non_limit_percent() > 100) {
+            return "order type percentages must not be negative and add up to at most 100";
+        }
+        if (burst_size < 1) {
+            return "burst_size must be at least 1";
+        }
+        if (!std::isfinite(trend)) {
+            return "trend must be a number";
+        }
+        if (pacing == Pacing::OPEN_LOOP && rate <= 0.0) {
+            return "open loop pacing needs a rate";
+        }
+        return "";
+    }
+
+    int non_limit_percent() const {
+        return market_percent + ioc_percent + fok_percent + post_only_percent;
+    }
+};
+
+//Order Flow Class below
+//one producer's generator: draws the next message from the profile and says how long to wait after it.
+//owns the producer's random engine, so a fixed seed gives the same flow every run
+class OrderFlow {
+public:
+    OrderFlow(const OrderFlowProfile& profile, size_t num_symbols, uint64_t seed,
+              std::chrono::nanoseconds fixed_gap)
+        : profile(profile),
+          gen(static_cast<std::mt19937::result_type>(seed)),
+          uniform_price(profile.mid_price - profile.price_range, profile.mid_price + profile.price_range),
+          normal_price(static_cast<double>(profile.mid_price), profile.price_stddev),
+          uniform_quantity(profile.min_quantity, profile.max_quantity),
+          geometric_quantity(geometric_p(profile)),
+          percent(0, 99),
+          symbol_dist(0, static_cast<SymbolID>(num_symbols - 1)),
+          arrival_gap(profile.rate > 0.0 ? profile.rate : 1.0),
+          gap(profile.rate > 0.0 ? std::chrono::nanoseconds(static_cast<int64_t>(1e9 / profile.rate)) : fixed_gap) {}
+
+    //fills in the next message, new order ids come from ids (shared by every producer)
+    void next(Order& order, std::atomic<uint64_t>& ids) {
+        int action = percent(gen);
+        if (sent_count > 0 && action < profile.cancel_percent + profile.modify_percent) {
+            size_t window = std::min(sent_count, RECENT_ORDER_IDS);
+            const RecentOrder& target = recent[std::uniform_int_distribution<size_t>(0, window - 1)(gen)];
+            order.id = target.id;
+            order.symbol = target.symbol;
+            order.type = (action < profile.cancel_percent) ? MsgType::CANCEL : MsgType::MODIFY;
+            order.quantity = quantity(); //new remaining quantity for a modify
+        } else if (profile.build_up_orders > 0 && built == profile.build_up_orders) {
+            //the sweep: takes everything the build-up left on the book it last added to, then rests nothing
+            order.id = ids.fetch_add(1, std::memory_order_relaxed);
+            order.symbol = build_symbol;
+            order.type = MsgType::NEW;
+            order.side = build_side == Side::BUY ? Side::SELL : Side::BUY;
+            order.price = drifted(order.side == Side::BUY ? profile.mid_price + profile.price_range
+                                                          : profile.mid_price - profile.price_range);
+            order.quantity = static_cast<Quantity>(std::min<long long>(built_quantity, INT32_MAX));
+            order.order_type = OrderType::IOC;
+            build_side = order.side;
+            built = 0;
+            built_quantity = 0;
+            ++new_count;
+        } else {
+            order.id = ids.fetch_add(1, std::memory_order_relaxed);
+            order.symbol = symbol_dist(gen);
+            order.type = MsgType::NEW;
+            order.side = percent(gen) < profile.buy_percent ? Side::BUY : Side::SELL;
+            order.price = price();
+            order.quantity = quantity();
+            order.order_type = order_type();
+            recent[sent_count++ % RECENT_ORDER_IDS] = RecentOrder{order.id, order.symbol};
+            if (profile.build_up_orders > 0) {
+                order.side = build_side;
+                build_symbol = order.symbol;
+                ++built;
+                built_quantity += order.quantity;
+            }
+            ++new_count;
+        }
+    }
+
+    //closed loop: wait after the message just sent, nothing inside a burst, the whole burst's gaps after it
+    std::chrono::nanoseconds pause() {
+        if (++in_burst < profile.burst_size) {
+            return std::chrono::nanoseconds(0);
+        }
+        in_burst = 0;
+        return gap * static_cast<int64_t>(profile.burst_size);
+    }
+    //open loop: when the next message is due. the schedule starts at start and only depends on the rate,
+    //arrival process and burst size, never on how long earlier sends took
+    Timestamp next_arrival(Timestamp start) {
+        if (in_burst++ == 0) {
+            double gap_ns = 1e9 / profile.rate * static_cast<double>(profile.burst_size);
+            if (profile.arrival == ArrivalProcess::POISSON) {
+                gap_ns = arrival_gap(gen) * 1e9 * static_cast<double>(profile.burst_size);
+            }
+            schedule_ns += gap_ns;
+        }
+        if (in_burst == profile.burst_size) {
+            in_burst = 0;
+        }
+        return start + SimClock::ticks_from_ns(static_cast<long long>(schedule_ns));
+    }
+private:
+    //this client's recent orders, the targets for cancels and modifies
+    struct RecentOrder {
+        OrderID id;
+        SymbolID symbol;
+    };
+
+    OrderFlowProfile profile;
+    std::mt19937 gen;
+    std::uniform_int_distribution<Price> uniform_price;
+    std::normal_distribution<double> normal_price;
+    std::uniform_int_distribution<Quantity> uniform_quantity;
+    std::geometric_distribution<Quantity> geometric_quantity;
+    std::uniform_int_distribution<int> percent;
+    std::uniform_int_distribution<SymbolID> symbol_dist;
+    std::exponential_distribution<double> arrival_gap; //seconds between poisson arrivals
+    std::chrono::nanoseconds gap;
+    double schedule_ns = 0.0; //open loop: due time of the current burst, from the schedule's start
+    RecentOrder recent[RECENT_ORDER_IDS] = {};
+    size_t sent_count = 0;
+    size_t in_burst = 0;
+    uint64_t new_count = 0;       //new orders sent, moves the mid when the profile trends
+    Side build_side = Side::BUY;  //side the current build-up adds to
+    size_t built = 0;             //new orders in the current build-up
+    SymbolID build_symbol = 0;    //book the build-up last added to
+    long long built_quantity = 0; //their total quantity, the size of the sweep that ends it
+
+    //success probability giving mean_quantity - min_quantity extra lots on average, kept inside (0, 1)
+    //for uniform profiles that never draw from it
+    static double geometric_p(const OrderFlowProfile& profile) {
+        return 1.0 / (std::max(profile.mean_quantity - profile.min_quantity, 0.01) + 1.0);
+    }
+
+    Price price() {
+        if (profile.price_distribution == PriceDistribution::UNIFORM) {
+            return drifted(uniform_price(gen));
+        }
+        Price drawn = static_cast<Price>(std::lround(normal_price(gen)));
+        return drifted(std::clamp(drawn, profile.mid_price - profile.price_range, profile.mid_price + profile.price_range));
+    }
+
+    //moves a price drawn around mid_price with the trend so far, never below one tick
+    Price drifted(Price price) const {
+        if (profile.trend == 0.0) {
+            return price;
+        }
+        double shift = profile.trend * static_cast<double>(new_count) / 1000.0;
+        return static_cast<Price>(std::clamp(static_cast<double>(price) + std::round(shift), 1.0, 2e9));
+    }
+
+    Quantity quantity() {
+        if (profile.quantity_distribution == QuantityDistribution::UNIFORM) {
+            return uniform_quantity(gen);
+        }
+        return std::min(profile.min_quantity + geometric_quantity(gen), profile.max_quantity);
+    }
+
+    //only draws when some orders are not limit orders, so an all-limit profile generates the same flow
+    //for a seed as before the order types existed
+    OrderType order_type() {
+        if (profile.non_limit_percent() == 0) {
+            return OrderType::LIMIT;
+        }
+        int draw = percent(gen);
+        if ((draw -= profile.market_percent) < 0) {
+            return OrderType::MARKET;
+        }
+        if ((draw -= profile.ioc_percent) < 0) {
+            return OrderType::IOC;
+        }
+        if ((draw -= profile.fok_percent) < 0) {
+            return OrderType::FOK;
+        }
+        if ((draw -= profile.post_only_percent) < 0) {
+            return OrderType::POST_ONLY;
+        }
+        return OrderType::LIMIT;
+    }
+};
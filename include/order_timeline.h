@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include "order.h"
+#include "memory_pool.h"
+
+//the cold side of an order: the instrumentation the hot Order leaves out
+struct OrderTimeline {
+    Timestamp intended;  //when the schedule wanted it sent, equal to produce unless the producer runs open loop
+    Timestamp produce;   //order created by producer
+    Timestamp consume;   //time when matching engine dequeued the order
+    Timestamp processed; //time when matching engine finished processing
+    Timestamp risk_in;   //risk checks started, 0 when risk is off
+    Timestamp risk_out;  //risk checks finished and the order was let through
+};
+
+//Timeline Table Class below
+//one ring of OrderTimeline slots per producer, carved from the arena and indexed by the order's
+//(producer_id, sequence). the producer claims the slot and writes produce before it sends, and the send/poll
+//through the transport orders that write before the engine's reads and its consume/processed writes.
+//whichever thread reads the slot last releases it. a producer that comes back round to a slot whose order
+//is still in flight is refused it and waits, so a deep transport can hold back the producer but never
+//overwrite the stamps of an order it still holds
+class TimelineTable {
+public:
+    TimelineTable(Arena& arena, size_t num_producers, size_t slots_per_producer)
+        : mask(round_up(slots_per_producer) - 1),
+          slots(arena.allocate_array<OrderTimeline>(num_producers * (mask + 1))),
+          busy(arena.allocate_array<std::atomic<uint8_t>>(num_producers * (mask + 1))) {
+        std::fill(slots, slots + num_producers * (mask + 1), OrderTimeline{});
+        for (size_t i = 0; i < num_producers * (mask + 1); ++i) {
+            new (&busy[i]) std::atomic<uint8_t>(0);
+        }
+    }
+    TimelineTable(const TimelineTable&) = delete;
+    TimelineTable& operator=(const TimelineTable&) = delete;
+
+    static size_t bytes_needed(size_t num_producers, size_t slots_per_producer) {
+        return Arena::reserve_for(num_producers * round_up(slots_per_producer) * sizeof(OrderTimeline))
+               + Arena::reserve_for(num_producers * round_up(slots_per_producer) * sizeof(std::atomic<uint8_t>));
+    }
+
+    //producer side: the order's slot, or nullptr while the order that used it last is still in flight
+    OrderTimeline* claim(const Order& order) {
+        size_t slot = index_of(order);
+        if (busy[slot].load(std::memory_order_acquire) != 0) {
+            return nullptr;
+        }
+        //published to the engine by the send that follows
+        busy[slot].store(1, std::memory_order_relaxed);
+        return &slots[slot];
+    }
+
+    //once nothing reads or writes the order's slot any more
+    void release(const Order& order) {
+        busy[index_of(order)].store(0, std::memory_order_release);
+    }
+
+    OrderTimeline& at(const Order& order) {
+        return slots[index_of(order)];
+    }
+
+    size_t slots_per_producer() const { return mask + 1; }
+private:
+    size_t mask;
+    OrderTimeline* slots;
+    std::atomic<uint8_t>* busy; //set from claim to release
+
+    size_t index_of(const Order& order) const {
+        return static_cast<size_t>(order.producer_id) * (mask + 1) + (order.sequence & mask);
+    }
+
+    static size_t round_up(size_t slots) {
+        size_t n = 2;
+        while (n < slots) {
+            n <<= 1;
+        }
+        return n;
+    }
+};
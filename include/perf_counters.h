@@ -0,0 +1,415 @@
+#pragma once
+#include <new>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "memory_pool.h"
+#include "latency_histogram.h"
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#elif defined(__APPLE__)
+#include <dlfcn.h>
+#endif
+
+//hardware events counted around a piece of code
+enum class PerfEvent {
+    CYCLES,
+    INSTRUCTIONS,
+    BRANCH_MISSES,
+    L1D_MISSES, //L1 data cache read misses
+    LLC_MISSES  //last level cache misses
+};
+constexpr size_t PERF_EVENT_COUNT = 5;
+
+inline const char* to_string(PerfEvent event) {
+    switch (event) {
+        case PerfEvent::CYCLES: return "cycles";
+        case PerfEvent::INSTRUCTIONS: return "instructions";
+        case PerfEvent::BRANCH_MISSES: return "branch-misses";
+        case PerfEvent::L1D_MISSES: return "L1d-misses";
+        case PerfEvent::LLC_MISSES: return "LLC-misses";
+    }
+    return "?";
+}
+
+//counter totals, indexed by PerfEvent
+struct PerfSample {
+    uint64_t values[PERF_EVENT_COUNT] = {};
+
+    uint64_t operator[](PerfEvent event) const {
+        return values[static_cast<size_t>(event)];
+    }
+
+    PerfSample operator-(const PerfSample& earlier) const {
+        PerfSample delta;
+        for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            delta.values[i] = values[i] - earlier.values[i];
+        }
+        return delta;
+    }
+
+    //an even share of a sample taken over count items
+    PerfSample share(uint64_t count) const {
+        PerfSample part;
+        for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            part.values[i] = count ? values[i] / count : 0;
+        }
+        return part;
+    }
+};
+
+//Perf Counters Class below
+//hardware counters for the calling thread, counted in user space only so they work at perf_event_paranoid 2.
+//Linux opens one perf_event group. on x86-64, where the kernel allows it, every event's page is mapped and
+//read() becomes a few rdpmc instructions with no system call, cheap enough to take per order; elsewhere
+//read() is one group read. macOS uses the fixed counters (cycles, instructions) of the private kperf
+//framework, which needs root. events the cpu or hypervisor does not expose are left out (available() is
+//false and they read 0), and with no counters at all ok() is false and every read is zero
+class PerfCounters {
+public:
+    PerfCounters() {
+#if defined(__linux__)
+        const uint64_t cache_read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        const uint32_t types[PERF_EVENT_COUNT] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                                  PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE};
+        const uint64_t configs[PERF_EVENT_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                    PERF_COUNT_HW_BRANCH_MISSES,
+                                                    PERF_COUNT_HW_CACHE_L1D | cache_read_miss,
+                                                    PERF_COUNT_HW_CACHE_LL | cache_read_miss};
+        for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[i];
+            attr.config = configs[i];
+            attr.disabled = leader < 0 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd < 0) {
+                if (leader < 0) {
+                    return;
+                }
+                continue;
+            }
+            if (leader < 0) {
+                leader = fd;
+            }
+            fds[i] = fd;
+            slot[i] = static_cast<int>(opened++);
+        }
+#if defined(__x86_64__)
+        map_pages();
+#endif
+#elif defined(__APPLE__)
+        open_kperf();
+#endif
+    }
+    ~PerfCounters() {
+#if defined(__linux__)
+        for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            if (pages[i]) {
+                munmap(const_cast<perf_event_mmap_page*>(pages[i]), page_bytes);
+            }
+            if (fds[i] >= 0) {
+                close(fds[i]);
+            }
+        }
+#endif
+    }
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool ok() const {
+#if defined(__APPLE__)
+        return kperf_read != nullptr;
+#else
+        return leader >= 0;
+#endif
+    }
+    bool available(PerfEvent event) const { return slot[static_cast<size_t>(event)] >= 0; }
+
+    //how read() gets its values
+    const char* backend() const {
+        if (!ok()) {
+            return "none";
+        }
+#if defined(__APPLE__)
+        return "kperf";
+#else
+        return user_read ? "perf_event, rdpmc" : "perf_event, read()";
+#endif
+    }
+
+    void start() {
+#if defined(__linux__)
+        if (ok()) {
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    void stop() {
+#if defined(__linux__)
+        if (ok()) {
+            ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    //running totals since the group was opened, take two and subtract for an interval
+    PerfSample read() const {
+        PerfSample sample;
+#if defined(__linux__)
+        if (!ok()) {
+            return sample;
+        }
+#if defined(__x86_64__)
+        if (user_read) {
+            for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+                if (pages[i]) {
+                    sample.values[i] = read_user(pages[i]);
+                }
+            }
+            return sample;
+        }
+#endif
+        uint64_t buffer[1 + PERF_EVENT_COUNT] = {};
+        if (::read(leader, buffer, sizeof(buffer)) < static_cast<ssize_t>(sizeof(uint64_t))) {
+            return sample;
+        }
+        for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            if (slot[i] >= 0 && static_cast<uint64_t>(slot[i]) < buffer[0]) {
+                sample.values[i] = buffer[1 + slot[i]];
+            }
+        }
+#elif defined(__APPLE__)
+        uint64_t buffer[KPC_MAX_COUNTERS] = {};
+        if (kperf_read && kperf_read(0, KPC_MAX_COUNTERS, buffer) == 0) {
+            for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+                if (slot[i] >= 0) {
+                    sample.values[i] = buffer[slot[i]];
+                }
+            }
+        }
+#endif
+        return sample;
+    }
+private:
+    int leader = -1;
+    int fds[PERF_EVENT_COUNT] = {-1, -1, -1, -1, -1};
+    int slot[PERF_EVENT_COUNT] = {-1, -1, -1, -1, -1}; //position in the group read (kperf: counter index), -1 if not opened
+    size_t opened = 0;
+#if defined(__linux__)
+    const volatile perf_event_mmap_page* pages[PERF_EVENT_COUNT] = {};
+    size_t page_bytes = 0;
+    bool user_read = false; //every opened event can be read with rdpmc
+
+#if defined(__x86_64__)
+    //rdpmc is only usable when the kernel says so for every event (cap_user_rdpmc, /sys/.../rdpmc)
+    void map_pages() {
+        if (!ok()) {
+            return;
+        }
+        page_bytes = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        user_read = true;
+        for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            if (fds[i] < 0) {
+                continue;
+            }
+            void* page = mmap(nullptr, page_bytes, PROT_READ, MAP_SHARED, fds[i], 0);
+            if (page == MAP_FAILED) {
+                user_read = false;
+                continue;
+            }
+            pages[i] = static_cast<const volatile perf_event_mmap_page*>(page);
+            user_read = user_read && pages[i]->cap_user_rdpmc;
+        }
+    }
+
+    static uint64_t rdpmc(uint32_t counter) {
+        uint32_t low, high;
+        asm volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(counter));
+        return low | (static_cast<uint64_t>(high) << 32);
+    }
+
+    //the kernel's seqlock protocol for the mapped page: its offset plus the live hardware counter, retried
+    //if the event was rescheduled in between
+    static uint64_t read_user(const volatile perf_event_mmap_page* page) {
+        uint32_t sequence;
+        uint64_t count;
+        do {
+            sequence = page->lock;
+            std::atomic_signal_fence(std::memory_order_acq_rel);
+            uint32_t index = page->index;
+            count = static_cast<uint64_t>(page->offset);
+            if (page->cap_user_rdpmc && index != 0) {
+                unsigned shift = 64u - page->pmc_width;
+                uint64_t raw = rdpmc(index - 1);
+                count += static_cast<uint64_t>(static_cast<int64_t>(raw << shift) >> shift);
+            }
+            std::atomic_signal_fence(std::memory_order_acq_rel);
+        } while (page->lock != sequence);
+        return count;
+    }
+#endif
+#elif defined(__APPLE__)
+    static constexpr uint32_t KPC_CLASS_FIXED_MASK = 1;
+    static constexpr uint32_t KPC_MAX_COUNTERS = 32;
+    int (*kperf_read)(uint32_t, uint32_t, uint64_t*) = nullptr; //kpc_get_thread_counters
+
+    //fixed counters only: configurable events need the kpep event database, which is left out
+    void open_kperf() {
+        void* kperf = dlopen("/System/Library/PrivateFrameworks/kperf.framework/kperf", RTLD_LAZY);
+        if (!kperf) {
+            return;
+        }
+        auto force_all = reinterpret_cast<int (*)(int)>(dlsym(kperf, "kpc_force_all_ctrs_set"));
+        auto set_counting = reinterpret_cast<int (*)(uint32_t)>(dlsym(kperf, "kpc_set_counting"));
+        auto set_thread_counting = reinterpret_cast<int (*)(uint32_t)>(dlsym(kperf, "kpc_set_thread_counting"));
+        auto get_thread_counters =
+            reinterpret_cast<int (*)(uint32_t, uint32_t, uint64_t*)>(dlsym(kperf, "kpc_get_thread_counters"));
+        if (!force_all || !set_counting || !set_thread_counting || !get_thread_counters
+            || force_all(1) != 0 || set_counting(KPC_CLASS_FIXED_MASK) != 0
+            || set_thread_counting(KPC_CLASS_FIXED_MASK) != 0) {
+            return;
+        }
+        kperf_read = get_thread_counters;
+#if defined(__arm64__)
+        slot[static_cast<size_t>(PerfEvent::CYCLES)] = 0;
+        slot[static_cast<size_t>(PerfEvent::INSTRUCTIONS)] = 1;
+#else
+        slot[static_cast<size_t>(PerfEvent::INSTRUCTIONS)] = 0;
+        slot[static_cast<size_t>(PerfEvent::CYCLES)] = 1;
+#endif
+    }
+#endif
+};
+
+//the two engine steps a sampled order is counted over
+enum class PerfStage { DEQUEUE, PROCESS };
+constexpr size_t PERF_STAGE_COUNT = 2;
+
+inline const char* to_string(PerfStage stage) {
+    switch (stage) {
+        case PerfStage::DEQUEUE: return "dequeue";
+        case PerfStage::PROCESS: return "process_order";
+    }
+    return "?";
+}
+
+//mean counts per order over a range of latency buckets
+struct PerfBand {
+    uint64_t orders = 0;
+    double means[PERF_STAGE_COUNT][PERF_EVENT_COUNT] = {};
+
+    double mean(PerfStage stage, PerfEvent event) const {
+        return means[static_cast<size_t>(stage)][static_cast<size_t>(event)];
+    }
+};
+
+//Perf Profile Class below
+//counter deltas of sampled orders summed per LatencyHistogram bucket of each order's latency, so the
+//counts can be read per latency band: do the p99.9 orders miss the cache or mispredict more than the
+//median ones. the buckets are carved from the arena and never allocate
+class PerfProfile {
+public:
+    explicit PerfProfile(Arena& arena)
+        : latencies(new (arena.allocate(sizeof(LatencyHistogram))) LatencyHistogram()),
+          buckets(arena.allocate_array<Bucket>(LatencyHistogram::BUCKET_COUNT)) {
+        std::memset(static_cast<void*>(buckets), 0, LatencyHistogram::BUCKET_COUNT * sizeof(Bucket));
+    }
+    PerfProfile(const PerfProfile&) = delete;
+    PerfProfile& operator=(const PerfProfile&) = delete;
+
+    static size_t bytes_needed() {
+        return Arena::reserve_for(sizeof(LatencyHistogram))
+               + Arena::reserve_for(LatencyHistogram::BUCKET_COUNT * sizeof(Bucket));
+    }
+
+    //which events the sampling thread's counters could open, and how it read them
+    void set_source(const PerfCounters& counters) {
+        source = counters.backend();
+        for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            events[i] = counters.available(static_cast<PerfEvent>(i));
+        }
+    }
+
+    void record(long long latency_ns, const PerfSample& dequeue, const PerfSample& process) {
+        latencies->record_ns(latency_ns);
+        Bucket& bucket = buckets[LatencyHistogram::index_of(latency_ns > 0 ? static_cast<uint64_t>(latency_ns) : 0)];
+        ++bucket.orders;
+        for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            bucket.sums[static_cast<size_t>(PerfStage::DEQUEUE)][i] += dequeue.values[i];
+            bucket.sums[static_cast<size_t>(PerfStage::PROCESS)][i] += process.values[i];
+        }
+    }
+
+    //the sampled orders between two percentiles of their own latency, at bucket granularity: a bucket
+    //belongs to the band its last order's percentile falls in, so the slowest bucket is always in the top band
+    PerfBand band(double from_percentile, double to_percentile) const {
+        PerfBand result;
+        const double total = static_cast<double>(latencies->count());
+        uint64_t sums[PERF_STAGE_COUNT][PERF_EVENT_COUNT] = {};
+        uint64_t through = 0;
+        for (size_t b = 0; b < LatencyHistogram::BUCKET_COUNT && through < latencies->count(); ++b) {
+            if (buckets[b].orders == 0) {
+                continue;
+            }
+            through += buckets[b].orders;
+            double percentile = 100.0 * static_cast<double>(through) / total;
+            if (percentile <= from_percentile || percentile > to_percentile) {
+                continue;
+            }
+            result.orders += buckets[b].orders;
+            for (size_t s = 0; s < PERF_STAGE_COUNT; ++s) {
+                for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+                    sums[s][i] += buckets[b].sums[s][i];
+                }
+            }
+        }
+        for (size_t s = 0; s < PERF_STAGE_COUNT && result.orders > 0; ++s) {
+            for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+                result.means[s][i] = static_cast<double>(sums[s][i]) / static_cast<double>(result.orders);
+            }
+        }
+        return result;
+    }
+
+    //folds another shard's profile into this one
+    void merge(const PerfProfile& other) {
+        latencies->merge(*other.latencies);
+        for (size_t b = 0; b < LatencyHistogram::BUCKET_COUNT; ++b) {
+            buckets[b].orders += other.buckets[b].orders;
+            for (size_t s = 0; s < PERF_STAGE_COUNT; ++s) {
+                for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+                    buckets[b].sums[s][i] += other.buckets[b].sums[s][i];
+                }
+            }
+        }
+        if (other.latencies->count() > 0 || !source) {
+            source = other.source;
+            std::memcpy(events, other.events, sizeof(events));
+        }
+    }
+
+    const LatencyHistogram& sampled() const { return *latencies; }
+    const char* backend() const { return source ? source : "none"; }
+    bool available(PerfEvent event) const { return events[static_cast<size_t>(event)]; }
+private:
+    struct Bucket {
+        uint64_t orders;
+        uint64_t sums[PERF_STAGE_COUNT][PERF_EVENT_COUNT];
+    };
+
+    LatencyHistogram* latencies; //of the sampled orders, decides the bands
+    Bucket* buckets;             //[latency bucket]
+    const char* source = nullptr;
+    bool events[PERF_EVENT_COUNT] = {};
+};
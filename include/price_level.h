@@ -0,0 +1,228 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <iostream>
+#include "order.h"
+#include "memory_pool.h"
+
+struct PriceLevel;
+
+//number of resting orders a book can hold, the pool and index are sized from it at startup
+constexpr size_t DEFAULT_MAX_ORDERS = 1 << 18;
+//number of distinct price levels the map backend can hold
+constexpr size_t DEFAULT_MAX_LEVELS = 1 << 14;
+//widest the ladder backend may grow its window to, in ticks. its level arrays are reserved at this width in
+//the arena, about 72 bytes a tick, so by default they take about as much as the order pool
+constexpr size_t DEFAULT_MAX_WINDOW = 1 << 18;
+
+//startup sizing for a book's pools, all drawn from the arena
+struct BookLimits {
+    size_t max_orders = DEFAULT_MAX_ORDERS;
+    size_t max_levels = DEFAULT_MAX_LEVELS;
+    ExhaustionPolicy policy = ExhaustionPolicy::REJECT;
+    size_t max_window = DEFAULT_MAX_WINDOW; //ladder only: orders that would need a wider window are rejected
+};
+
+//best price and the quantity resting there on each side, a side with quantity 0 is empty
+struct TopOfBook {
+    Price bid_price = 0;
+    Quantity bid_quantity = 0;
+    Price ask_price = 0;
+    Quantity ask_quantity = 0;
+};
+
+//one aggregated price level as market data sees it
+struct DepthLevel {
+    Price price;
+    Quantity quantity; //total resting at the price
+    uint32_t orders;   //resting orders making it up
+};
+
+//prints a TopOfBook the way the simulator reports final books
+inline void print_top_of_book(const TopOfBook& top) {
+    std::cout << "--- Top of Book ---\n";
+    if (top.bid_quantity == 0) {
+        std::cout << "BIDS: [EMPTY]\n";
+    } else {
+        std::cout << "BIDS: " << top.bid_quantity << " @ " << top.bid_price << "\n";
+    }
+    if (top.ask_quantity == 0) {
+        std::cout << "ASKS: [EMPTY]\n";
+    } else {
+        std::cout << "ASKS: " << top.ask_quantity << " @ " << top.ask_price << "\n";
+    }
+    std::cout << "-------------------\n";
+}
+
+//Resting order node, linked intrusively into its price level in time priority
+struct OrderNode {
+    OrderID id;
+    Side side;
+    Quantity quantity;
+    int producer_id; //owner, receives the passive side of fills
+    OrderNode* prev;
+    OrderNode* next; //also used as the free list link while the node sits in the pool
+    PriceLevel* level;
+};
+
+//FIFO queue of resting orders at one price
+struct PriceLevel {
+    Price price = 0;
+    Quantity total_quantity = 0;
+    uint32_t order_count = 0;
+    OrderNode* head = nullptr;
+    OrderNode* tail = nullptr;
+
+    bool empty() const {
+        return head == nullptr;
+    }
+
+    void push_back(OrderNode* node) {
+        node->level = this;
+        node->next = nullptr;
+        node->prev = tail;
+        if (tail) {
+            tail->next = node;
+        } else {
+            head = node;
+        }
+        tail = node;
+        total_quantity += node->quantity;
+        ++order_count;
+    }
+
+    void erase(OrderNode* node) {
+        if (node->prev) {
+            node->prev->next = node->next;
+        } else {
+            head = node->next;
+        }
+        if (node->next) {
+            node->next->prev = node->prev;
+        } else {
+            tail = node->prev;
+        }
+        total_quantity -= node->quantity;
+        --order_count;
+    }
+
+    //points every node back at this level, needed after the level object has been moved
+    void relink() {
+        for (OrderNode* node = head; node; node = node->next) {
+            node->level = this;
+        }
+    }
+};
+
+//Preallocated pool of order nodes so the matching thread never calls new
+using OrderNodePool = FixedPool<OrderNode>;
+
+//Open-addressing OrderID -> node index with linear probing and backward-shift deletion.
+//sized once at startup (at least twice the pool capacity) with its slots in the arena, so it never rehashes.
+class OrderIndex {
+public:
+    OrderIndex(Arena& arena, size_t max_orders) : mask(slot_count(max_orders) - 1) {
+        slots = arena.allocate_array<Slot>(mask + 1);
+        std::fill(slots, slots + mask + 1, Slot{0, nullptr});
+    }
+    OrderIndex(const OrderIndex&) = delete;
+    OrderIndex& operator=(const OrderIndex&) = delete;
+
+    static size_t bytes_needed(size_t max_orders) {
+        return Arena::reserve_for(slot_count(max_orders) * sizeof(Slot));
+    }
+
+    //returns false, leaving the table as it was, when id is already resting or the table is full. the table
+    //only fills up if the node pool falls back to the heap
+    bool insert(OrderID id, OrderNode* node) {
+        size_t i = slot_for(id);
+        while (slots[i].node) {
+            if (slots[i].id == id) {
+                return false;
+            }
+            i = (i + 1) & mask;
+        }
+        if (count + 1 >= mask) {
+            return false;
+        }
+        ++count;
+        slots[i] = Slot{id, node};
+        return true;
+    }
+
+    OrderNode* find(OrderID id) const {
+        for (size_t i = slot_for(id); slots[i].node; i = (i + 1) & mask) {
+            if (slots[i].id == id) {
+                return slots[i].node;
+            }
+        }
+        return nullptr;
+    }
+
+    void erase(OrderID id) {
+        size_t i = slot_for(id);
+        while (slots[i].node && slots[i].id != id) {
+            i = (i + 1) & mask;
+        }
+        if (!slots[i].node) {
+            return;
+        }
+        //shift later entries of the probe chain back so lookups never need tombstones
+        size_t hole = i;
+        for (size_t j = (i + 1) & mask; slots[j].node; j = (j + 1) & mask) {
+            size_t home = slot_for(slots[j].id);
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                slots[hole] = slots[j];
+                hole = j;
+            }
+        }
+        slots[hole] = Slot{0, nullptr};
+        --count;
+    }
+
+    size_t size() const { return count; }
+private:
+    struct Slot {
+        OrderID id;
+        OrderNode* node;
+    };
+    Slot* slots;
+    size_t mask;
+    size_t count = 0;
+
+    static size_t slot_count(size_t max_orders) {
+        size_t n = 16;
+        while (n < max_orders * 2) {
+            n <<= 1;
+        }
+        return n;
+    }
+
+    size_t slot_for(OrderID id) const {
+        return static_cast<size_t>((id * 0x9E3779B97F4A7C15ULL) >> 20) & mask;
+    }
+};
+
+//fills an incoming quantity against a level in time priority, releasing fully filled resting orders.
+//on_fill(resting, matched, remaining) sees each match after the quantities are updated and before a
+//filled node is released. returns the incoming quantity left over
+template <typename OnFill>
+inline Quantity fill_level(PriceLevel& level, Quantity quantity, OrderIndex& index, OrderNodePool& pool,
+                           OnFill&& on_fill) {
+    while (quantity > 0 && level.head) {
+        OrderNode* resting = level.head;
+        Quantity matched_quantity = std::min(quantity, resting->quantity);
+        quantity -= matched_quantity;
+        resting->quantity -= matched_quantity;
+        level.total_quantity -= matched_quantity;
+        on_fill(*resting, matched_quantity, quantity);
+        //if the resting order is filled then unlink it
+        if (resting->quantity == 0) {
+            level.erase(resting);
+            index.erase(resting->id);
+            pool.release(resting);
+        }
+    }
+    return quantity;
+}
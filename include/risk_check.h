@@ -0,0 +1,241 @@
+#pragma once
+#include <tuple>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include "order.h"
+#include "memory_pool.h"
+#include "price_level.h"
+
+//Pre-trade risk below: the checks an order passes before it may reach the book. a stage is a RiskChain of
+//checks, each with the same three calls:
+//  bytes_needed(limits, lanes, symbols)  arena bytes for its per-client state
+//  check(order, now, top_of)             pure, returns PASS or why the order is rejected. top_of(symbol)
+//                                        gives the reference book, only called by checks that need it
+//  commit(order, now)                    updates the state once every check in the chain has passed
+//so a rejected order leaves no trace and a new check is one more template argument. state is carved from
+//the owning shard's arena up front, nothing allocates per order
+
+//where the checks run: not at all, on the engine thread before matching, or on a thread of their own
+//between the producers and the engine
+enum class RiskMode { OFF, INLINE, PIPELINED };
+
+inline const char* to_string(RiskMode mode) {
+    switch (mode) {
+        case RiskMode::OFF: return "off";
+        case RiskMode::INLINE: return "inline";
+        case RiskMode::PIPELINED: return "pipelined";
+    }
+    return "?";
+}
+
+enum class RiskReject : uint8_t { PASS, QUANTITY, COLLAR, POSITION, RATE };
+constexpr size_t RISK_REJECT_COUNT = 5;
+
+inline const char* to_string(RiskReject reject) {
+    switch (reject) {
+        case RiskReject::PASS: return "pass";
+        case RiskReject::QUANTITY: return "max quantity";
+        case RiskReject::COLLAR: return "price collar";
+        case RiskReject::POSITION: return "position limit";
+        case RiskReject::RATE: return "rate limit";
+    }
+    return "?";
+}
+
+//every limit at 0 leaves its check out
+struct RiskLimits {
+    Quantity max_quantity = 0;  //largest new or modified quantity
+    Price collar_ticks = 0;     //furthest a limit price may be from the reference price
+    long long max_position = 0; //largest net quantity a client's accepted new orders may add up to, per symbol
+    double max_rate = 0.0;      //messages per second per client
+    double rate_burst = 100.0;  //messages a client may send back to back before max_rate applies
+};
+
+//what a stage saw over a run
+struct RiskStats {
+    uint64_t checked = 0;
+    uint64_t rejected[RISK_REJECT_COUNT] = {}; //indexed by RiskReject, PASS stays 0
+
+    void add(const RiskStats& other) {
+        checked += other.checked;
+        for (size_t i = 0; i < RISK_REJECT_COUNT; ++i) {
+            rejected[i] += other.rejected[i];
+        }
+    }
+
+    uint64_t total_rejected() const {
+        uint64_t total = 0;
+        for (uint64_t count : rejected) {
+            total += count;
+        }
+        return total;
+    }
+};
+
+//new orders and modifies above max_quantity
+class MaxQuantityCheck {
+public:
+    MaxQuantityCheck(Arena&, const RiskLimits& limits, size_t, size_t) : limit(limits.max_quantity) {}
+    static size_t bytes_needed(const RiskLimits&, size_t, size_t) { return 0; }
+
+    template <typename TopOf>
+    RiskReject check(const Order& order, Timestamp, TopOf&&) const {
+        return limit > 0 && order.type != MsgType::CANCEL && order.quantity > limit ? RiskReject::QUANTITY
+                                                                                     : RiskReject::PASS;
+    }
+    void commit(const Order&, Timestamp) {}
+private:
+    Quantity limit;
+};
+
+//new priced orders further than collar_ticks from the reference: the mid when both sides are quoted,
+//otherwise the one side that is. an empty book and market orders pass
+class PriceCollarCheck {
+public:
+    PriceCollarCheck(Arena&, const RiskLimits& limits, size_t, size_t) : collar(limits.collar_ticks) {}
+    static size_t bytes_needed(const RiskLimits&, size_t, size_t) { return 0; }
+
+    template <typename TopOf>
+    RiskReject check(const Order& order, Timestamp, TopOf&& top_of) const {
+        if (collar <= 0 || order.type != MsgType::NEW || order.order_type == OrderType::MARKET) {
+            return RiskReject::PASS;
+        }
+        TopOfBook top = top_of(order.symbol);
+        bool bids = top.bid_quantity > 0;
+        bool asks = top.ask_quantity > 0;
+        if (!bids && !asks) {
+            return RiskReject::PASS;
+        }
+        long long reference = bids && asks ? (static_cast<long long>(top.bid_price) + top.ask_price) / 2
+                                           : (bids ? top.bid_price : top.ask_price);
+        long long distance = static_cast<long long>(order.price) - reference;
+        return distance > collar || -distance > collar ? RiskReject::COLLAR : RiskReject::PASS;
+    }
+    void commit(const Order&, Timestamp) {}
+private:
+    Price collar;
+};
+
+//the client's net accepted quantity per symbol (buys minus sells of the new orders that passed), the
+//conservative pre-trade view that counts every accepted order as filled
+class PositionCheck {
+public:
+    PositionCheck(Arena& arena, const RiskLimits& limits, size_t lanes, size_t symbols)
+        : limit(limits.max_position), symbols(symbols),
+          positions(limit > 0 ? arena.allocate_array<long long>(lanes * symbols) : nullptr) {
+        if (positions) {
+            std::fill(positions, positions + lanes * symbols, 0LL);
+        }
+    }
+    static size_t bytes_needed(const RiskLimits& limits, size_t lanes, size_t symbols) {
+        return limits.max_position > 0 ? Arena::reserve_for(lanes * symbols * sizeof(long long)) : 0;
+    }
+
+    template <typename TopOf>
+    RiskReject check(const Order& order, Timestamp, TopOf&&) const {
+        if (!positions || order.type != MsgType::NEW) {
+            return RiskReject::PASS;
+        }
+        long long after = position(order) + signed_quantity(order);
+        return after > limit || -after > limit ? RiskReject::POSITION : RiskReject::PASS;
+    }
+    void commit(const Order& order, Timestamp) {
+        if (positions && order.type == MsgType::NEW) {
+            position(order) += signed_quantity(order);
+        }
+    }
+private:
+    long long limit;
+    size_t symbols;
+    long long* positions; //[lane][symbol]
+
+    long long& position(const Order& order) const {
+        return positions[static_cast<size_t>(order.producer_id) * symbols + order.symbol];
+    }
+    static long long signed_quantity(const Order& order) {
+        return order.side == Side::BUY ? order.quantity : -static_cast<long long>(order.quantity);
+    }
+};
+
+//a token bucket per client: rate_burst deep, refilled at max_rate. every message takes a token
+class RateCheck {
+public:
+    RateCheck(Arena& arena, const RiskLimits& limits, size_t lanes, size_t)
+        : per_ns(limits.max_rate / 1e9), burst(std::max(limits.rate_burst, 1.0)),
+          buckets(limits.max_rate > 0.0 ? arena.allocate_array<Bucket>(lanes) : nullptr) {
+        if (buckets) {
+            std::fill(buckets, buckets + lanes, Bucket{burst, 0});
+        }
+    }
+    static size_t bytes_needed(const RiskLimits& limits, size_t lanes, size_t) {
+        return limits.max_rate > 0.0 ? Arena::reserve_for(lanes * sizeof(Bucket)) : 0;
+    }
+
+    template <typename TopOf>
+    RiskReject check(const Order& order, Timestamp now, TopOf&&) {
+        if (!buckets) {
+            return RiskReject::PASS;
+        }
+        Bucket& bucket = buckets[order.producer_id];
+        if (bucket.last != 0) {
+            double refill = static_cast<double>(std::max(SimClock::elapsed_ns(bucket.last, now), 0LL)) * per_ns;
+            bucket.tokens = std::min(burst, bucket.tokens + refill);
+        }
+        bucket.last = now;
+        return bucket.tokens >= 1.0 ? RiskReject::PASS : RiskReject::RATE;
+    }
+    void commit(const Order& order, Timestamp) {
+        if (buckets) {
+            buckets[order.producer_id].tokens -= 1.0;
+        }
+    }
+private:
+    struct Bucket {
+        double tokens;
+        Timestamp last; //0 until the client's first message
+    };
+
+    double per_ns;
+    double burst;
+    Bucket* buckets;
+};
+
+//Risk Chain Class below
+//runs Checks in order and stops at the first reject, then commits every check when the order passed
+template <typename... Checks>
+class RiskChain {
+public:
+    RiskChain(Arena& arena, const RiskLimits& limits, size_t lanes, size_t symbols)
+        : checks(Checks(arena, limits, lanes, symbols)...) {}
+    RiskChain(const RiskChain&) = delete;
+    RiskChain& operator=(const RiskChain&) = delete;
+
+    static size_t bytes_needed(const RiskLimits& limits, size_t lanes, size_t symbols) {
+        return (Checks::bytes_needed(limits, lanes, symbols) + ... + 0);
+    }
+
+    template <typename TopOf>
+    RiskReject check(const Order& order, Timestamp now, TopOf&& top_of) {
+        ++counts.checked;
+        RiskReject verdict = std::apply([&](auto&... check) {
+            RiskReject first = RiskReject::PASS;
+            ((first = first == RiskReject::PASS ? check.check(order, now, top_of) : first), ...);
+            return first;
+        }, checks);
+        if (verdict == RiskReject::PASS) {
+            std::apply([&](auto&... check) { (check.commit(order, now), ...); }, checks);
+        } else {
+            ++counts.rejected[static_cast<size_t>(verdict)];
+        }
+        return verdict;
+    }
+
+    const RiskStats& stats() const { return counts; }
+private:
+    std::tuple<Checks...> checks;
+    RiskStats counts;
+};
+
+//the chain the engine runs
+using RiskStage = RiskChain<MaxQuantityCheck, PriceCollarCheck, PositionCheck, RateCheck>;
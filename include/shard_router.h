@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "order.h"
+
+//Shard Router Class below
+//maps every symbol to one of N engine shards by hashing its id. the table is built once at startup,
+//so routing an order on the producer side is a single load, and each shard gets the list of symbols it owns
+class ShardRouter {
+public:
+    ShardRouter(size_t num_shards, size_t num_symbols) : owner(num_symbols), owned(num_shards) {
+        for (size_t symbol = 0; symbol < num_symbols; ++symbol) {
+            owner[symbol] = static_cast<uint32_t>(hash(symbol) % num_shards);
+            owned[owner[symbol]].push_back(static_cast<SymbolID>(symbol));
+        }
+    }
+
+    size_t shard_of(SymbolID symbol) const {
+        return owner[symbol];
+    }
+
+    const std::vector<SymbolID>& symbols_of(size_t shard) const {
+        return owned[shard];
+    }
+
+    size_t shard_count() const { return owned.size(); }
+    size_t symbol_count() const { return owner.size(); }
+
+    //splitmix64 finaliser, so consecutive symbol ids do not land on consecutive shards
+    static uint64_t hash(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+private:
+    std::vector<uint32_t> owner;              //[symbol] -> shard
+    std::vector<std::vector<SymbolID>> owned; //[shard] -> symbols
+};
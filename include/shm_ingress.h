@@ -0,0 +1,348 @@
+#pragma once
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "memory_pool.h"
+#include "order.h"
+#include "latency_histogram.h"
+
+//Shared memory ingress below: external client processes submit orders to a running engine through a POSIX
+//shared memory segment with one SPSC ring per client slot. a client claims a free slot, pushes records and
+//never waits for the engine; the engine's ingress thread drains the rings into the same transports the
+//in-process producers use. every record carries the client's produce stamp, taken on the shared clock
+//(the TSC is one counter for the whole machine, steady_clock is CLOCK_MONOTONIC), so the engine can time
+//the cross-process path exactly like the in-process one
+constexpr char INGRESS_MAGIC[8] = {'L', 'L', 'S', 'I', 'M', 'I', 'N', 'G'};
+constexpr uint32_t INGRESS_VERSION = 1;
+constexpr size_t INGRESS_CLOCK_NAME = 32;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring indices are shared across processes");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "slot states are shared across processes");
+
+//one order as a client sends it. the engine sets order.producer_id to the client's lane, the client
+//numbers its own orders in order.sequence
+struct IngressRecord {
+    Order order;
+    Timestamp produce;  //client clock when it was pushed
+    Timestamp intended; //scheduled send time, equal to produce unless the client runs open loop
+};
+static_assert(std::is_trivially_copyable<IngressRecord>::value, "records are copied through shared memory");
+
+//what the engine's ingress thread saw over a run
+struct IngressStats {
+    uint64_t received = 0;  //records taken off the rings
+    uint64_t malformed = 0; //of those, dropped for an out-of-range enum, symbol or quantity
+    uint64_t clients = 0;   //slots a client connected to at some point
+    uint64_t discarded = 0; //still on a ring when the run stopped
+    LatencyHistogram hop;   //client produce -> taken off the shared ring
+};
+
+//first bytes of a segment, written last when it is created so a client never attaches to a half-built one
+struct IngressHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t num_clients;
+    uint32_t capacity; //records per client ring, a power of two
+    uint32_t num_symbols;
+    uint32_t reserved;
+    char clock[INGRESS_CLOCK_NAME]; //SimClock::NAME of the engine, clients must stamp with the same one
+};
+static_assert(sizeof(IngressHeader) <= CACHE_LINE_SIZE, "the header sits in the segment's first cache line");
+
+namespace ingress_detail {
+enum : uint32_t { OPEN = 0, CLOSED = 1 };          //segment state, set by the engine
+enum : uint32_t { FREE = 0, CONNECTED = 1, LEFT = 2 }; //client slot state
+
+struct alignas(CACHE_LINE_SIZE) SegmentState {
+    std::atomic<uint32_t> state{OPEN};
+};
+
+struct alignas(CACHE_LINE_SIZE) SlotControl {
+    std::atomic<uint32_t> state{FREE};
+    std::atomic<uint32_t> connections{0}; //claims so far, keeps order ids unique across reconnects
+    int32_t pid = 0;
+};
+
+struct alignas(CACHE_LINE_SIZE) RingIndex {
+    std::atomic<uint64_t> value{0};
+};
+
+//a client block: its control line, the two ring indices on lines of their own, then the records
+inline size_t block_bytes(size_t capacity) {
+    size_t records = capacity * sizeof(IngressRecord);
+    return 3 * CACHE_LINE_SIZE + (records + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+}
+
+inline size_t segment_bytes(size_t num_clients, size_t capacity) {
+    return 2 * CACHE_LINE_SIZE + num_clients * block_bytes(capacity);
+}
+
+inline SegmentState* segment_state(void* segment) {
+    return reinterpret_cast<SegmentState*>(static_cast<char*>(segment) + CACHE_LINE_SIZE);
+}
+
+inline char* block(void* segment, size_t capacity, size_t client) {
+    return static_cast<char*>(segment) + 2 * CACHE_LINE_SIZE + client * block_bytes(capacity);
+}
+
+inline SlotControl* control(char* block) {
+    return reinterpret_cast<SlotControl*>(block);
+}
+
+inline size_t round_up(size_t capacity) {
+    size_t n = 2;
+    while (n < capacity) {
+        n <<= 1;
+    }
+    return n;
+}
+}
+
+//Ingress Ring Class below
+//one process's view of a client ring in the segment. the indices live in shared memory, the cached copy
+//of the other side's index is private to the view, so each side only reads the other's line when its
+//cached view says the ring is full (client) or empty (engine)
+class IngressRing {
+public:
+    IngressRing() = default;
+    IngressRing(char* block, size_t capacity)
+        : tail(reinterpret_cast<ingress_detail::RingIndex*>(block + CACHE_LINE_SIZE)),
+          head(reinterpret_cast<ingress_detail::RingIndex*>(block + 2 * CACHE_LINE_SIZE)),
+          records(reinterpret_cast<IngressRecord*>(block + 3 * CACHE_LINE_SIZE)),
+          mask(capacity - 1) {}
+
+    //client side, returns false when the ring is full
+    bool try_push(const IngressRecord& record) {
+        uint64_t position = tail->value.load(std::memory_order_relaxed);
+        if (position - cached_other > mask) {
+            cached_other = head->value.load(std::memory_order_acquire);
+            if (position - cached_other > mask) {
+                return false;
+            }
+        }
+        records[position & mask] = record;
+        tail->value.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    //engine side, pops up to max records with a single index publish
+    size_t try_pop_bulk(IngressRecord* out, size_t max) {
+        uint64_t position = head->value.load(std::memory_order_relaxed);
+        uint64_t available = cached_other - position;
+        if (available < max) {
+            cached_other = tail->value.load(std::memory_order_acquire);
+            available = cached_other - position;
+        }
+        size_t count = available < max ? static_cast<size_t>(available) : max;
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = records[(position + i) & mask];
+        }
+        if (count > 0) {
+            head->value.store(position + count, std::memory_order_release);
+        }
+        return count;
+    }
+private:
+    ingress_detail::RingIndex* tail = nullptr; //written by the client
+    ingress_detail::RingIndex* head = nullptr; //written by the engine
+    IngressRecord* records = nullptr;
+    uint64_t mask = 0;
+    uint64_t cached_other = 0;
+};
+
+//Ingress Segment Class below
+//the engine's end: creates the shared memory object shm_name (e.g. "/llsim_in") with num_clients client
+//slots and unlinks it again when it goes away. only the engine's ingress thread polls it
+class IngressSegment {
+public:
+    IngressSegment(const std::string& shm_name, size_t num_clients, size_t capacity, size_t num_symbols)
+        : shm_name(shm_name), clients(num_clients), ring_capacity(ingress_detail::round_up(capacity)),
+          bytes(ingress_detail::segment_bytes(num_clients, ring_capacity)) {
+        int fd = ::shm_open(shm_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+        if (fd < 0) {
+            error_message = "cannot create shared memory " + shm_name;
+            return;
+        }
+        void* data = MAP_FAILED;
+        if (::ftruncate(fd, static_cast<off_t>(bytes)) == 0) {
+            data = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            error_message = "cannot map " + std::to_string(bytes) + " bytes of ingress rings";
+            ::shm_unlink(shm_name.c_str());
+            return;
+        }
+        segment = data;
+        new (ingress_detail::segment_state(segment)) ingress_detail::SegmentState();
+        rings.reserve(clients);
+        for (size_t i = 0; i < clients; ++i) {
+            char* block = ingress_detail::block(segment, ring_capacity, i);
+            new (block) ingress_detail::SlotControl();
+            new (block + CACHE_LINE_SIZE) ingress_detail::RingIndex();
+            new (block + 2 * CACHE_LINE_SIZE) ingress_detail::RingIndex();
+            rings.emplace_back(block, ring_capacity);
+        }
+        IngressHeader header{};
+        std::memcpy(header.magic, INGRESS_MAGIC, sizeof(header.magic));
+        header.version = INGRESS_VERSION;
+        header.record_size = sizeof(IngressRecord);
+        header.num_clients = static_cast<uint32_t>(clients);
+        header.capacity = static_cast<uint32_t>(ring_capacity);
+        header.num_symbols = static_cast<uint32_t>(num_symbols);
+        std::strncpy(header.clock, SimClock::NAME, sizeof(header.clock) - 1);
+        std::memcpy(segment, &header, sizeof(header));
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    ~IngressSegment() {
+        if (segment) {
+            close();
+            ::munmap(segment, bytes);
+            ::shm_unlink(shm_name.c_str());
+        }
+    }
+    IngressSegment(const IngressSegment&) = delete;
+    IngressSegment& operator=(const IngressSegment&) = delete;
+
+    bool ok() const { return segment != nullptr; }
+    const std::string& error() const { return error_message; }
+    const std::string& name() const { return shm_name; }
+    size_t num_clients() const { return clients; }
+    size_t capacity() const { return ring_capacity; }
+
+    //ingress thread only
+    size_t poll(size_t client, IngressRecord* out, size_t max) {
+        return rings[client].try_pop_bulk(out, max);
+    }
+
+    //claims so far on a slot, 0 until a client first connects
+    uint32_t connections(size_t client) const {
+        char* block = ingress_detail::block(segment, ring_capacity, client);
+        return ingress_detail::control(block)->connections.load(std::memory_order_acquire);
+    }
+
+    //tells every client to stop sending, records already pushed stay on the rings
+    void close() {
+        ingress_detail::segment_state(segment)->state.store(ingress_detail::CLOSED, std::memory_order_release);
+    }
+private:
+    std::string shm_name;
+    size_t clients;
+    size_t ring_capacity;
+    size_t bytes;
+    void* segment = nullptr;
+    std::vector<IngressRing> rings;
+    std::string error_message;
+};
+
+//Ingress Client Class below
+//one external process's end: attaches to an engine's segment and claims the first free client slot.
+//a slot a previous client left can be claimed again, its ring carries on where that client stopped
+class IngressClient {
+public:
+    explicit IngressClient(const std::string& shm_name) {
+        int fd = ::shm_open(shm_name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            error_message = "no ingress at " + shm_name + " (is an engine running with ingress_shm set?)";
+            return;
+        }
+        struct stat info {};
+        if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < ingress_detail::segment_bytes(0, 0)) {
+            error_message = shm_name + " is too small to be an ingress segment";
+            ::close(fd);
+            return;
+        }
+        size_t size = static_cast<size_t>(info.st_size);
+        void* data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            error_message = "cannot map " + shm_name;
+            return;
+        }
+        segment = data;
+        bytes = size;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        IngressHeader header;
+        std::memcpy(&header, segment, sizeof(header));
+        if (std::memcmp(header.magic, INGRESS_MAGIC, sizeof(INGRESS_MAGIC)) != 0
+            || header.version != INGRESS_VERSION || header.record_size != sizeof(IngressRecord)
+            || ingress_detail::segment_bytes(header.num_clients, header.capacity) > bytes) {
+            error_message = shm_name + " is not a version " + std::to_string(INGRESS_VERSION) + " ingress segment";
+            return;
+        }
+        header.clock[sizeof(header.clock) - 1] = '\0';
+        if (std::strncmp(header.clock, SimClock::NAME, sizeof(header.clock) - 1) != 0) {
+            error_message = "the engine stamps with " + std::string(header.clock) + " but this build uses "
+                            + SimClock::NAME + ", latencies across the two would be meaningless";
+            return;
+        }
+        symbols = header.num_symbols;
+        for (size_t i = 0; i < header.num_clients; ++i) {
+            char* block = ingress_detail::block(segment, header.capacity, i);
+            ingress_detail::SlotControl* slot = ingress_detail::control(block);
+            uint32_t state = slot->state.load(std::memory_order_acquire);
+            if (state != ingress_detail::CONNECTED
+                && slot->state.compare_exchange_strong(state, ingress_detail::CONNECTED, std::memory_order_acq_rel)) {
+                slot->pid = static_cast<int32_t>(::getpid());
+                connection = slot->connections.fetch_add(1, std::memory_order_acq_rel);
+                control = slot;
+                client_index = i;
+                ring = IngressRing(block, header.capacity);
+                break;
+            }
+        }
+        if (!control) {
+            error_message = "all " + std::to_string(header.num_clients) + " client slots of " + shm_name + " are taken";
+        }
+    }
+    ~IngressClient() {
+        if (control) {
+            control->state.store(ingress_detail::LEFT, std::memory_order_release);
+        }
+        if (segment) {
+            ::munmap(segment, bytes);
+        }
+    }
+    IngressClient(const IngressClient&) = delete;
+    IngressClient& operator=(const IngressClient&) = delete;
+
+    bool ok() const { return control != nullptr; }
+    const std::string& error() const { return error_message; }
+    size_t index() const { return client_index; }
+    size_t num_symbols() const { return symbols; }
+
+    //ids of this connection's new orders start here, clear of the engine's own producers and of every other
+    //client and connection
+    OrderID first_order_id() const {
+        return (static_cast<OrderID>(client_index + 1) << 48) + (static_cast<OrderID>(connection) << 36);
+    }
+
+    //returns false when the ring is full
+    bool send(const IngressRecord& record) {
+        return ring.try_push(record);
+    }
+
+    //true once the engine has stopped taking orders
+    bool closed() const {
+        return ingress_detail::segment_state(segment)->state.load(std::memory_order_acquire) == ingress_detail::CLOSED;
+    }
+private:
+    void* segment = nullptr;
+    size_t bytes = 0;
+    ingress_detail::SlotControl* control = nullptr;
+    IngressRing ring;
+    size_t client_index = 0;
+    uint32_t connection = 0;
+    size_t symbols = 0;
+    std::string error_message;
+};
@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include "memory_pool.h"
+
+//SPSC Ring Class below
+//bounded single-producer single-consumer ring. the producer and consumer indices live on their own
+//cache lines, next to a cached copy of the other side's index, so in steady state each side only
+//touches the other's line when its cached view says the ring is full (producer) or empty (consumer)
+template <typename T>
+class SpscRing {
+    static_assert(std::is_trivially_copyable<T>::value, "ring slots are copied by value");
+public:
+    //capacity is rounded up to a power of two, slots come from the arena
+    SpscRing(Arena& arena, size_t capacity)
+        : mask(round_up(capacity) - 1), slots(arena.allocate_array<T>(mask + 1)) {}
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    static size_t bytes_needed(size_t capacity) {
+        return Arena::reserve_for(round_up(capacity) * sizeof(T));
+    }
+
+    //producer side, returns false when the ring is full
+    bool try_push(const T& item) {
+        size_t tail = producer.index.load(std::memory_order_relaxed);
+        if (tail - producer.cached_other > mask) {
+            producer.cached_other = consumer.index.load(std::memory_order_acquire);
+            if (tail - producer.cached_other > mask) {
+                return false;
+            }
+        }
+        slots[tail & mask] = item;
+        producer.index.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //consumer side, returns false when the ring is empty
+    bool try_pop(T& item) {
+        size_t head = consumer.index.load(std::memory_order_relaxed);
+        if (head == consumer.cached_other) {
+            consumer.cached_other = producer.index.load(std::memory_order_acquire);
+            if (head == consumer.cached_other) {
+                return false;
+            }
+        }
+        item = slots[head & mask];
+        consumer.index.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    //consumer side, pops up to max items in one go with a single index publish
+    size_t try_pop_bulk(T* items, size_t max) {
+        size_t head = consumer.index.load(std::memory_order_relaxed);
+        size_t available = consumer.cached_other - head;
+        if (available < max) {
+            consumer.cached_other = producer.index.load(std::memory_order_acquire);
+            available = consumer.cached_other - head;
+        }
+        size_t count = available < max ? available : max;
+        for (size_t i = 0; i < count; ++i) {
+            items[i] = slots[(head + i) & mask];
+        }
+        if (count > 0) {
+            consumer.index.store(head + count, std::memory_order_release);
+        }
+        return count;
+    }
+
+    //approximate, either side may be moving
+    size_t size_approx() const {
+        return producer.index.load(std::memory_order_acquire) - consumer.index.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return mask + 1; }
+private:
+    struct alignas(CACHE_LINE_SIZE) Side {
+        std::atomic<size_t> index{0};
+        size_t cached_other = 0; //last seen value of the other side's index
+    };
+
+    const size_t mask;
+    T* const slots;
+    Side producer;
+    Side consumer;
+
+    static size_t round_up(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) {
+            n <<= 1;
+        }
+        return n;
+    }
+};
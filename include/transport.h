@@ -0,0 +1,177 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include "concurrentqueue.h"
+#include "memory_pool.h"
+#include "spsc_ring.h"
+#include "order.h"
+
+//selects how orders get from the producer threads to the matching engine
+enum class TransportBackend {
+    QUEUE,       //one shared moodycamel::ConcurrentQueue, implicit producers (the original setup)
+    TOKEN_QUEUE, //the same queue used through a ProducerToken per producer and a ConsumerToken
+    SPSC_RINGS   //a dedicated cache-line padded SPSC ring per producer, polled round-robin
+};
+
+//Transports below all share one shape so the engine and producers can be templated on them:
+//  Transport(Arena&, size_t num_producers, size_t capacity_per_producer)
+//  static size_t arena_bytes(size_t num_producers, size_t capacity_per_producer)
+//  Producer producer(int id)         handle owned by one producer thread, with bool send(const Order&)
+//  bool poll(Order&)                 engine side, non-blocking
+//  size_t poll_bulk(Order*, size_t)  engine side, up to max orders in one call
+//  size_t size_approx() const       for the shutdown drain
+
+//Shared ConcurrentQueue without tokens
+class QueueTransport {
+public:
+    static constexpr const char* NAME = "concurrent-queue";
+
+    QueueTransport(Arena&, size_t num_producers, size_t capacity_per_producer)
+        : queue(num_producers * capacity_per_producer) {}
+
+    //queue blocks come from the heap
+    static size_t arena_bytes(size_t, size_t) {
+        return 0;
+    }
+
+    class Producer {
+    public:
+        explicit Producer(moodycamel::ConcurrentQueue<Order>& queue) : queue(queue) {}
+        bool send(const Order& order) {
+            return queue.enqueue(order);
+        }
+    private:
+        moodycamel::ConcurrentQueue<Order>& queue;
+    };
+
+    Producer producer(int) {
+        return Producer(queue);
+    }
+
+    bool poll(Order& order) {
+        return queue.try_dequeue(order);
+    }
+
+    size_t poll_bulk(Order* orders, size_t max) {
+        return queue.try_dequeue_bulk(orders, max);
+    }
+
+    size_t size_approx() const {
+        return queue.size_approx();
+    }
+private:
+    moodycamel::ConcurrentQueue<Order> queue;
+};
+
+//Shared ConcurrentQueue with a ProducerToken per producer and one ConsumerToken for the engine.
+//tokens pin each producer to its own sub-queue and let the consumer skip the implicit-producer lookup
+class TokenQueueTransport {
+public:
+    static constexpr const char* NAME = "concurrent-queue+tokens";
+
+    TokenQueueTransport(Arena&, size_t num_producers, size_t capacity_per_producer)
+        : queue(capacity_per_producer, num_producers, 0), consumer_token(queue) {}
+
+    static size_t arena_bytes(size_t, size_t) {
+        return 0;
+    }
+
+    class Producer {
+    public:
+        explicit Producer(moodycamel::ConcurrentQueue<Order>& queue) : queue(queue), token(queue) {}
+        bool send(const Order& order) {
+            return queue.enqueue(token, order);
+        }
+    private:
+        moodycamel::ConcurrentQueue<Order>& queue;
+        moodycamel::ProducerToken token;
+    };
+
+    Producer producer(int) {
+        return Producer(queue);
+    }
+
+    bool poll(Order& order) {
+        return queue.try_dequeue(consumer_token, order);
+    }
+
+    size_t poll_bulk(Order* orders, size_t max) {
+        return queue.try_dequeue_bulk(consumer_token, orders, max);
+    }
+
+    size_t size_approx() const {
+        return queue.size_approx();
+    }
+private:
+    moodycamel::ConcurrentQueue<Order> queue;
+    moodycamel::ConsumerToken consumer_token;
+};
+
+//One SpscRing per producer with slots from the arena. the engine polls the rings round-robin,
+//starting after whichever ring it served last so that one busy producer cannot starve the rest
+class SpscRingTransport {
+public:
+    static constexpr const char* NAME = "spsc-rings";
+
+    SpscRingTransport(Arena& arena, size_t num_producers, size_t capacity_per_producer) {
+        rings.reserve(num_producers);
+        for (size_t i = 0; i < num_producers; ++i) {
+            rings.push_back(std::make_unique<SpscRing<Order>>(arena, capacity_per_producer));
+        }
+    }
+
+    static size_t arena_bytes(size_t num_producers, size_t capacity_per_producer) {
+        return num_producers * SpscRing<Order>::bytes_needed(capacity_per_producer);
+    }
+
+    class Producer {
+    public:
+        explicit Producer(SpscRing<Order>& ring) : ring(ring) {}
+        //returns false while the ring is full
+        bool send(const Order& order) {
+            return ring.try_push(order);
+        }
+    private:
+        SpscRing<Order>& ring;
+    };
+
+    Producer producer(int id) {
+        return Producer(*rings[static_cast<size_t>(id)]);
+    }
+
+    bool poll(Order& order) {
+        size_t count = rings.size();
+        for (size_t i = 0; i < count; ++i) {
+            size_t ring = next_ring + i < count ? next_ring + i : next_ring + i - count;
+            if (rings[ring]->try_pop(order)) {
+                next_ring = ring + 1 == count ? 0 : ring + 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //drains each ring in turn until max orders are collected or every ring is empty
+    size_t poll_bulk(Order* orders, size_t max) {
+        size_t count = rings.size();
+        size_t taken = 0;
+        for (size_t i = 0; i < count && taken < max; ++i) {
+            size_t ring = next_ring + i < count ? next_ring + i : next_ring + i - count;
+            taken += rings[ring]->try_pop_bulk(orders + taken, max - taken);
+        }
+        next_ring = next_ring + 1 == count ? 0 : next_ring + 1;
+        return taken;
+    }
+
+    size_t size_approx() const {
+        size_t total = 0;
+        for (const auto& ring : rings) {
+            total += ring->size_approx();
+        }
+        return total;
+    }
+private:
+    std::vector<std::unique_ptr<SpscRing<Order>>> rings;
+    size_t next_ring = 0;
+};
@@ -0,0 +1,295 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <ctime>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <mutex>
+#include <condition_variable>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "clock.h"
+#include "latency_histogram.h"
+
+//how a thread waits when it has nothing to do (engine: empty transport, producer: pacing gap or full ring)
+enum class WaitStrategy {
+    SPIN,       //busy-wait with the cpu pause/yield instruction, lowest wake-up latency, burns a core
+    SPIN_YIELD, //spin up to the spin limit, then std::this_thread::yield()
+    SPIN_PARK,  //spin up to the spin limit, then park (futex on Linux, condition variable elsewhere)
+    BLOCKING    //park straight away on a semaphore that producers post on every order (engines only)
+};
+
+inline const char* to_string(WaitStrategy strategy) {
+    switch (strategy) {
+        case WaitStrategy::SPIN: return "spin";
+        case WaitStrategy::SPIN_YIELD: return "spin-yield";
+        case WaitStrategy::SPIN_PARK: return "spin-park";
+        case WaitStrategy::BLOCKING: return "blocking";
+    }
+    return "?";
+}
+
+//tells the core this is a spin loop (pause on x86, yield on arm64)
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+//CPU time consumed by the calling thread, compared with wall time to get the burn of a strategy
+inline double thread_cpu_seconds() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+//Parking Spot Class below
+//a 32-bit epoch that a thread can sleep on until it changes: a futex on Linux, a mutex and
+//condition variable elsewhere (macOS has no public futex)
+class ParkingSpot {
+public:
+    uint32_t epoch() const {
+        return word.load(std::memory_order_acquire);
+    }
+
+    //sleeps while the epoch still equals expected, for at most timeout
+    void wait(uint32_t expected, std::chrono::microseconds timeout) {
+#if defined(__linux__)
+        timespec ts{static_cast<time_t>(timeout.count() / 1000000), static_cast<long>((timeout.count() % 1000000) * 1000)};
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+#else
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, timeout, [&] { return word.load(std::memory_order_acquire) != expected; });
+#endif
+    }
+
+    void wake_all() {
+        word.fetch_add(1, std::memory_order_release);
+#if defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#else
+        std::lock_guard<std::mutex> lock(mutex);
+        cv.notify_all();
+#endif
+    }
+private:
+    std::atomic<uint32_t> word{0};
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32-bit word");
+#if !defined(__linux__)
+    std::mutex mutex;
+    std::condition_variable cv;
+#endif
+};
+
+//Engine Signal Class below
+//the producer->engine wake-up path. under SPIN_PARK producers only pay a fence and a load unless the
+//engine is actually asleep. under BLOCKING every order also posts a semaphore count, which is what the
+//engine waits on (the same per-enqueue cost moodycamel's BlockingConcurrentQueue pays)
+class EngineSignal {
+public:
+    explicit EngineSignal(WaitStrategy strategy) : strategy(strategy) {}
+
+    //producer side, after each send. a stage that forwards several orders at once posts them all in one go
+    void notify(size_t count = 1) {
+        if (strategy == WaitStrategy::BLOCKING) {
+            pending.fetch_add(static_cast<int64_t>(count), std::memory_order_release);
+        } else if (strategy != WaitStrategy::SPIN_PARK) {
+            return;
+        }
+        //pairs with the fence in park(): either we see the engine asleep or it sees our order
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed)) {
+            spot.wake_all();
+        }
+    }
+
+    //engine side, after taking count orders out of the transport
+    void consumed(size_t count) {
+        if (strategy == WaitStrategy::BLOCKING) {
+            pending.fetch_sub(static_cast<int64_t>(count), std::memory_order_relaxed);
+        }
+    }
+
+    //engine side: sleeps until ready() or the timeout, so the caller can re-check its run flag.
+    //returns true if the engine actually went to sleep
+    template <typename Ready>
+    bool park(Ready&& ready, std::chrono::microseconds timeout) {
+        uint32_t epoch = spot.epoch();
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool slept = false;
+        if (!has_work(ready)) {
+            spot.wait(epoch, timeout);
+            slept = true;
+        }
+        sleeping.store(false, std::memory_order_relaxed);
+        return slept;
+    }
+
+    WaitStrategy wait_strategy() const { return strategy; }
+private:
+    WaitStrategy strategy;
+    std::atomic<int64_t> pending{0}; //semaphore count (BLOCKING only)
+    std::atomic<bool> sleeping{false};
+    ParkingSpot spot;
+
+    template <typename Ready>
+    bool has_work(Ready& ready) const {
+        if (strategy == WaitStrategy::BLOCKING) {
+            return pending.load(std::memory_order_acquire) > 0;
+        }
+        return ready();
+    }
+};
+
+//per-thread cost and responsiveness of a wait strategy
+struct WaitStats {
+    uint64_t idle_waits = 0;   //engine: empty polls, producer: pacing gaps and full-ring retries
+    uint64_t parks = 0;        //times the thread actually slept in the kernel
+    double cpu_seconds = 0.0;  //thread CPU time over the run
+    double wall_seconds = 0.0; //thread lifetime over the run
+    //engine: produce->consume for the first order after an idle stretch (how fast it woke up)
+    //producer: how far past the intended send time the pacing wait returned
+    LatencyHistogram wakeup;
+
+    double cpu_percent() const {
+        return wall_seconds > 0.0 ? 100.0 * cpu_seconds / wall_seconds : 0.0;
+    }
+};
+
+//Engine Waiter Class below
+//called each time a poll comes back empty. escalates spin -> yield/park according to the strategy
+//and remembers that the engine was idle, so the next order can be counted as a wake-up
+class EngineWaiter {
+public:
+    EngineWaiter(EngineSignal& signal, uint32_t spin_limit, WaitStats& stats)
+        : signal(signal), spin_limit(spin_limit), stats(stats) {}
+
+    template <typename Ready>
+    void idle(Ready&& ready) {
+        ++stats.idle_waits;
+        idle_since_work = true;
+        switch (signal.wait_strategy()) {
+            case WaitStrategy::SPIN:
+                cpu_relax();
+                return;
+            case WaitStrategy::SPIN_YIELD:
+                if (spins++ < spin_limit) {
+                    cpu_relax();
+                } else {
+                    std::this_thread::yield();
+                }
+                return;
+            case WaitStrategy::SPIN_PARK:
+                if (spins++ < spin_limit) {
+                    cpu_relax();
+                    return;
+                }
+                break;
+            case WaitStrategy::BLOCKING:
+                break;
+        }
+        if (signal.park(ready, PARK_TIMEOUT)) {
+            ++stats.parks;
+        }
+    }
+
+    //called with each order (or the first of a batch) the engine takes out of the transport
+    void on_work(Timestamp produced, Timestamp consumed, size_t count) {
+        signal.consumed(count);
+        if (idle_since_work) {
+            stats.wakeup.record_ns(SimClock::elapsed_ns(produced, consumed));
+            idle_since_work = false;
+        }
+        spins = 0;
+    }
+private:
+    //bounded so the engine re-checks the run flag even if a wake-up were missed
+    static constexpr std::chrono::microseconds PARK_TIMEOUT{1000};
+    EngineSignal& signal;
+    uint32_t spin_limit;
+    uint32_t spins = 0;
+    bool idle_since_work = false;
+    WaitStats& stats;
+};
+
+//Producer Waiter Class below
+//paces a producer between orders and backs off while a bounded ring is full. nothing ever posts a producer,
+//so BLOCKING has no meaning here: the scenario refuses it, and it waits like SPIN_PARK if it gets here anyway
+class ProducerWaiter {
+public:
+    ProducerWaiter(WaitStrategy strategy, std::chrono::nanoseconds spin_window, WaitStats& stats)
+        : strategy(strategy), spin_window(spin_window), stats(stats) {}
+
+    //waits out the gap after an order. spin and spin-yield watch the clock and call poll() while they wait.
+    //spin-park sleeps until spin_window before the deadline, so the sleep's overshoot lands inside the window,
+    //then spins out the rest calling poll(). gaps no longer than the window are spun out entirely
+    template <typename Poll>
+    void pause(std::chrono::nanoseconds gap, Poll&& poll) {
+        ++stats.idle_waits;
+        Timestamp start = SimClock::now();
+        Timestamp deadline = start + SimClock::ticks_from_ns(gap.count());
+        switch (strategy) {
+            case WaitStrategy::SPIN:
+                while (SimClock::now() < deadline) {
+                    poll();
+                    cpu_relax();
+                }
+                break;
+            case WaitStrategy::SPIN_YIELD:
+                while (SimClock::now() < deadline) {
+                    poll();
+                    std::this_thread::yield();
+                }
+                break;
+            case WaitStrategy::SPIN_PARK:
+            case WaitStrategy::BLOCKING:
+                if (gap > spin_window) {
+                    std::this_thread::sleep_for(gap - spin_window);
+                    ++stats.parks;
+                }
+                while (SimClock::now() < deadline) {
+                    poll();
+                    cpu_relax();
+                }
+                break;
+        }
+        stats.wakeup.record_ns(SimClock::elapsed_ns(deadline, SimClock::now()));
+        poll();
+    }
+
+    void pause(std::chrono::nanoseconds gap) {
+        pause(gap, [] {});
+    }
+
+    //one retry step while the transport is full, poll() runs first so the return path keeps draining
+    template <typename Poll>
+    void backoff(Poll&& poll) {
+        poll();
+        ++stats.idle_waits;
+        if (strategy == WaitStrategy::SPIN) {
+            cpu_relax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    void backoff() {
+        backoff([] {});
+    }
+private:
+    WaitStrategy strategy;
+    std::chrono::nanoseconds spin_window;
+    WaitStats& stats;
+};
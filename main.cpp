@@ -1,231 +1,2964 @@
 #include <iostream>
 #include <thread> //std::thread for multithreading
 #include <vector> //stores threads and latency data
-#include <map>
 #include <chrono>
 #include <atomic>
 #include <random>
-#include <numeric>
 #include <algorithm>
+#include <sstream>
+#include <string>
 #include <iomanip>
-#include "concurrentqueue.h" //header file for lock-free queue fetched with CMake
-
-using Price = int;
-using Quantity = int;
-using OrderID = uint64_t;
-using Timestamp = std::chrono::time_point<std::chrono::high_resolution_clock>;
-
-//Defining an order below
-enum class Side { BUY, SELL };
-
-struct Order {
-    OrderID id;
-    Side side;
-    Price price;
-    Quantity quantity;
-    //key times for latency time tracking below
-    Timestamp timestamp_produce;   //order created by producer
-    Timestamp timestamp_consume;   //time when matching engine dequeued the order
-    Timestamp timestamp_processed; //time when matching engine finished processing
-};
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <type_traits>
+#include "order.h"
+#include "map_order_book.h"
+#include "ladder_order_book.h"
+#include "memory_pool.h"
+#include "latency_recorder.h"
+#include "transport.h" //producer->engine transports, wraps concurrentqueue.h
+#include "wait_strategy.h"
+#include "affinity.h" //core pinning, SCHED_FIFO and NUMA placement
+#include "shard_router.h" //symbol -> engine shard
+#include "execution_report.h" //engine -> producer return path
+#include "order_timeline.h" //cold per-order timestamps
+#include "capture.h" //binary order-flow capture and mapped replay
+#include "order_flow.h" //what producers send and how fast
+#include "config.h" //scenario files and --key=value arguments
+#include "metrics.h" //per-thread counters, gauges and interval histograms
+#include "market_data.h" //seqlock book snapshots, optionally in shared memory
+#include "level_feed.h" //incremental L2 level updates and conflation
+#include "shm_ingress.h" //orders from client processes over shared memory
+#include "net_ingress.h" //binary orders over UDP/TCP and the load client
+#include "risk_check.h" //pre-trade checks, inline or on their own thread
+#include "journal.h" //write-ahead journal of accepted orders and trades, and its recovery
+#include "perf_counters.h" //hardware counters, sampled per order and bucketed by latency
+
+//where --profile=<name> finds <name>.conf, set by CMake to the source tree's scenarios/
+#ifndef LLSIM_SCENARIO_DIR
+#define LLSIM_SCENARIO_DIR "scenarios"
+#endif
 
+//selects which order book implementation the matching engine uses
+enum class BookBackend { MAP, LADDER };
+
+//replay speed: as fast as the book can go, or at the consume times the capture recorded
+enum class ReplayPace { FULL_SPEED, RECORDED };
+
+//the latency a sampled order's counters are bucketed by
+enum class PerfBucket { MATCHING, END_TO_END };
+
+//run parameters, filled in from the constants at the top of main() and then the scenario config
+struct SimulationSettings {
+    int num_producers;
+    int duration_seconds;
+    BookLimits limits;
+    std::chrono::milliseconds report_interval;
+    size_t transport_capacity; //per producer
+    BookBackend book_backend;
+    TransportBackend transport_backend;
+    size_t batch_size;   //orders drained per poll, 1 = one order at a time
+    size_t sample_every; //in batch mode, give every Nth order its own timestamps (0 = never)
+    bool verbose;        //per-thread and final book output, off for sweeps
+    WaitStrategy engine_wait;   //what the engine does when the transport is empty
+    WaitStrategy producer_wait; //how producers wait out the gap between orders
+    uint32_t spin_limit;        //spins before yielding/parking
+    std::chrono::nanoseconds producer_gap; //between orders when flow.rate is 0
+    std::chrono::nanoseconds producer_spin_window; //spin-park producers spin this last stretch of a gap
+    OrderFlowProfile flow;
+    ThreadPlacement placement;
+    size_t num_symbols; //symbol universe every producer trades
+    size_t num_shards;  //engine threads, symbols are hashed across them
+    bool execution_reports; //send fills/acks back to producers and measure the round trip
+    uint64_t seed;            //producer generator seed, 0 = std::random_device
+    std::string capture_path; //write every dequeued order here ("" = off), ".<shard>" appended when sharded
+    std::string replay_path;  //replay this capture instead of running producers ("" = off)
+    ReplayPace replay_pace;
+    size_t snapshot_depth;       //levels per side published after each batch, 0 = no market data
+    std::string market_data_shm; //shared memory name the snapshots go to ("" = this process only)
+    std::string monitor_shm;     //watch another run's snapshots instead of simulating ("" = off)
+    bool l2_feed;                //stream every level change to a downstream feed thread
+    std::chrono::microseconds feed_conflation; //feed window merging updates to the same level, 0 = none
+    std::string ingress_shm; //shared memory name client processes send orders to ("" = off)
+    size_t ingress_clients;  //client slots in the ingress segment, each a producer lane after the threads
+    std::string client_shm;  //send orders to another run's ingress instead of simulating ("" = off)
+    NetProtocol net_ingress; //socket the network ingress listens on, NONE = off
+    std::string net_address; //address the ingress binds to, or the load client sends to
+    uint16_t net_port;
+    size_t net_recv_batch;   //datagrams per recvmmsg call
+    NetProtocol net_client;  //send orders to another run's network ingress instead of simulating, NONE = off
+    size_t net_send_batch;   //orders per datagram or write from the load client
+    RiskMode risk_mode;      //where the pre-trade checks run, OFF = nowhere
+    RiskLimits risk_limits;
+    std::string journal_path;  //journal every accepted order and trade here ("" = off), ".<shard>" when sharded
+    JournalSync journal_sync;  //when the journal writer makes what it wrote durable
+    std::chrono::microseconds journal_commit_interval; //JournalSync::INTERVAL only
+    bool journal_direct;       //open the journal O_DIRECT
+    size_t journal_ring;       //records the engine can be ahead of the journal writer
+    uint64_t journal_snapshot_every; //accepted orders between book snapshots in the journal, 0 = none
+    std::string recover_journal; //rebuild the books from this journal instead of simulating ("" = off)
+    uint64_t perf_sample_every;  //read the hardware counters around every Nth order's dequeue and match (0 = off)
+    PerfBucket perf_bucket;      //latency the sampled counters are grouped by
+    int warmup_seconds;          //flow runs before the measurement window opens, none of it is reported
+    bool lock_memory;            //mlockall before the run so no page faults during it
+};
 
-//this queue is the central lock-free structure (no blocks will occur)
-moodycamel::ConcurrentQueue<Order> order_queue;
+//what a sweep point reports
+struct RunSummary {
+    uint64_t orders; //finished inside the measurement window
+    double seconds;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t max_ns;
+    uint64_t sent = 0; //orders the producers sent, 0 for replays
+    double resting = 0.0;   //mean resting orders in the book a sampled order went to
+    double levels = 0.0;    //mean non-empty levels in that book
+    uint64_t recentres = 0; //ladder window moves over the run
+};
 
 std::atomic<bool> running{true};
 std::atomic<uint64_t> global_order_id{0};
-//stores data of latency times
-std::vector<long long> end_to_end_latencies_ns;
-
-//Order Book Class below
-//accessed by one thread only, the matching engine
-class OrderBook {
-public:
-    void process_order(Order& order) {
-        if (order.side == Side::BUY) {
-            match_buy(order);
-        } else {
-            match_sell(order);
-        }
+
+//Run lifecycle below: warm-up (the flow runs, nothing is reported), measurement, then drain (producers
+//stopped, the engines empty what is queued). an order's latency is reported when its intended send time falls
+//in the window, so orders sent in the window and finished in the drain still count and warm-up orders never
+//do. rates are counted by when things happened instead: sent by the send, processed by the finish
+struct MeasureWindow {
+    static constexpr Timestamp NEVER = ~Timestamp{0};
+    std::atomic<Timestamp> from{NEVER};
+    std::atomic<Timestamp> until{NEVER};
+
+    bool contains(Timestamp intended) const {
+        return intended >= from.load(std::memory_order_relaxed) && intended < until.load(std::memory_order_relaxed);
     }
-    //function to output the current top-of-book
-    void print_top_of_book() const {
-        std::cout << "--- Top of Book ---\n";
-        if (bids.empty()) {
-            std::cout << "BIDS: [EMPTY]\n";
-        } else {
-            std::cout << "BIDS: " << bids.rbegin()->second << " @ " << bids.rbegin()->first << "\n";
+    void reset() {
+        from.store(NEVER, std::memory_order_relaxed);
+        until.store(NEVER, std::memory_order_relaxed);
+    }
+};
+MeasureWindow measure_window;
+
+//reports a producer takes off a return ring per call
+const size_t REPORT_BULK = 32;
+//level updates each shard's feed ring holds, and how many the feed thread takes per call
+const size_t FEED_RING_CAPACITY = 1 << 16;
+const size_t FEED_BULK = 64;
+//a rate sweep point is saturated once the engine processes less than this share of the offered load
+const double SATURATION_SHARE = 0.9;
+//orders a pipelined risk thread takes off its inbound transport per call
+const size_t RISK_BULK = 64;
+//processed orders between book depth samples
+const size_t DEPTH_SAMPLE_EVERY = 256;
+
+//producer lanes every transport, timeline table and latency recorder is sized for: the producer threads,
+//the network ingress when it is on, then one per shared memory client slot
+size_t network_lane(const SimulationSettings& settings) {
+    return static_cast<size_t>(settings.num_producers);
+}
+
+size_t first_client_lane(const SimulationSettings& settings) {
+    return network_lane(settings) + (settings.net_ingress != NetProtocol::NONE ? 1 : 0);
+}
+
+size_t producer_lanes(const SimulationSettings& settings) {
+    return first_client_lane(settings) + (settings.ingress_shm.empty() ? 0 : settings.ingress_clients);
+}
+
+//"producer 2", "network", "client 0" for the per-lane report rows
+std::string lane_name(const SimulationSettings& settings, size_t lane) {
+    if (lane < static_cast<size_t>(settings.num_producers)) {
+        return "producer " + std::to_string(lane);
+    }
+    if (lane < first_client_lane(settings)) {
+        return "network";
+    }
+    return "client " + std::to_string(lane - first_client_lane(settings));
+}
+
+//how deep the books were while the run went on: every DEPTH_SAMPLE_EVERY-th order samples the book it
+//was matched against, right after matching, so the means are weighted by where the flow went
+struct DepthStats {
+    uint64_t samples = 0;
+    uint64_t resting = 0; //summed over the samples
+    uint64_t levels = 0;
+    size_t max_resting = 0;
+    size_t max_levels = 0;
+    uint64_t recentres = 0; //ladder window moves, every book
+
+    void record(size_t orders, size_t price_levels) {
+        ++samples;
+        resting += orders;
+        levels += price_levels;
+        max_resting = std::max(max_resting, orders);
+        max_levels = std::max(max_levels, price_levels);
+    }
+
+    void add(const DepthStats& other) {
+        samples += other.samples;
+        resting += other.resting;
+        levels += other.levels;
+        max_resting = std::max(max_resting, other.max_resting);
+        max_levels = std::max(max_levels, other.max_levels);
+        recentres += other.recentres;
+    }
+
+    double mean_resting() const { return samples ? resting / static_cast<double>(samples) : 0.0; }
+    double mean_levels() const { return samples ? levels / static_cast<double>(samples) : 0.0; }
+};
+
+//orders finished per second of the measurement window, by the time the engine finished them, whenever they
+//were sent. the last slot holds the orders the drain finished after the window closed
+struct ThroughputSeries {
+    explicit ThroughputSeries(size_t seconds) : per_second(seconds + 1, 0) {}
+
+    //processed: when the order was finished. orders finished before the window opened are not counted
+    void add(const MeasureWindow& window, Timestamp processed, uint64_t count = 1) {
+        Timestamp from = window.from.load(std::memory_order_relaxed);
+        if (processed < from) {
+            return;
         }
-        if (asks.empty()) {
-            std::cout << "ASKS: [EMPTY]\n";
-        } else {
-            std::cout << "ASKS: " << asks.begin()->second << " @ " << asks.begin()->first << "\n";
+        if (processed >= window.until.load(std::memory_order_relaxed)) {
+            per_second.back() += count;
+            return;
+        }
+        if (second_end == 0) {
+            second_end = from + SimClock::ticks_from_ns(1000000000LL);
+        }
+        while (processed >= second_end && second + 2 < per_second.size()) {
+            ++second;
+            second_end += SimClock::ticks_from_ns(1000000000LL);
         }
-        std::cout << "-------------------\n";
+        per_second[second] += count;
     }
-private:
-    //sort bids from highest to lowest price
-    std::map<Price, Quantity> bids;
-    //gets sorted from lowest to highest
-    std::map<Price, Quantity> asks;
 
-    void add_to_book(Price price, Quantity quantity, Side side) {
-        if (side == Side::BUY) {
-            bids[price] += quantity;
-        } else {
-            asks[price] += quantity;
+    //orders finished while the window was open, the run's sustained throughput times its length
+    uint64_t in_window() const {
+        return std::accumulate(per_second.begin(), per_second.end() - 1, uint64_t{0});
+    }
+
+    void merge(const ThroughputSeries& other) {
+        for (size_t i = 0; i < per_second.size() && i < other.per_second.size(); ++i) {
+            per_second[i] += other.per_second[i];
         }
     }
 
-    void match_buy(Order& buy_order) {
-        for (auto ask_iter = asks.begin(); ask_iter != asks.end() && buy_order.quantity > 0; ) {
-            Price ask_price = ask_iter->first; //finds best ask by iterating from lowest
-            Quantity& ask_quantity = ask_iter->second;
-            //if buy price is not high enough then stop matching
-            if (buy_order.price < ask_price) {
-                break;
-            }
+    std::vector<uint64_t> per_second;
+    Timestamp second_end = 0; //end of the current slot, 0 until the first measured order
+    size_t second = 0;
+};
 
-            Quantity matched_quantity = std::min(buy_order.quantity, ask_quantity);
-            buy_order.quantity -= matched_quantity;
-            ask_quantity -= matched_quantity;
-            //if the ask level is filled then remove it
-            if (ask_quantity == 0) {
-                ask_iter = asks.erase(ask_iter);
-            } else {
-                ++ask_iter;
+//everything a run produces, filled in by run_simulation once its threads are joined.
+//wait_stats[i] is engine shard i for i < num_shards, wait_stats[num_shards + p] is producer p, followed by
+//each shard's risk thread when the checks run pipelined
+struct RunStats {
+    explicit RunStats(const SimulationSettings& settings)
+        : arena(LatencyRecorder::bytes_needed(producer_lanes(settings))
+                + TimelineTable::bytes_needed(producer_lanes(settings), timeline_depth(settings))
+                + (settings.perf_sample_every > 0 ? PerfProfile::bytes_needed() : 0)),
+          latencies(arena, producer_lanes(settings), settings.flow.pacing == Pacing::OPEN_LOOP),
+          timelines(arena, producer_lanes(settings), timeline_depth(settings)),
+          wait_stats(settings.num_shards * (settings.risk_mode == RiskMode::PIPELINED ? 2 : 1)
+                     + static_cast<size_t>(settings.num_producers)),
+          round_trips(static_cast<size_t>(settings.num_producers)),
+          sent(static_cast<size_t>(settings.num_producers), 0),
+          throughput(static_cast<size_t>(settings.duration_seconds)) {
+        if (settings.perf_sample_every > 0) {
+            perf = std::make_unique<PerfProfile>(arena);
+        }
+    }
+
+    //timeline slots per producer: deep enough for everything it can have queued across the shards, plus a
+    //client's ingress ring or the network receive path when there is one, so it is rarely held back by a slot
+    static size_t timeline_depth(const SimulationSettings& settings) {
+        size_t rings = settings.num_shards + (settings.ingress_shm.empty() ? 0 : 1)
+                       + (settings.net_ingress != NetProtocol::NONE ? 1 : 0);
+        return std::max<size_t>(settings.transport_capacity * rings, 1 << 16);
+    }
+
+    Arena arena;
+    LatencyRecorder latencies; //every shard merged
+    TimelineTable timelines;   //shared by every producer and shard while the run is live
+    std::vector<WaitStats> wait_stats;
+    std::vector<RoundTripStats> round_trips; //per producer
+    std::vector<uint64_t> sent;              //orders each producer sent
+    uint64_t dropped_reports = 0;
+    FeedStats feed; //L2 feed, when on
+    IngressStats ingress; //shared memory clients, when on
+    NetworkStats network; //network ingress, when on
+    RiskStats risk;       //every shard's risk stage, when on
+    JournalStats journal; //every shard's journal, when on
+    std::unique_ptr<PerfProfile> perf; //every shard's counter samples, null unless sampling
+    DepthStats depth;                  //every shard's books
+    ThroughputSeries throughput;       //every shard, by finish time
+    uint64_t unmeasured = 0;           //orders sent outside the window: the warm-up's
+    size_t queued_at_stop = 0;         //in the transports when the producers were stopped
+    double drain_seconds = 0.0;        //producers stopped -> every engine done
+    MemoryLockResult memory_lock;
+    bool prefaulted = false;           //arenas touched page by page instead, when locking was off or refused
+};
+
+//" on core N", " (pin to core N failed)" etc. for the thread start-up lines
+std::string describe_placement(int core, int realtime_priority, const PlacementResult& result) {
+    std::string text;
+    if (core >= 0) {
+        text += result.pinned ? " on core " + std::to_string(core) : " (pin to core " + std::to_string(core) + " failed)";
+    }
+    if (realtime_priority > 0) {
+        text += result.realtime ? ", SCHED_FIFO " + std::to_string(realtime_priority) : ", SCHED_FIFO refused";
+    }
+    return text;
+}
+
+//One Engine Shard below: the arena, inbound transport, books (one per owned symbol), latency recorder
+//and wait stats of one matching engine thread. the arena is NUMA-placed before anything else touches it
+template <typename Book, typename Transport>
+struct EngineShard {
+    EngineShard(const SimulationSettings& settings, const std::vector<SymbolID>& symbols, size_t shard_id)
+        : symbols(symbols),
+          arena(arena_bytes(settings, symbols.size())),
+          numa_node(place_arena(arena, settings.placement, shard_id)),
+          transport(arena, producer_lanes(settings), settings.transport_capacity),
+          signal(settings.engine_wait),
+          risk_signal(settings.engine_wait),
+          latencies(arena, producer_lanes(settings), settings.flow.pacing == Pacing::OPEN_LOOP),
+          reports(arena, settings.execution_reports ? first_client_lane(settings) : 0, settings.transport_capacity),
+          books(settings.num_symbols),
+          throughput(static_cast<size_t>(settings.duration_seconds)) {
+        if (settings.risk_mode != RiskMode::OFF) {
+            risk = std::make_unique<RiskStage>(arena, settings.risk_limits, producer_lanes(settings),
+                                               settings.num_symbols);
+        }
+        if (settings.risk_mode == RiskMode::PIPELINED) {
+            risk_inbound = std::make_unique<Transport>(arena, producer_lanes(settings), settings.transport_capacity);
+        }
+        if (!settings.capture_path.empty()) {
+            std::string path = settings.capture_path;
+            if (settings.num_shards > 1) {
+                path += "." + std::to_string(shard_id);
             }
+            capture = std::make_unique<CaptureWriter>(path, static_cast<uint32_t>(settings.num_symbols));
+        }
+        if (!settings.journal_path.empty()) {
+            std::string path = settings.journal_path;
+            if (settings.num_shards > 1) {
+                path += "." + std::to_string(shard_id);
+            }
+            journal = std::make_unique<JournalWriter>(arena, path, static_cast<uint32_t>(settings.num_symbols),
+                                                      settings.journal_ring, settings.journal_sync,
+                                                      settings.journal_commit_interval, settings.journal_direct,
+                                                      settings.journal_snapshot_every);
+            reports.attach_journal(journal.get());
+        }
+        if (settings.l2_feed) {
+            feed = std::make_unique<LevelFeed>(arena, FEED_RING_CAPACITY);
         }
-        //if quantity remains, add it to the bid book
-        if (buy_order.quantity > 0) {
-            add_to_book(buy_order.price, buy_order.quantity, Side::BUY);
+        if (settings.perf_sample_every > 0) {
+            perf = std::make_unique<PerfProfile>(arena);
         }
     }
 
-    void match_sell(Order& sell_order) {
-        //iterate through bids from highest price (best bid)
-        for (auto bid_iter = bids.rbegin(); bid_iter != bids.rend() && sell_order.quantity > 0; ) {
-            Price bid_price = bid_iter->first;
-            Quantity& bid_quantity = bid_iter->second;
-            //if sell price is not low enough then stop matching
-            if (sell_order.price > bid_price) {
-                break;
+    //one arena reserved up front for the books, the order indexes, the latency histograms, the rings,
+    //the engine's batch buffer, the risk stage's state, rings and batch buffer, the journal ring and the
+    //counter profile
+    static size_t arena_bytes(const SimulationSettings& settings, size_t symbol_count) {
+        const bool pipelined = settings.risk_mode == RiskMode::PIPELINED;
+        return symbol_count * Book::arena_bytes(settings.limits)
+               + Transport::arena_bytes(producer_lanes(settings), settings.transport_capacity)
+               + Arena::reserve_for(settings.batch_size * sizeof(Order))
+               + LatencyRecorder::bytes_needed(producer_lanes(settings))
+               + (settings.l2_feed ? LevelFeed::bytes_needed(FEED_RING_CAPACITY) : 0)
+               + (settings.execution_reports
+                  ? ExecutionReporter::bytes_needed(first_client_lane(settings), settings.transport_capacity) : 0)
+               + (settings.risk_mode != RiskMode::OFF
+                  ? RiskStage::bytes_needed(settings.risk_limits, producer_lanes(settings), settings.num_symbols) : 0)
+               + (pipelined ? Transport::arena_bytes(producer_lanes(settings), settings.transport_capacity)
+                              + Arena::reserve_for(RISK_BULK * sizeof(Order)) : 0)
+               + (settings.journal_path.empty() ? 0 : JournalWriter::bytes_needed(settings.journal_ring))
+               + (settings.perf_sample_every > 0 ? PerfProfile::bytes_needed() : 0);
+    }
+
+    //where producers send: the risk thread's inbound transport when it runs pipelined, the engine's otherwise
+    Transport& inbound() { return risk_inbound ? *risk_inbound : transport; }
+    //and the signal that wakes whoever drains it
+    EngineSignal& inbound_signal() { return risk_inbound ? risk_signal : signal; }
+
+    //nothing has touched the arena yet, so its pages can still be steered to the engine core's node
+    static int place_arena(Arena& arena, const ThreadPlacement& placement, size_t shard_id) {
+        int core = placement.engine_core(shard_id);
+        if (!placement.numa_local || core < 0) {
+            return -1;
+        }
+        int node = numa_node_of_core(core);
+        return prefer_numa_node(arena.data(), arena.bytes_capacity(), node) ? node : -1;
+    }
+
+    const std::vector<SymbolID>& symbols;
+    Arena arena;
+    int numa_node; //node the arena prefers, -1 when left to the default policy
+    Transport transport;
+    EngineSignal signal;
+    EngineSignal risk_signal; //producers -> risk thread wake-ups, unused unless the checks run pipelined
+    LatencyRecorder latencies;
+    ExecutionReporter reports; //one return ring per producer and the network lane, none when reports are off
+    std::vector<std::unique_ptr<Book>> books; //indexed by symbol, only this shard's symbols are set
+    std::unique_ptr<CaptureWriter> capture;   //null unless capturing
+    std::unique_ptr<JournalWriter> journal;   //null unless journaling
+    std::unique_ptr<LevelFeed> feed;          //null unless the L2 feed is on
+    WaitStats wait_stats;
+    PublishStats publish_stats; //market data snapshots written by this shard
+    std::unique_ptr<RiskStage> risk;          //null unless risk checks are on
+    std::unique_ptr<Transport> risk_inbound;  //producers -> risk thread, null unless the checks run pipelined
+    std::atomic<bool> risk_forwarding{false}; //the risk thread may still forward, the engine keeps draining
+    WaitStats risk_wait_stats;
+    std::unique_ptr<PerfProfile> perf;        //null unless sampling hardware counters
+    DepthStats depth;
+    ThroughputSeries throughput;
+    uint64_t unmeasured = 0;        //orders whose latency was not reported, sent outside the window
+};
+
+template <typename Book, typename Transport>
+using ShardList = std::vector<std::unique_ptr<EngineShard<Book, Transport>>>;
+
+//the ladder's window starts centred where the flow trades, the map does not need to be told
+template <typename Book>
+std::unique_ptr<Book> make_book(Arena& arena, const BookLimits& limits, ExecutionReporter* reports, Price centre) {
+    if constexpr (std::is_same_v<Book, LadderOrderBook>) {
+        return std::make_unique<Book>(arena, limits, reports, centre);
+    } else {
+        return std::make_unique<Book>(arena, limits, reports);
+    }
+}
+
+//first price each symbol's orders had in a recording, fallback for a symbol it has none for.
+//is_order picks the records that carry an order
+template <typename Record, typename IsOrder>
+std::vector<Price> recorded_centres(const Record* records, uint64_t count, size_t num_symbols, Price fallback,
+                                    IsOrder is_order) {
+    std::vector<Price> centres(num_symbols, fallback);
+    std::vector<uint8_t> found(num_symbols, 0);
+    size_t missing = num_symbols;
+    for (uint64_t i = 0; i < count && missing > 0; ++i) {
+        const Order& order = records[i].order;
+        if (is_order(records[i]) && order.type == MsgType::NEW && order.symbol < num_symbols && !found[order.symbol]) {
+            centres[order.symbol] = order.price;
+            found[order.symbol] = 1;
+            --missing;
+        }
+    }
+    return centres;
+}
+
+//Producer Thread Function to simulate client sending orders
+//each producer trades the whole symbol universe and routes every order to the shard that owns its symbol
+template <typename Book, typename Transport>
+void producer_thread(ShardList<Book, Transport>& shards, const ShardRouter& router, TimelineTable& timelines,
+                     int thread_id, const SimulationSettings& settings, WaitStats& wait_stats,
+                     RoundTripStats& round_trips, uint64_t& sent, ThreadMetrics& metrics) {
+    int core = settings.placement.producer_core(static_cast<size_t>(thread_id));
+    PlacementResult placed = place_current_thread(core, 0);
+    if (settings.verbose) {
+        std::cout << "Producer thread " << thread_id << " started" << describe_placement(core, 0, placed) << ".\n";
+    }
+    double cpu_start = thread_cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+    std::vector<typename Transport::Producer> links;
+    links.reserve(shards.size());
+    for (auto& shard : shards) {
+        links.push_back(shard->inbound().producer(thread_id));
+    }
+    //this producer's return ring on every shard, drained whenever the producer waits
+    std::vector<ReportRing*> report_rings;
+    if (settings.execution_reports) {
+        for (auto& shard : shards) {
+            report_rings.push_back(&shard->reports.ring(static_cast<size_t>(thread_id)));
+        }
+    }
+    ExecutionReport received[REPORT_BULK];
+    auto drain_reports = [&] {
+        for (ReportRing* ring : report_rings) {
+            while (size_t count = ring->try_pop_bulk(received, REPORT_BULK)) {
+                round_trips.receive(received, count, measure_window.from.load(std::memory_order_relaxed),
+                                    measure_window.until.load(std::memory_order_relaxed));
             }
-            Quantity matched_quantity = std::min(sell_order.quantity, bid_quantity);
-            sell_order.quantity -= matched_quantity;
-            bid_quantity -= matched_quantity;
-            //if bid level is fully filled then remove it
-            if (bid_quantity == 0) {
-                bid_iter = std::map<Price, Quantity>::reverse_iterator(bids.erase(std::next(bid_iter).base()));
+        }
+    };
+    ProducerWaiter waiter(settings.producer_wait, settings.producer_spin_window, wait_stats);
+    //each thread gets its own generator
+    //a fixed seed makes each producer's flow repeatable, the interleaving across producers still is not
+    OrderFlow flow(settings.flow, settings.num_symbols,
+                   (settings.seed != 0 ? settings.seed : std::random_device{}()) + static_cast<uint64_t>(thread_id),
+                   settings.producer_gap);
+    uint32_t sequence = 0;
+    const bool open_loop = settings.flow.pacing == Pacing::OPEN_LOOP;
+    Timestamp schedule_start = SimClock::now();
+    while (running) {
+        metrics.poll();
+        //open loop: wait for the next slot on the schedule, or go straight away if already behind it
+        Timestamp intended = 0;
+        if (open_loop) {
+            intended = flow.next_arrival(schedule_start);
+            long long ahead_ns = SimClock::elapsed_ns(SimClock::now(), intended);
+            if (ahead_ns > 0) {
+                waiter.pause(std::chrono::nanoseconds(ahead_ns), drain_reports);
             } else {
-                ++bid_iter;
+                drain_reports();
             }
         }
-        //if quantity remains then add it to the ask book
-        if (sell_order.quantity > 0) {
-            add_to_book(sell_order.price, sell_order.quantity, Side::SELL);
+        //creates new order, or amends one sent earlier
+        Order order{};
+        order.producer_id = static_cast<uint8_t>(thread_id);
+        order.sequence = sequence++;
+        flow.next(order, global_order_id);
+        size_t shard = router.shard_of(order.symbol);
+        //Latency Point 1, written to the cold table before the send publishes the order. the slot is only
+        //refused while this producer's order from a table's depth ago is still queued
+        OrderTimeline* claimed;
+        while (!(claimed = timelines.claim(order)) && running) {
+            metrics.add(MetricCounter::SEND_RETRIES);
+            waiter.backoff(drain_reports);
+        }
+        if (!claimed) {
+            break;
+        }
+        OrderTimeline& timeline = *claimed;
+        timeline.produce = SimClock::now();
+        timeline.intended = open_loop ? intended : timeline.produce;
+        Timestamp produce = timeline.produce;
+        //enqueues the order into the lock-free transport, retrying while a bounded ring is full
+        while (!links[shard].send(order) && running) {
+            metrics.add(MetricCounter::SEND_RETRIES);
+            waiter.backoff(drain_reports);
+        }
+        shards[shard]->inbound_signal().notify();
+        if (measure_window.contains(produce)) {
+            ++sent;
+        }
+        metrics.add(MetricCounter::ORDERS_SENT);
+        //closed loop: to avoid overwhelming the system there is a wait (10us by default) added below,
+        //none inside a burst
+        if (!open_loop) {
+            std::chrono::nanoseconds gap = flow.pause();
+            if (gap.count() > 0) {
+                waiter.pause(gap, drain_reports);
+            }
         }
     }
-};
-//Producer Thread Function to simulate client sending orders
-void producer_thread(int thread_id) {
-    std::cout << "Producer thread " << thread_id << " started.\n";
-    //each thread gets its own random number generator
-    std::mt19937 gen(std::random_device{}() + thread_id);
-    std::uniform_int_distribution<> price_dist(95, 105);
-    std::uniform_int_distribution<> qty_dist(1, 10); //the quantity
-    std::uniform_int_distribution<> side_dist(0, 1); // 0 = BUY 1 = SELL
+    metrics.retire();
+    wait_stats.cpu_seconds = thread_cpu_seconds() - cpu_start;
+    wait_stats.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+}
+//records the ingress thread takes off one client ring per call
+const size_t INGRESS_BULK = 64;
+
+//Ingress Thread Function: the engine end of the shared memory ingress. drains every client ring, drops and
+//counts records with fields no engine may see, puts each remaining order on its client's producer lane with
+//the client's own stamps in the timeline table, and forwards it to the shard that owns its symbol through
+//the first client lane of that shard's transport. from there the engines match and time it exactly like an
+//order from a producer thread
+template <typename Book, typename Transport>
+void ingress_thread(ShardList<Book, Transport>& shards, const ShardRouter& router, TimelineTable& timelines,
+                    IngressSegment& ingress, const SimulationSettings& settings, IngressStats& stats,
+                    ThreadMetrics& metrics) {
+    const int lane = static_cast<int>(first_client_lane(settings));
+    std::vector<typename Transport::Producer> links;
+    links.reserve(shards.size());
+    for (auto& shard : shards) {
+        links.push_back(shard->inbound().producer(lane));
+    }
+    IngressRecord received[INGRESS_BULK];
     while (running) {
-        //creates new order
+        metrics.poll();
+        size_t drained = 0;
+        for (size_t client = 0; client < ingress.num_clients(); ++client) {
+            size_t count = ingress.poll(client, received, INGRESS_BULK);
+            if (count == 0) {
+                continue;
+            }
+            //the cross-process hop on its own: client produce -> off the shared ring
+            Timestamp now = SimClock::now();
+            size_t forwarded = 0;
+            for (size_t i = 0; i < count; ++i) {
+                IngressRecord& record = received[i];
+                Order& order = record.order;
+                //the client process wrote every field, nothing it got wrong may reach an engine's books
+                if (!valid_order_fields(static_cast<uint8_t>(order.type), static_cast<uint8_t>(order.side),
+                                        static_cast<uint8_t>(order.order_type), order.symbol, order.quantity,
+                                        settings.num_symbols)) {
+                    ++stats.malformed;
+                    continue;
+                }
+                order.producer_id = static_cast<uint8_t>(static_cast<size_t>(lane) + client);
+                stats.hop.record_ns(SimClock::elapsed_ns(record.produce, now));
+                OrderTimeline* timeline;
+                while (!(timeline = timelines.claim(order)) && running) {
+                    metrics.add(MetricCounter::SEND_RETRIES);
+                    std::this_thread::yield();
+                }
+                if (!timeline) {
+                    break;
+                }
+                timeline->produce = record.produce;
+                timeline->intended = record.intended;
+                size_t shard = router.shard_of(order.symbol);
+                while (!links[shard].send(order) && running) {
+                    metrics.add(MetricCounter::SEND_RETRIES);
+                    std::this_thread::yield();
+                }
+                shards[shard]->inbound_signal().notify();
+                ++forwarded;
+            }
+            drained += count;
+            metrics.add(MetricCounter::ORDERS_SENT, forwarded);
+        }
+        stats.received += drained;
+        if (drained == 0) {
+            std::this_thread::yield();
+        }
+    }
+    //clients stop at the close, whatever they pushed before it is counted but not matched
+    ingress.close();
+    for (size_t client = 0; client < ingress.num_clients(); ++client) {
+        while (size_t count = ingress.poll(client, received, INGRESS_BULK)) {
+            stats.discarded += count;
+        }
+        stats.clients += ingress.connections(client) > 0 ? 1 : 0;
+    }
+    metrics.retire();
+}
+//Network Thread Function: the engine end of the network ingress. every order message is decoded straight out
+//of the receiver's buffer into an Order on the network lane, its timeline gets the sender's send stamp, and it
+//goes to the shard that owns its symbol. final reports for the lane go back to the sender as report messages
+template <typename Book, typename Transport, typename Receiver>
+void network_thread(ShardList<Book, Transport>& shards, const ShardRouter& router, TimelineTable& timelines,
+                    Receiver& receiver, const SimulationSettings& settings, NetworkStats& stats,
+                    ThreadMetrics& metrics) {
+    const size_t lane = network_lane(settings);
+    std::vector<typename Transport::Producer> links;
+    links.reserve(shards.size());
+    for (auto& shard : shards) {
+        links.push_back(shard->inbound().producer(static_cast<int>(lane)));
+    }
+    std::vector<ReportRing*> report_rings;
+    if (settings.execution_reports) {
+        for (auto& shard : shards) {
+            report_rings.push_back(&shard->reports.ring(lane));
+        }
+    }
+    uint32_t sequence = 0; //the lane's own numbering for the timeline table
+    uint32_t expected = 0; //next sequence number the sender should use
+    auto on_frame = [&](const unsigned char* frame, Timestamp received) {
         Order order{};
-        order.id = global_order_id.fetch_add(1, std::memory_order_relaxed);
-        order.side = (side_dist(gen) == 0) ? Side::BUY : Side::SELL;
-        order.price = price_dist(gen);
-        order.quantity = qty_dist(gen);
-        //Latency Point 1
-        order.timestamp_produce = std::chrono::high_resolution_clock::now();
-        //enqueues the order into the lock-free queue
-        order_queue.enqueue(order);
-        //to avoid overwhelming the system there is a 10ms wait added below
-        std::this_thread::sleep_for(std::chrono::microseconds(10));
-    }
-}
-//Consumer Thread Function for singe matching engine thread
-void consumer_thread() {
-    std::cout << "Consumer (Matching Engine) thread started.\n";
-    OrderBook book;
-    Order order;
-    while (running || order_queue.size_approx() > 0) {
-        //non-blocking call to try and dequeue an order
-        if (order_queue.try_dequeue(order)) {
-            //Latency Point 2
-            order.timestamp_consume = std::chrono::high_resolution_clock::now();
-            book.process_order(order);
-            //Latency Point 3
-            order.timestamp_processed = std::chrono::high_resolution_clock::now();
-            //calculates and stores the total end-to-end latency
-            auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                order.timestamp_processed - order.timestamp_produce
-            ).count();
-            end_to_end_latencies_ns.push_back(latency);
-        } else if (running) {
+        Timestamp sent;
+        uint32_t wire_sequence;
+        if (!decode_order(frame, settings.num_symbols, order, sent, wire_sequence)) {
+            ++stats.malformed;
+            return;
+        }
+        //a sender starting again from 0 is not a gap
+        if (wire_sequence > expected) {
+            stats.gaps += wire_sequence - expected;
+        }
+        expected = wire_sequence + 1;
+        order.producer_id = static_cast<uint8_t>(lane);
+        order.sequence = sequence++;
+        stats.wire.record_ns(SimClock::elapsed_ns(sent, received));
+        OrderTimeline* timeline;
+        while (!(timeline = timelines.claim(order)) && running) {
+            metrics.add(MetricCounter::SEND_RETRIES);
+            std::this_thread::yield();
+        }
+        if (!timeline) {
+            return;
+        }
+        timeline->produce = sent;
+        timeline->intended = sent;
+        size_t shard = router.shard_of(order.symbol);
+        while (!links[shard].send(order) && running) {
+            metrics.add(MetricCounter::SEND_RETRIES);
+            std::this_thread::yield();
+        }
+        shards[shard]->inbound_signal().notify();
+        ++stats.messages;
+    };
+    //final reports, packed as many to a reply as a datagram holds
+    ExecutionReport received[REPORT_BULK];
+    unsigned char reply[MAX_DATAGRAM];
+    const size_t reply_capacity = MAX_DATAGRAM / WIRE_REPORT_SIZE;
+    size_t packed = 0;
+    auto flush = [&] {
+        if (packed > 0 && receiver.reply(reply, packed * WIRE_REPORT_SIZE)) {
+            stats.replies += packed;
+        }
+        packed = 0;
+    };
+    auto send_replies = [&] {
+        size_t drained = 0;
+        for (ReportRing* ring : report_rings) {
+            while (size_t count = ring->try_pop_bulk(received, REPORT_BULK)) {
+                for (size_t i = 0; i < count; ++i) {
+                    const ExecutionReport& report = received[i];
+                    if (!report.final_report || report.passive) {
+                        continue;
+                    }
+                    encode_report(WireReport{static_cast<uint8_t>(report.type), report.leaves_quantity, report.id,
+                                             report.timestamp_produce, report.timestamp_report},
+                                  reply + packed * WIRE_REPORT_SIZE);
+                    if (++packed == reply_capacity) {
+                        flush();
+                    }
+                }
+                drained += count;
+            }
+        }
+        flush();
+        return drained;
+    };
+    while (running) {
+        metrics.poll();
+        uint64_t before = stats.messages;
+        size_t frames = receiver.poll(on_frame);
+        metrics.add(MetricCounter::ORDERS_SENT, stats.messages - before);
+        size_t replies = send_replies();
+        if (frames == 0 && replies == 0) {
             std::this_thread::yield();
         }
     }
-    //outputs final book state
-    std::cout << "\n--- FINAL ---" << std::endl;
-    book.print_top_of_book();
+    stats.receives = receiver.receives();
+    stats.stray_bytes = receiver.stray_bytes();
+    metrics.retire();
+}
+//Risk Thread Function: the pipelined risk stage of one shard. takes what the producers sent the shard off its
+//inbound transport, checks it and forwards what passes to the engine on producer lane 0 of the engine's
+//transport. the collar's reference is the top of book the engine last published, so it lags the book by up to
+//a batch. rejected orders never reach the engine and get no report, they are only counted. producers wake this
+//thread through the shard's risk signal, and it posts the engine's signal once for every order it forwards
+template <typename Book, typename Transport>
+void risk_thread(EngineShard<Book, Transport>& shard, TimelineTable& timelines, const SimulationSettings& settings,
+                 const MarketDataPublisher* market_data) {
+    double cpu_start = thread_cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+    Transport& inbound = *shard.risk_inbound;
+    auto link = shard.transport.producer(0);
+    RiskStage& risk = *shard.risk;
+    Order* batch = shard.arena.template allocate_array<Order>(RISK_BULK);
+    auto top_of = [market_data](SymbolID symbol) {
+        if (!market_data) {
+            return TopOfBook{};
+        }
+        BookSnapshot snapshot;
+        market_data->slot(symbol).read(snapshot);
+        return snapshot.top();
+    };
+    EngineWaiter waiter(shard.risk_signal, settings.spin_limit, shard.risk_wait_stats);
+    auto has_work = [&inbound] { return inbound.size_approx() > 0; };
+    while (running || inbound.size_approx() > 0) {
+        size_t count = inbound.poll_bulk(batch, RISK_BULK);
+        if (count == 0) {
+            if (running) {
+                waiter.idle(has_work);
+            }
+            continue;
+        }
+        waiter.on_work(timelines.at(batch[0]).produce, SimClock::now(), count);
+        size_t forwarded = 0;
+        for (size_t i = 0; i < count; ++i) {
+            Order& order = batch[i];
+            OrderTimeline& timeline = timelines.at(order);
+            timeline.risk_in = SimClock::now();
+            if (risk.check(order, timeline.risk_in, top_of) != RiskReject::PASS) {
+                timelines.release(order);
+                continue;
+            }
+            timeline.risk_out = SimClock::now();
+            //the engine drains until this thread is done, so a full ring only ever means waiting
+            while (!link.send(order)) {
+                std::this_thread::yield();
+            }
+            ++forwarded;
+        }
+        if (forwarded > 0) {
+            shard.signal.notify(forwarded);
+        }
+    }
+    shard.risk_wait_stats.cpu_seconds = thread_cpu_seconds() - cpu_start;
+    shard.risk_wait_stats.wall_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    shard.risk_forwarding.store(false, std::memory_order_release);
+}
+//Consumer Thread Function for one matching engine shard
+//templated on the book backend and transport so every combination shares the same engine loop
+//the books' pools are carved from the shard's arena here, so their pages are first touched by the engine thread
+template <typename Book, typename Transport>
+void consumer_thread(EngineShard<Book, Transport>& shard, size_t shard_id, TimelineTable& timelines,
+                     const SimulationSettings& settings, ThreadMetrics& metrics, MarketDataPublisher* market_data) {
+    const ThreadPlacement& placement = settings.placement;
+    int core = placement.engine_core(shard_id);
+    PlacementResult placed = place_current_thread(core, placement.realtime_priority);
+    if (settings.verbose) {
+        std::ostringstream line;
+        line << "Consumer (Matching Engine) thread " << shard_id << " started (" << Book::NAME << " book x"
+             << shard.symbols.size() << ", " << Transport::NAME << ", batch " << settings.batch_size << ")"
+             << describe_placement(core, placement.realtime_priority, placed);
+        if (shard.numa_node >= 0) {
+            line << ", arena on NUMA node " << shard.numa_node;
+        }
+        std::cout << line.str() << ".\n";
+    }
+    double cpu_start = thread_cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+    Transport& transport = shard.transport;
+    LatencyRecorder& latencies = shard.latencies;
+    ExecutionReporter& reports = shard.reports;
+    CaptureWriter* capture = shard.capture.get();
+    JournalWriter* journal = shard.journal.get();
+    //the journal takes its trades from the reporter, so books journaling without reports still get one
+    for (SymbolID symbol : shard.symbols) {
+        shard.books[symbol] = make_book<Book>(shard.arena, settings.limits,
+                                              settings.execution_reports || journal ? &shard.reports : nullptr,
+                                              settings.flow.mid_price);
+        shard.books[symbol]->attach_feed(shard.feed.get(), symbol);
+    }
+    LevelFeed* feed = shard.feed.get();
+    auto& books = shard.books;
+    //inline risk checks see the live book, rejected orders are answered and never reach it. each order stamps its
+    //own start, so in a batch its checks do not include the checks and matching of the orders ahead of it
+    RiskStage* risk = settings.risk_mode == RiskMode::INLINE ? shard.risk.get() : nullptr;
+    auto top_of = [&books](SymbolID symbol) { return books[symbol]->top_of_book(); };
+    auto passes_risk = [&](const Order& order, OrderTimeline& timeline) {
+        timeline.risk_in = SimClock::now();
+        if (risk->check(order, timeline.risk_in, top_of) != RiskReject::PASS) {
+            reports.done(order, ExecType::REJECTED, 0);
+            return false;
+        }
+        timeline.risk_out = SimClock::now();
+        return true;
+    };
+    //a pipelined risk thread may still be forwarding after the producers stop
+    auto draining = [&] {
+        return running || shard.risk_forwarding.load(std::memory_order_acquire) || transport.size_approx() > 0;
+    };
+    EngineWaiter waiter(shard.signal, settings.spin_limit, shard.wait_stats);
+    auto has_work = [&transport] { return transport.size_approx() > 0; };
+    //every perf_sample_every-th order gets the counters read around its dequeue and its process_order, and
+    //is filed under its own matching or end-to-end latency. counters are per thread, so they are opened here
+    PerfProfile* perf = shard.perf.get();
+    std::unique_ptr<PerfCounters> counters;
+    if (perf) {
+        counters = std::make_unique<PerfCounters>();
+        counters->start();
+        perf->set_source(*counters);
+    }
+    uint64_t until_sample = settings.perf_sample_every;
+    const bool open_loop = settings.flow.pacing == Pacing::OPEN_LOOP;
+    //the next order is sampled: poll reads the counters whenever that order may be among the ones it takes
+    auto sample_due = [&](size_t take) { return perf && until_sample <= take; };
+    auto take_sample = [&] {
+        if (!perf || --until_sample > 0) {
+            return false;
+        }
+        until_sample = settings.perf_sample_every;
+        return true;
+    };
+    //only latencies of orders sent in the measurement window are reported, the live interval histogram still
+    //sees every order. throughput goes by when the order finished, so a backlog from the warm-up still counts
+    auto record_latency = [&](const Order& order, const OrderTimeline& timeline) {
+        shard.throughput.add(measure_window, timeline.processed);
+        if (measure_window.contains(timeline.intended)) {
+            metrics.record_ns(MetricHistogram::LATENCY, latencies.record(order, timeline));
+        } else {
+            metrics.record_ns(MetricHistogram::LATENCY, SimClock::elapsed_ns(timeline.intended, timeline.processed));
+            ++shard.unmeasured;
+        }
+    };
+    size_t depth_counter = 0;
+    auto sample_depth = [&](SymbolID symbol, const OrderTimeline& timeline) {
+        if (++depth_counter % DEPTH_SAMPLE_EVERY == 0 && measure_window.contains(timeline.consume)) {
+            shard.depth.record(books[symbol]->resting_orders(), books[symbol]->price_levels());
+        }
+    };
+    auto record_sample = [&](const OrderTimeline& timeline, const PerfSample& dequeue, const PerfSample& process) {
+        if (!measure_window.contains(timeline.intended)) {
+            return;
+        }
+        Timestamp start = settings.perf_bucket == PerfBucket::MATCHING
+                          ? std::max(timeline.consume, timeline.risk_out)
+                          : (open_loop ? timeline.intended : timeline.produce);
+        perf->record(SimClock::elapsed_ns(start, timeline.processed), dequeue, process);
+    };
+    //gauges are only read when the reporter asks for a snapshot
+    auto refresh_gauges = [&] {
+        size_t resting = 0;
+        for (SymbolID symbol : shard.symbols) {
+            resting += books[symbol]->resting_orders();
+        }
+        metrics.set(MetricGauge::RESTING_ORDERS, static_cast<int64_t>(resting));
+        metrics.set(MetricGauge::TRANSPORT_DEPTH, static_cast<int64_t>(transport.size_approx()));
+    };
+    if (settings.batch_size <= 1) {
+        Order order;
+        //counter reads of a sampled order: before and after the poll, around process_order
+        PerfSample polling, polled, matching;
+        while (draining()) {
+            metrics.poll(refresh_gauges);
+            bool reading = sample_due(1);
+            if (reading) {
+                polling = counters->read();
+            }
+            //non-blocking call to try and dequeue an order
+            if (transport.poll(order)) {
+                bool sampled = take_sample(); //only ever true when reading
+                if (sampled) {
+                    polled = counters->read();
+                }
+                OrderTimeline& timeline = timelines.at(order);
+                //Latency Point 2
+                timeline.consume = SimClock::now();
+                waiter.on_work(timeline.produce, timeline.consume, 1);
+                reports.begin(timeline.produce);
+                if (risk && !passes_risk(order, timeline)) {
+                    timelines.release(order);
+                    continue;
+                }
+                //only what reaches the book is captured, so a replay rebuilds the same books
+                if (capture) {
+                    capture->append(order, timeline.consume);
+                }
+                if (journal) {
+                    journal->order(order, timeline.consume);
+                }
+                if (feed) {
+                    feed->begin(timeline.consume);
+                }
+                if (sampled) {
+                    matching = counters->read();
+                }
+                books[order.symbol]->process_order(order);
+                //Latency Point 3
+                timeline.processed = SimClock::now_serialized();
+                if (sampled) {
+                    record_sample(timeline, polled - polling, counters->read() - matching);
+                }
+                sample_depth(order.symbol, timeline);
+                if (journal && journal->snapshot_due()) {
+                    journal->snapshot(books, shard.symbols);
+                }
+                //records queue wait, matching and end-to-end latency
+                record_latency(order, timeline);
+                timelines.release(order);
+                metrics.add(MetricCounter::ORDERS_PROCESSED);
+                //a batch of one: the book it touched is published straight away
+                if (market_data) {
+                    Timestamp publish_start = SimClock::now();
+                    market_data->publish(order.symbol, *books[order.symbol], publish_start);
+                    shard.publish_stats.add(1, SimClock::elapsed_ns(publish_start, SimClock::now()));
+                }
+            } else if (running) {
+                metrics.add(MetricCounter::IDLE_POLLS);
+                waiter.idle(has_work);
+            }
+        }
+    } else {
+        //batched mode: drain up to batch_size orders into a reusable buffer and match them back to back.
+        //consume/processed are stamped once per batch, except every sample_every-th order which gets
+        //its own stamps around process_order so the per-order matching cost is still visible. a counter
+        //sampled order gets its own stamps too, and its dequeue counts are its share of the poll_bulk call
+        Order* batch = shard.arena.template allocate_array<Order>(settings.batch_size);
+        size_t sample_counter = 0;
+        //books a batch changed, published once each after the batch
+        std::vector<uint8_t> touched_flags(market_data ? settings.num_symbols : 0, 0);
+        std::vector<SymbolID> touched;
+        touched.reserve(market_data ? shard.symbols.size() : 0);
+        PerfSample polling, dequeue, matching;
+        while (draining()) {
+            metrics.poll(refresh_gauges);
+            bool reading = sample_due(settings.batch_size);
+            if (reading) {
+                polling = counters->read();
+            }
+            size_t count = transport.poll_bulk(batch, settings.batch_size);
+            if (reading && count > 0) {
+                dequeue = (counters->read() - polling).share(count);
+            }
+            if (count == 0) {
+                if (running) {
+                    metrics.add(MetricCounter::IDLE_POLLS);
+                    waiter.idle(has_work);
+                }
+                continue;
+            }
+            //Latency Point 2 (batch)
+            Timestamp batch_consume = SimClock::now();
+            waiter.on_work(timelines.at(batch[0]).produce, batch_consume, count);
+            //orders that pass the inline checks are packed to the front of the batch as it goes
+            size_t kept = 0;
+            for (size_t i = 0; i < count; ++i) {
+                Order& order = batch[i];
+                OrderTimeline& timeline = timelines.at(order);
+                reports.begin(timeline.produce);
+                bool counted = take_sample();
+                bool sampled = (settings.sample_every > 0 && ++sample_counter % settings.sample_every == 0) || counted;
+                timeline.consume = sampled ? SimClock::now() : batch_consume;
+                if (risk && !passes_risk(order, timeline)) {
+                    timelines.release(order);
+                    continue;
+                }
+                if (kept != i) {
+                    batch[kept] = order;
+                }
+                ++kept;
+                if (feed) {
+                    feed->begin(timeline.consume);
+                }
+                if (capture) {
+                    capture->append(order, timeline.consume);
+                }
+                if (journal) {
+                    journal->order(order, timeline.consume);
+                }
+                if (counted) {
+                    matching = counters->read();
+                }
+                books[order.symbol]->process_order(order);
+                timeline.processed = sampled ? SimClock::now_serialized() : 0;
+                if (counted) {
+                    record_sample(timeline, dequeue, counters->read() - matching);
+                }
+                sample_depth(order.symbol, timeline);
+                if (market_data && !touched_flags[order.symbol]) {
+                    touched_flags[order.symbol] = 1;
+                    touched.push_back(order.symbol);
+                }
+            }
+            //Latency Point 3 (batch)
+            Timestamp batch_processed = SimClock::now_serialized();
+            for (size_t i = 0; i < kept; ++i) {
+                OrderTimeline& timeline = timelines.at(batch[i]);
+                if (timeline.processed == 0) {
+                    timeline.processed = batch_processed;
+                }
+                record_latency(batch[i], timeline);
+                timelines.release(batch[i]);
+            }
+            metrics.add(MetricCounter::ORDERS_PROCESSED, kept);
+            if (journal && journal->snapshot_due()) {
+                journal->snapshot(books, shard.symbols);
+            }
+            if (market_data) {
+                Timestamp publish_start = SimClock::now();
+                for (SymbolID symbol : touched) {
+                    market_data->publish(symbol, *books[symbol], publish_start);
+                    touched_flags[symbol] = 0;
+                }
+                shard.publish_stats.add(touched.size(), SimClock::elapsed_ns(publish_start, SimClock::now()));
+                touched.clear();
+            }
+        }
+    }
+    if (capture) {
+        capture->close();
+    }
+    if (journal) {
+        journal->close();
+    }
+    if (counters) {
+        counters->stop();
+    }
+    for (SymbolID symbol : shard.symbols) {
+        shard.depth.recentres += books[symbol]->recentres();
+    }
+    metrics.retire();
+    shard.wait_stats.cpu_seconds = thread_cpu_seconds() - cpu_start;
+    shard.wait_stats.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
 }
 //Latency Statistics Function
-void print_latency_stats() {
-    if (end_to_end_latencies_ns.empty()) {
+void print_latency_stats(const LatencyHistogram& latencies, bool open_loop) {
+    if (latencies.count() == 0) {
         std::cout << "No latencies recorded.\n";
         return;
     }
-    std::sort(end_to_end_latencies_ns.begin(), end_to_end_latencies_ns.end());
-    long long total_count = end_to_end_latencies_ns.size();
-    long long sum = std::accumulate(end_to_end_latencies_ns.begin(), end_to_end_latencies_ns.end(), 0LL);
-    double mean_ns = static_cast<double>(sum) / total_count;
-    long long min_ns = end_to_end_latencies_ns.front();
-    long long max_ns = end_to_end_latencies_ns.back();
-    long long p50_ns = end_to_end_latencies_ns[total_count * 0.50];
-    long long p90_ns = end_to_end_latencies_ns[total_count * 0.90];
-    long long p99_ns = end_to_end_latencies_ns[total_count * 0.99];
-    std::cout << "\n--- Latency Statistics (End-to-End) ---\n";
+    std::cout << "\n--- Latency Statistics (End-to-End" << (open_loop ? ", from intended send time" : "") << ") ---\n";
     std::cout << std::fixed << std::setprecision(2);
-    std::cout << "Total Orders: " << total_count << "\n";
-    std::cout << "Mean:         " << mean_ns / 1000.0 << " us\n";
-    std::cout << "Min:          " << min_ns / 1000.0 << " us\n";
-    std::cout << "Median (p50): " << p50_ns / 1000.0 << " us\n";
-    std::cout << "p90:          " << p90_ns / 1000.0 << " us\n";
-    std::cout << "p99:          " << p99_ns / 1000.0 << " us\n";
-    std::cout << "Max:          " << max_ns / 1000.0 << " us\n";
+    std::cout << "Total Orders: " << latencies.count() << "\n";
+    std::cout << "Mean:         " << latencies.mean() / 1000.0 << " us\n";
+    std::cout << "Min:          " << latencies.min() / 1000.0 << " us\n";
+    std::cout << "Median (p50): " << latencies.value_at_percentile(50.0) / 1000.0 << " us\n";
+    std::cout << "p90:          " << latencies.value_at_percentile(90.0) / 1000.0 << " us\n";
+    std::cout << "p99:          " << latencies.value_at_percentile(99.0) / 1000.0 << " us\n";
+    std::cout << "p99.9:        " << latencies.value_at_percentile(99.9) / 1000.0 << " us\n";
+    std::cout << "p99.99:       " << latencies.value_at_percentile(99.99) / 1000.0 << " us\n";
+    std::cout << "Max:          " << latencies.max() / 1000.0 << " us\n";
+}
+//prints one row of the breakdown table
+void print_breakdown_row(const std::string& label, const LatencyHistogram& h) {
+    std::cout << std::left << std::setw(22) << label << std::right
+              << std::setw(10) << h.count()
+              << std::setw(10) << h.value_at_percentile(50.0) / 1000.0
+              << std::setw(10) << h.value_at_percentile(99.0) / 1000.0
+              << std::setw(10) << h.value_at_percentile(99.9) / 1000.0
+              << std::setw(11) << h.max() / 1000.0 << "\n";
 }
+//Latency Breakdown Function: queue wait vs matching vs end-to-end, per flow kind and per producer.
+//open loop adds how far behind schedule orders went out and the latency from the scheduled time
+void print_latency_breakdown(const SimulationSettings& settings, const LatencyRecorder& latencies) {
+    std::cout << "\n--- Latency Breakdown (us) ---\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::left << std::setw(22) << "" << std::right << std::setw(10) << "count"
+              << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9"
+              << std::setw(11) << "max" << "\n";
+    std::vector<LatencyStage> stages = {LatencyStage::QUEUE_WAIT, LatencyStage::MATCHING, LatencyStage::END_TO_END};
+    if (latencies.is_open_loop()) {
+        stages.push_back(LatencyStage::SEND_LAG);
+        stages.push_back(LatencyStage::CORRECTED);
+    }
+    if (settings.risk_mode != RiskMode::OFF) {
+        stages.push_back(LatencyStage::RISK_CHECK);
+    }
+    if (settings.risk_mode == RiskMode::PIPELINED) {
+        stages.push_back(LatencyStage::RISK_HOP);
+    }
+    for (LatencyStage stage : stages) {
+        print_breakdown_row(to_string(stage), latencies.stage_total(stage));
+        for (FlowKind kind : {FlowKind::BUY, FlowKind::SELL, FlowKind::AMEND}) {
+            print_breakdown_row(std::string("  ") + to_string(kind), latencies.stage(stage, kind));
+        }
+        for (size_t producer = 0; producer < latencies.producer_count(); ++producer) {
+            print_breakdown_row("  " + lane_name(settings, producer), latencies.stage(stage, producer));
+        }
+    }
+}
+//how long the reporter waits for every thread to answer a snapshot request, past an engine's longest park
+const std::chrono::microseconds SNAPSHOT_TIMEOUT{5000};
+//books the reporter and the monitor print each interval
+const size_t REPORTED_BOOKS = 4;
 
-//Main Function
-int main() {
-    const int NUM_PRODUCER_THREADS = 4;
-    const int SIMULATION_DURATION_SECONDS = 10;
-    std::cout << "Starting " << NUM_PRODUCER_THREADS << " producer threads.\n";
-    std::cout << "Starting 1 consumer (matching engine) thread.\n";
-    std::cout << "Simulation will run for " << SIMULATION_DURATION_SECONDS << " seconds.\n\n";
+//"14 @ 97 | 3 @ 101, 5x4 levels" for interval and monitor lines
+std::string describe_snapshot(const BookSnapshot& snapshot) {
+    TopOfBook top = snapshot.top();
+    std::ostringstream text;
+    if (top.bid_quantity > 0) {
+        text << top.bid_quantity << " @ " << top.bid_price;
+    } else {
+        text << "[no bids]";
+    }
+    text << " | ";
+    if (top.ask_quantity > 0) {
+        text << top.ask_quantity << " @ " << top.ask_price;
+    } else {
+        text << "[no asks]";
+    }
+    text << ", " << snapshot.bid_count << "x" << snapshot.ask_count << " levels";
+    return text.str();
+}
+
+//Reporter Thread Function, snapshots every thread's metrics each report interval without ever blocking
+//them, then prints each shard's interval latency and one line of rates and gauges for the whole run
+void reporter_thread(MetricsRegistry& metrics, const SimulationSettings& settings,
+                     const MarketDataPublisher* market_data) {
+    std::vector<MetricsSample> current;
+    std::vector<MetricsSample> previous;
+    metrics.snapshot(previous, SNAPSHOT_TIMEOUT);
+    auto last = std::chrono::steady_clock::now();
+    int interval_number = 0;
+    while (running) {
+        //sleeps in short steps so the run's end is noticed quickly
+        auto next = last + settings.report_interval;
+        while (running && std::chrono::steady_clock::now() < next) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (!running) {
+            break;
+        }
+        metrics.snapshot(current, SNAPSHOT_TIMEOUT);
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - last).count();
+        last = now;
+        ++interval_number;
+        uint64_t processed = 0, sent = 0, retries = 0;
+        int64_t depth = 0, resting = 0;
+        size_t stale = 0;
+        std::ostringstream lines;
+        lines << std::fixed << std::setprecision(2);
+        for (size_t i = 0; i < current.size(); ++i) {
+            const MetricValues& values = current[i].values;
+            const MetricValues& before = previous[i].values;
+            stale += current[i].fresh ? 0 : 1;
+            if (current[i].role == MetricRole::PRODUCER) {
+                sent += values[MetricCounter::ORDERS_SENT] - before[MetricCounter::ORDERS_SENT];
+                retries += values[MetricCounter::SEND_RETRIES] - before[MetricCounter::SEND_RETRIES];
+                continue;
+            }
+            processed += values[MetricCounter::ORDERS_PROCESSED] - before[MetricCounter::ORDERS_PROCESSED];
+            depth += values[MetricGauge::TRANSPORT_DEPTH];
+            resting += values[MetricGauge::RESTING_ORDERS];
+            const LatencyHistogram& interval = values[MetricHistogram::LATENCY];
+            if (interval.count() == 0) {
+                continue; //a shard that owns no traded symbol
+            }
+            lines << "[interval " << interval_number;
+            if (settings.num_shards > 1) {
+                lines << " shard " << current[i].index;
+            }
+            lines << "] orders: " << interval.count()
+                  << "  p50: " << interval.value_at_percentile(50.0) / 1000.0 << " us"
+                  << "  p99: " << interval.value_at_percentile(99.0) / 1000.0 << " us"
+                  << "  p99.9: " << interval.value_at_percentile(99.9) / 1000.0 << " us"
+                  << "  max: " << interval.max() / 1000.0 << " us\n";
+        }
+        lines << "[metrics " << interval_number << "] sent: " << static_cast<uint64_t>(sent / seconds) << "/s"
+              << "  processed: " << static_cast<uint64_t>(processed / seconds) << "/s"
+              << "  queued: " << depth << "  resting: " << resting << "  full-ring retries: " << retries;
+        if (stale > 0) {
+            lines << "  (" << stale << " thread" << (stale > 1 ? "s" : "") << " late, last values used)";
+        }
+        lines << "\n";
+        //the reporter is also a market data reader: the first few books as last published
+        if (market_data) {
+            BookSnapshot snapshot;
+            for (size_t symbol = 0; symbol < std::min<size_t>(market_data->num_symbols(), REPORTED_BOOKS); ++symbol) {
+                market_data->slot(static_cast<SymbolID>(symbol)).read(snapshot);
+                if (snapshot.updates == 0) {
+                    continue;
+                }
+                lines << "[book " << interval_number << " symbol " << symbol << "] " << describe_snapshot(snapshot)
+                      << "  (" << SimClock::elapsed_ns(snapshot.published, SimClock::now()) / 1000.0 << " us old)\n";
+            }
+        }
+        std::cout << lines.str();
+        std::swap(previous, current);
+    }
+}
+
+//Feed Thread Function: the downstream end of the L2 feed. drains every shard's update ring, counts sequence
+//gaps, conflates and delivers, recording how long each update took from its level change to delivery.
+//it keeps going until the engines are done and their rings are empty
+template <typename Book, typename Transport>
+void feed_thread(ShardList<Book, Transport>& shards, const SimulationSettings& settings,
+                 const std::atomic<bool>& engines_done, FeedStats& stats) {
+    FeedConflater conflater(settings.feed_conflation);
+    std::vector<uint64_t> expected(shards.size(), 0);
+    LevelUpdate received[FEED_BULK];
+    Timestamp now = SimClock::now();
+    auto deliver = [&](const LevelUpdate& update) {
+        stats.delivery.record_ns(SimClock::elapsed_ns(update.time, now));
+        ++stats.delivered;
+    };
+    while (true) {
+        //read before draining, so the pass after the engines finish still empties their rings
+        bool done = engines_done.load(std::memory_order_acquire);
+        size_t drained = 0;
+        for (size_t i = 0; i < shards.size(); ++i) {
+            LevelUpdateRing& ring = shards[i]->feed->updates();
+            while (size_t count = ring.try_pop_bulk(received, FEED_BULK)) {
+                now = SimClock::now();
+                for (size_t j = 0; j < count; ++j) {
+                    stats.gaps += received[j].sequence - expected[i];
+                    expected[i] = received[j].sequence + 1;
+                    conflater.add(received[j], now, deliver);
+                }
+                drained += count;
+            }
+        }
+        stats.received += drained;
+        now = SimClock::now();
+        conflater.flush(now, deliver, done);
+        if (done) {
+            break;
+        }
+        if (drained == 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+//prints each shard's books, pools and share of the load once the engines have been joined
+template <typename Book, typename Transport>
+void print_shards(const SimulationSettings& settings, const ShardList<Book, Transport>& shards) {
+    std::cout << "\n--- FINAL ---" << std::endl;
+    for (size_t i = 0; i < shards.size(); ++i) {
+        const auto& shard = *shards[i];
+        if (shards.size() > 1) {
+            std::cout << "=== Shard " << i << " ===\n";
+        }
+        for (SymbolID symbol : shard.symbols) {
+            if (settings.num_symbols > 1) {
+                std::cout << "Symbol " << symbol << "\n";
+            }
+            shard.books[symbol]->print_top_of_book();
+            std::cout << "Resting orders: " << shard.books[symbol]->resting_orders() << " over "
+                      << shard.books[symbol]->price_levels() << " levels\n";
+        }
+        shard.arena.print_usage();
+        if (shard.capture) {
+            std::cout << "Captured " << shard.capture->records() << " orders (" << shard.capture->stalls()
+                      << " writer stalls)\n";
+        }
+        if (settings.snapshot_depth > 0) {
+            const PublishStats& published = shard.publish_stats;
+            uint64_t orders = shard.latencies.totals().count();
+            std::cout << std::fixed << std::setprecision(1) << "Market data: " << published.snapshots
+                      << " snapshots of " << settings.snapshot_depth << " levels, "
+                      << (published.snapshots ? published.publish_ns / static_cast<double>(published.snapshots) : 0.0)
+                      << " ns each, " << (orders ? published.publish_ns / static_cast<double>(orders) : 0.0)
+                      << " ns per order\n";
+        }
+    }
+    if (shards.size() < 2) {
+        return;
+    }
+    std::cout << "\n--- Shards ---\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(8) << "shard" << std::setw(10) << "symbols" << std::setw(12) << "orders"
+              << std::setw(14) << "orders/s" << std::setw(10) << "p50 us" << std::setw(10) << "p99 us"
+              << std::setw(11) << "max us" << std::setw(12) << "engine cpu%" << "\n";
+    for (size_t i = 0; i < shards.size(); ++i) {
+        const auto& shard = *shards[i];
+        const LatencyHistogram& totals = shard.latencies.totals();
+        std::cout << std::setw(8) << i << std::setw(10) << shard.symbols.size() << std::setw(12) << totals.count()
+                  << std::setw(14) << static_cast<uint64_t>(totals.count() / static_cast<double>(settings.duration_seconds))
+                  << std::setw(10) << totals.value_at_percentile(50.0) / 1000.0
+                  << std::setw(10) << totals.value_at_percentile(99.0) / 1000.0
+                  << std::setw(11) << totals.max() / 1000.0 << std::setw(12) << shard.wait_stats.cpu_percent() << "\n";
+    }
+}
+
+//Simulation Function: runs the engine shards, reporter and producers for one book/transport combination,
+//then folds every shard's results into stats
+template <typename Book, typename Transport>
+void run_simulation(const SimulationSettings& settings, RunStats& stats) {
+    ShardRouter router(settings.num_shards, settings.num_symbols);
+    ShardList<Book, Transport> shards;
+    for (size_t i = 0; i < settings.num_shards; ++i) {
+        shards.push_back(std::make_unique<EngineShard<Book, Transport>>(settings, router.symbols_of(i), i));
+        if (shards.back()->capture && !shards.back()->capture->ok()) {
+            std::cerr << "Capture disabled: " << shards.back()->capture->error() << "\n";
+            shards.back()->capture.reset();
+        }
+        if (shards.back()->journal && !shards.back()->journal->ok()) {
+            std::cerr << "Journal disabled: " << shards.back()->journal->error() << "\n";
+            shards.back()->reports.attach_journal(nullptr);
+            shards.back()->journal.reset();
+        }
+    }
+    //one metrics slot per engine and producer, claimed before any thread starts
+    MetricsRegistry metrics;
+    std::vector<ThreadMetrics*> engine_metrics;
+    std::vector<ThreadMetrics*> producer_metrics;
+    for (size_t i = 0; i < shards.size(); ++i) {
+        engine_metrics.push_back(&metrics.add_thread(MetricRole::ENGINE, i));
+    }
+    for (int i = 0; i < settings.num_producers; ++i) {
+        producer_metrics.push_back(&metrics.add_thread(MetricRole::PRODUCER, static_cast<size_t>(i)));
+    }
+    //the ingress thread counts as one more producer, sending on behalf of every client
+    std::unique_ptr<IngressSegment> ingress;
+    ThreadMetrics* ingress_metrics = nullptr;
+    if (!settings.ingress_shm.empty()) {
+        ingress = std::make_unique<IngressSegment>(settings.ingress_shm, settings.ingress_clients,
+                                                   settings.transport_capacity, settings.num_symbols);
+        if (!ingress->ok()) {
+            std::cerr << "Ingress disabled: " << ingress->error() << "\n";
+            ingress.reset();
+        } else {
+            ingress_metrics = &metrics.add_thread(MetricRole::PRODUCER, first_client_lane(settings));
+        }
+    }
+    //the network thread too, on whichever receiver the protocol asks for
+    std::unique_ptr<UdpReceiver> udp;
+    std::unique_ptr<TcpReceiver> tcp;
+    ThreadMetrics* network_metrics = nullptr;
+    bool network_ok = false;
+    if (settings.net_ingress == NetProtocol::UDP) {
+        udp = std::make_unique<UdpReceiver>(settings.net_address, settings.net_port, settings.net_recv_batch);
+        network_ok = udp->ok();
+        if (!network_ok) {
+            std::cerr << "Network ingress disabled: " << udp->error() << "\n";
+        }
+    } else if (settings.net_ingress == NetProtocol::TCP) {
+        tcp = std::make_unique<TcpReceiver>(settings.net_address, settings.net_port, settings.net_recv_batch);
+        network_ok = tcp->ok();
+        if (!network_ok) {
+            std::cerr << "Network ingress disabled: " << tcp->error() << "\n";
+        }
+    }
+    if (network_ok) {
+        network_metrics = &metrics.add_thread(MetricRole::PRODUCER, network_lane(settings));
+    }
+    std::unique_ptr<MarketDataPublisher> market_data;
+    if (settings.snapshot_depth > 0) {
+        market_data = std::make_unique<MarketDataPublisher>(settings.num_symbols, settings.snapshot_depth,
+                                                            settings.market_data_shm);
+        if (!market_data->ok()) {
+            std::cerr << "Market data disabled: " << market_data->error() << "\n";
+            market_data.reset();
+        }
+    }
+    //warm-up, part one: everything set up so far is faulted in before any thread starts, pinned with mlockall,
+    //or at least touched page by page. the arenas were NUMA-placed first, so the faults land on their node
+    if (settings.lock_memory) {
+        stats.memory_lock = lock_process_memory();
+    }
+    if (!stats.memory_lock.locked && settings.warmup_seconds > 0) {
+        for (auto& shard : shards) {
+            shard->arena.prefault();
+        }
+        stats.arena.prefault();
+        stats.prefaulted = true;
+    }
+    std::vector<std::thread> consumers;
     std::vector<std::thread> producers;
-    std::thread consumer = std::thread(consumer_thread); //Starts the single consumer thread
-    for (int i = 0; i < NUM_PRODUCER_THREADS; ++i) {
-        producers.emplace_back(producer_thread, i); //starts all producer threads
+    std::vector<std::thread> risk_checkers;
+    measure_window.reset();
+    running = true;
+    //a pipelined risk thread per shard, marked as forwarding before its engine can look
+    if (settings.risk_mode == RiskMode::PIPELINED) {
+        for (auto& shard : shards) {
+            shard->risk_forwarding.store(true, std::memory_order_relaxed);
+        }
+    }
+    //Starts one consumer thread per shard
+    for (size_t i = 0; i < shards.size(); ++i) {
+        consumers.emplace_back(consumer_thread<Book, Transport>, std::ref(*shards[i]), i, std::ref(stats.timelines),
+                               std::cref(settings), std::ref(*engine_metrics[i]), market_data.get());
+    }
+    if (settings.risk_mode == RiskMode::PIPELINED) {
+        for (auto& shard : shards) {
+            risk_checkers.emplace_back(risk_thread<Book, Transport>, std::ref(*shard), std::ref(stats.timelines),
+                                       std::cref(settings), static_cast<const MarketDataPublisher*>(market_data.get()));
+        }
+    }
+    std::atomic<bool> engines_done{false};
+    std::thread feed;
+    if (settings.l2_feed) {
+        feed = std::thread(feed_thread<Book, Transport>, std::ref(shards), std::cref(settings), std::cref(engines_done),
+                           std::ref(stats.feed));
+    }
+    std::thread reporter;
+    if (settings.verbose) {
+        reporter = std::thread(reporter_thread, std::ref(metrics), std::cref(settings),
+                               static_cast<const MarketDataPublisher*>(market_data.get()));
     }
+    for (int i = 0; i < settings.num_producers; ++i) {
+        //starts all producer threads
+        producers.emplace_back(producer_thread<Book, Transport>, std::ref(shards), std::cref(router),
+                               std::ref(stats.timelines), i,
+                               std::cref(settings), std::ref(stats.wait_stats[settings.num_shards + i]),
+                               std::ref(stats.round_trips[i]), std::ref(stats.sent[i]),
+                               std::ref(*producer_metrics[i]));
+    }
+    std::thread ingress_reader;
+    if (ingress) {
+        if (settings.verbose) {
+            std::cout << "Ingress: " << ingress->num_clients() << " client slot"
+                      << (ingress->num_clients() == 1 ? "" : "s") << " at " << ingress->name() << ", "
+                      << ingress->capacity() << " records per ring.\n";
+        }
+        ingress_reader = std::thread(ingress_thread<Book, Transport>, std::ref(shards), std::cref(router),
+                                     std::ref(stats.timelines), std::ref(*ingress), std::cref(settings),
+                                     std::ref(stats.ingress), std::ref(*ingress_metrics));
+    }
+    std::thread network;
+    if (network_ok) {
+        auto start = [&](auto& receiver) {
+            using Receiver = std::remove_reference_t<decltype(receiver)>;
+            if (settings.verbose) {
+                std::cout << "Network ingress: " << Receiver::NAME << " on " << settings.net_address << ":"
+                          << settings.net_port << ".\n";
+            }
+            return std::thread(network_thread<Book, Transport, Receiver>, std::ref(shards), std::cref(router),
+                               std::ref(stats.timelines), std::ref(receiver), std::cref(settings),
+                               std::ref(stats.network), std::ref(*network_metrics));
+        };
+        network = udp ? start(*udp) : start(*tcp);
+    }
+    //warm-up, part two: caches, branch predictors and books fill with the real flow while nothing is reported
+    if (settings.warmup_seconds > 0) {
+        std::this_thread::sleep_for(std::chrono::seconds(settings.warmup_seconds));
+        if (settings.verbose) {
+            std::cout << "Warm-up done, measuring for " << settings.duration_seconds << " seconds.\n";
+        }
+    }
+    measure_window.from.store(SimClock::now(), std::memory_order_relaxed);
     //simulation runs
-    std::this_thread::sleep_for(std::chrono::seconds(SIMULATION_DURATION_SECONDS));
+    std::this_thread::sleep_for(std::chrono::seconds(settings.duration_seconds));
+    measure_window.until.store(SimClock::now(), std::memory_order_relaxed);
     running = false; //signals threads to stop
-    std::cout << "\nStopping simulation, waiting for threads to finish...\n";
+    auto drain_start = std::chrono::steady_clock::now();
+    for (auto& shard : shards) {
+        stats.queued_at_stop += shard->transport.size_approx() + (shard->risk_inbound ? shard->risk_inbound->size_approx() : 0);
+    }
+    if (settings.verbose) {
+        std::cout << "\nStopping simulation, draining " << stats.queued_at_stop << " queued orders...\n";
+    }
     for (auto& t : producers) {
         t.join();
     }
-    std::cout << "Producer threads joined.\n";
-    //wait for consumer thread to join
-    consumer.join();
-    std::cout << "Consumer thread joined.\n";
-    print_latency_stats();
+    if (ingress_reader.joinable()) {
+        ingress_reader.join();
+    }
+    if (network.joinable()) {
+        network.join();
+    }
+    for (auto& t : risk_checkers) {
+        t.join();
+    }
+    if (settings.verbose) {
+        std::cout << "Producer threads joined.\n";
+    }
+    //wait for consumer threads to join
+    for (auto& t : consumers) {
+        t.join();
+    }
+    stats.drain_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - drain_start).count();
+    if (settings.verbose) {
+        std::cout << "Consumer thread" << (consumers.size() > 1 ? "s" : "") << " joined.\n";
+    }
+    engines_done = true;
+    if (feed.joinable()) {
+        feed.join();
+    }
+    if (reporter.joinable()) {
+        reporter.join();
+    }
+    for (size_t i = 0; i < shards.size(); ++i) {
+        stats.latencies.merge(shards[i]->latencies);
+        stats.wait_stats[i] = shards[i]->wait_stats;
+        if (settings.risk_mode == RiskMode::PIPELINED) {
+            stats.wait_stats[settings.num_shards + static_cast<size_t>(settings.num_producers) + i] =
+                shards[i]->risk_wait_stats;
+        }
+        stats.dropped_reports += shards[i]->reports.dropped();
+        if (shards[i]->feed) {
+            stats.feed.published += shards[i]->feed->published();
+        }
+        if (shards[i]->risk) {
+            stats.risk.add(shards[i]->risk->stats());
+        }
+        if (shards[i]->journal) {
+            stats.journal.add(shards[i]->journal->stats());
+        }
+        if (shards[i]->perf) {
+            stats.perf->merge(*shards[i]->perf);
+        }
+        stats.depth.add(shards[i]->depth);
+        stats.throughput.merge(shards[i]->throughput);
+        stats.unmeasured += shards[i]->unmeasured;
+    }
+    if (settings.verbose) {
+        print_shards(settings, shards);
+    }
+    if (stats.memory_lock.locked) {
+        unlock_process_memory();
+    }
+}
+
+template <typename Transport>
+void run_with_transport(const SimulationSettings& settings, RunStats& stats) {
+    if (settings.book_backend == BookBackend::MAP) {
+        run_simulation<MapOrderBook, Transport>(settings, stats);
+    } else {
+        run_simulation<LadderOrderBook, Transport>(settings, stats);
+    }
+}
+
+//Round Trip Report Function: order -> final execution report as seen by the producers. a producer that slept
+//through part of a pacing gap (spin-park with a gap longer than producer_spin_window) only takes reports off
+//its rings once it wakes, so its numbers include the wake-up and are kept apart from the producers that polled
+//the whole time
+void print_round_trips(const SimulationSettings& settings, const RunStats& stats) {
+    struct Group {
+        LatencyHistogram round_trip;
+        LatencyHistogram return_leg;
+        LatencyHistogram passive_fill;
+        size_t producers = 0;
+    };
+    Group polled;
+    Group woke;
+    uint64_t reports = 0;
+    auto slept = [&](size_t producer) { return stats.wait_stats[settings.num_shards + producer].parks > 0; };
+    for (size_t i = 0; i < stats.round_trips.size(); ++i) {
+        const RoundTripStats& producer = stats.round_trips[i];
+        Group& group = slept(i) ? woke : polled;
+        group.round_trip.merge(producer.round_trip);
+        group.return_leg.merge(producer.return_leg);
+        group.passive_fill.merge(producer.passive_fill);
+        ++group.producers;
+        reports += producer.reports;
+    }
+    std::cout << "\n--- Round Trip (us) ---\n";
+    std::cout << "round trip = produce -> final report received, return leg = engine emit -> received, "
+                 "passive fill = aggressor produced -> resting owner received\n";
+    if (woke.producers > 0) {
+        std::cout << woke.producers << " of " << stats.round_trips.size() << " producers slept through part of a "
+                  << "pacing gap and only received reports on waking, their rows include the wake-up. spin and "
+                  << "spin_yield producers, or spin_park ones with gaps within producer_spin_window, poll throughout\n";
+    }
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::left << std::setw(22) << "" << std::right << std::setw(10) << "count"
+              << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9"
+              << std::setw(11) << "max" << "\n";
+    if (polled.producers > 0) {
+        print_breakdown_row("round trip", polled.round_trip);
+        print_breakdown_row("return leg", polled.return_leg);
+        print_breakdown_row("passive fill", polled.passive_fill);
+    }
+    if (woke.producers > 0) {
+        print_breakdown_row("round trip + wake-up", woke.round_trip);
+        print_breakdown_row("return leg + wake-up", woke.return_leg);
+        print_breakdown_row("passive fill + wake-up", woke.passive_fill);
+    }
+    for (size_t i = 0; i < stats.round_trips.size(); ++i) {
+        print_breakdown_row("  producer " + std::to_string(i) + (slept(i) ? " + wake" : ""),
+                            stats.round_trips[i].round_trip);
+    }
+    std::cout << "Reports received: " << reports << ", dropped (return ring full): " << stats.dropped_reports << "\n";
+}
+
+//Wait Strategy Report Function: CPU burn vs wake-up latency for each engine, producer and pipelined risk thread
+void print_wait_stats(const SimulationSettings& settings, const std::vector<WaitStats>& wait_stats) {
+    std::cout << "\n--- Wait Strategies (engine: " << to_string(settings.engine_wait)
+              << ", producers: " << to_string(settings.producer_wait) << ") ---\n";
+    std::cout << "engine and risk wake-up = produce->consume of the first order after idling, "
+                 "producer wake-up = overshoot of the pacing gap\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::left << std::setw(14) << "thread" << std::right << std::setw(8) << "cpu %"
+              << std::setw(14) << "idle waits" << std::setw(12) << "parks" << std::setw(12) << "wake p50"
+              << std::setw(12) << "wake p99" << std::setw(12) << "wake max" << "  (us)\n";
+    for (size_t i = 0; i < wait_stats.size(); ++i) {
+        const WaitStats& w = wait_stats[i];
+        std::string name;
+        const size_t risk_from = settings.num_shards + static_cast<size_t>(settings.num_producers);
+        if (i < settings.num_shards) {
+            name = settings.num_shards == 1 ? "engine" : "engine " + std::to_string(i);
+        } else if (i < risk_from) {
+            name = "producer " + std::to_string(i - settings.num_shards);
+        } else {
+            name = settings.num_shards == 1 ? "risk" : "risk " + std::to_string(i - risk_from);
+        }
+        std::cout << std::left << std::setw(14) << name << std::right << std::setw(8) << w.cpu_percent()
+                  << std::setw(14) << w.idle_waits << std::setw(12) << w.parks
+                  << std::setw(12) << w.wakeup.value_at_percentile(50.0) / 1000.0
+                  << std::setw(12) << w.wakeup.value_at_percentile(99.0) / 1000.0
+                  << std::setw(12) << w.wakeup.max() / 1000.0 << "\n";
+    }
+}
+
+//L2 Feed Report Function: what the engines emitted, what survived conflation and how long delivery took
+void print_feed_stats(const SimulationSettings& settings, const RunStats& stats) {
+    const FeedStats& feed = stats.feed;
+    double seconds = static_cast<double>(settings.duration_seconds);
+    uint64_t orders = stats.latencies.totals().count();
+    std::cout << "\n--- L2 Feed (";
+    if (settings.feed_conflation.count() > 0) {
+        std::cout << "conflated over " << settings.feed_conflation.count() << " us";
+    } else {
+        std::cout << "no conflation";
+    }
+    std::cout << ") ---\n" << std::fixed << std::setprecision(2);
+    std::cout << "Published: " << feed.published << " level updates (" << static_cast<uint64_t>(feed.published / seconds)
+              << "/s, " << (orders ? feed.published / static_cast<double>(orders) : 0.0) << " per order), "
+              << feed.gaps << " dropped on a full ring\n";
+    std::cout << "Delivered: " << feed.delivered << " (" << static_cast<uint64_t>(feed.delivered / seconds) << "/s, "
+              << (feed.published ? 100.0 * feed.delivered / feed.published : 0.0) << "% of published)\n";
+    std::cout << "Level change -> delivered: p50 " << feed.delivery.value_at_percentile(50.0) / 1000.0
+              << " us  p99 " << feed.delivery.value_at_percentile(99.0) / 1000.0
+              << " us  p99.9 " << feed.delivery.value_at_percentile(99.9) / 1000.0
+              << " us  max " << feed.delivery.max() / 1000.0 << " us\n";
+}
+
+//Ingress Report Function: the cross-process path next to the in-process one. every stage is timed on the
+//same clock, from the client's or the producer thread's produce stamp
+void print_ingress_stats(const SimulationSettings& settings, const RunStats& stats) {
+    const IngressStats& ingress = stats.ingress;
+    std::cout << "\n--- Shared Memory Ingress (" << settings.ingress_shm << ") ---\n";
+    std::cout << "Clients: " << ingress.clients << " of " << settings.ingress_clients << " slots connected, "
+              << ingress.received << " orders received, " << ingress.malformed << " malformed and dropped, "
+              << ingress.discarded << " left on the rings at stop\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::left << std::setw(22) << "(us)" << std::right << std::setw(10) << "count"
+              << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9"
+              << std::setw(11) << "max" << "\n";
+    print_breakdown_row("shared ring hop", ingress.hop);
+    size_t producers = static_cast<size_t>(settings.num_producers);
+    for (LatencyStage stage : {LatencyStage::QUEUE_WAIT, LatencyStage::END_TO_END}) {
+        LatencyHistogram in_process;
+        LatencyHistogram cross_process;
+        for (size_t lane = 0; lane < producers; ++lane) {
+            in_process.merge(stats.latencies.stage(stage, lane));
+        }
+        for (size_t lane = first_client_lane(settings); lane < stats.latencies.producer_count(); ++lane) {
+            cross_process.merge(stats.latencies.stage(stage, lane));
+        }
+        print_breakdown_row(std::string(to_string(stage)) + " in-process", in_process);
+        print_breakdown_row(std::string(to_string(stage)) + " clients", cross_process);
+    }
+}
+
+//Network Ingress Report Function: what arrived on the socket and how long it took from the sender's send
+//call to the receive, the engine and the end of matching
+void print_network_stats(const SimulationSettings& settings, const RunStats& stats) {
+    const NetworkStats& network = stats.network;
+    size_t lane = network_lane(settings);
+    std::cout << "\n--- Network Ingress ("
+              << (settings.net_ingress == NetProtocol::UDP ? UdpReceiver::NAME : TcpReceiver::NAME) << " on "
+              << settings.net_address << ":" << settings.net_port << ") ---\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Messages: " << network.messages << " orders in " << network.receives << " receive calls ("
+              << (network.receives ? network.messages / static_cast<double>(network.receives) : 0.0) << " per call), "
+              << network.malformed << " malformed, " << network.gaps << " lost (sequence gaps), "
+              << network.stray_bytes << " stray bytes, " << network.replies << " reports sent back\n";
+    std::cout << std::left << std::setw(22) << "(us)" << std::right << std::setw(10) << "count"
+              << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9"
+              << std::setw(11) << "max" << "\n";
+    print_breakdown_row("wire -> received", network.wire);
+    print_breakdown_row("wire -> engine", stats.latencies.stage(LatencyStage::QUEUE_WAIT, lane));
+    print_breakdown_row("wire -> match", stats.latencies.stage(LatencyStage::END_TO_END, lane));
+}
+
+//Risk Report Function: the limits, what the checks let through, why the rest was rejected, and the cost of
+//the stage next to matching so inline and pipelined runs can be compared
+void print_risk_stats(const SimulationSettings& settings, const RunStats& stats) {
+    const RiskStats& risk = stats.risk;
+    const RiskLimits& limits = settings.risk_limits;
+    const bool pipelined = settings.risk_mode == RiskMode::PIPELINED;
+    auto limit = [](auto value, const char* unit) {
+        return value > 0 ? std::to_string(value) + unit : std::string("off");
+    };
+    std::cout << "\n--- Risk Checks (" << to_string(settings.risk_mode) << ") ---\n";
+    std::cout << "Limits: max quantity " << limit(limits.max_quantity, "") << ", collar "
+              << limit(limits.collar_ticks, " ticks") << ", position " << limit(limits.max_position, "")
+              << ", rate " << limit(static_cast<uint64_t>(limits.max_rate), "/s") << " (burst "
+              << static_cast<uint64_t>(limits.rate_burst) << ")\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Checked: " << risk.checked << " messages, " << risk.total_rejected() << " rejected ("
+              << (risk.checked ? 100.0 * risk.total_rejected() / risk.checked : 0.0) << "%) "
+              << (pipelined ? "and dropped before the engine" : "with a rejected report") << "\n";
+    for (size_t reason = 1; reason < RISK_REJECT_COUNT; ++reason) {
+        std::cout << "  " << std::left << std::setw(20) << to_string(static_cast<RiskReject>(reason)) << std::right
+                  << risk.rejected[reason] << "\n";
+    }
+    std::cout << std::left << std::setw(22) << "(us)" << std::right << std::setw(10) << "count"
+              << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9"
+              << std::setw(11) << "max" << "\n";
+    print_breakdown_row("risk check", stats.latencies.stage_total(LatencyStage::RISK_CHECK));
+    if (pipelined) {
+        print_breakdown_row("risk -> engine", stats.latencies.stage_total(LatencyStage::RISK_HOP));
+    }
+    print_breakdown_row("matching", stats.latencies.stage_total(LatencyStage::MATCHING));
+    print_breakdown_row("end-to-end", stats.latencies.stage_total(LatencyStage::END_TO_END));
+}
+
+//Journal Report Function: what the writer threads persisted, how many records each sync covered and how far
+//durability trailed the engine
+void print_journal_stats(const SimulationSettings& settings, const RunStats& stats) {
+    const JournalStats& journal = stats.journal;
+    std::cout << "\n--- Journal (" << settings.journal_path << ", sync " << to_string(settings.journal_sync);
+    if (settings.journal_sync == JournalSync::INTERVAL) {
+        std::cout << " every " << settings.journal_commit_interval.count() << " us";
+    }
+    if (settings.journal_direct) {
+        std::cout << (journal.direct ? ", O_DIRECT" : ", O_DIRECT refused, buffered");
+    }
+    std::cout << ") ---\n" << std::fixed << std::setprecision(2);
+    std::cout << "Records: " << journal.records << " (" << journal.snapshots << " snapshots), "
+              << journal.bytes / (1024.0 * 1024.0) << " MiB in " << journal.writes << " writes and " << journal.syncs
+              << " syncs (" << (journal.syncs ? journal.records / static_cast<double>(journal.syncs) : 0.0)
+              << " records per sync), " << journal.stalls << " stalls on a full ring, " << journal.write_errors
+              << " write errors\n";
+    std::cout << std::left << std::setw(22) << "(us)" << std::right << std::setw(10) << "count"
+              << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9"
+              << std::setw(11) << "max" << "\n";
+    print_breakdown_row("sync call", journal.sync_time);
+    print_breakdown_row(settings.journal_sync == JournalSync::NONE ? "append -> written" : "append -> durable",
+                        journal.durable);
+}
+
+//Run Lifecycle Function: how the run was split into warm-up, measurement and drain, and the orders finished
+//in each second of the window
+void print_lifecycle(const SimulationSettings& settings, const RunStats& stats) {
+    std::cout << "\n--- Run Lifecycle ---\n" << std::fixed << std::setprecision(1);
+    std::cout << "Warm-up:  " << settings.warmup_seconds << " s, " << stats.unmeasured
+              << " orders sent outside the window, their latencies not reported, memory ";
+    if (stats.memory_lock.future) {
+        std::cout << "locked (mlockall, current and future pages)";
+    } else if (stats.memory_lock.locked) {
+        std::cout << "locked (mlockall, pages mapped before the run only)";
+    } else {
+        std::cout << (settings.lock_memory ? "lock refused, " : "not locked, ")
+                  << (stats.prefaulted ? "arenas pre-faulted" : "not pre-faulted");
+    }
+    std::cout << "\n";
+    uint64_t measured = stats.latencies.totals().count();
+    std::cout << "Measured: " << settings.duration_seconds << " s, " << measured
+              << " orders with an intended send time in the window\n";
+    std::cout << "Drain:    " << stats.drain_seconds * 1000.0 << " ms, " << stats.queued_at_stop
+              << " orders queued when the producers stopped, " << stats.throughput.per_second.back()
+              << " orders finished after the window closed\n";
+    std::cout << "Throughput per second of the window (orders finished):\n";
+    const std::vector<uint64_t>& series = stats.throughput.per_second;
+    for (size_t second = 0; second + 1 < series.size(); ++second) {
+        std::cout << std::setw(6) << second + 1 << "s " << std::setw(12) << series[second] << "\n";
+    }
+}
+
+//Book Depth Function: how deep the books the orders met were, and how often the ladder had to move
+void print_depth_stats(const SimulationSettings& settings, const DepthStats& depth) {
+    if (depth.samples == 0) {
+        return;
+    }
+    std::cout << "\n--- Book Depth (the book every " << DEPTH_SAMPLE_EVERY << "th order went to) ---\n"
+              << std::fixed << std::setprecision(1);
+    std::cout << "Resting orders: " << depth.mean_resting() << " mean, " << depth.max_resting << " max\n";
+    std::cout << "Price levels:   " << depth.mean_levels() << " mean, " << depth.max_levels << " max\n";
+    if (settings.book_backend == BookBackend::LADDER) {
+        std::cout << "Ladder re-centres: " << depth.recentres << "\n";
+    }
+}
+
+//Perf Profile Function: mean hardware counts per sampled order within bands of the sampled orders' own
+//latency, one table per engine step, so a slow tail can be told apart by cache misses or mispredicts
+void print_perf_profile(const SimulationSettings& settings, const PerfProfile& profile) {
+    const LatencyHistogram& sampled = profile.sampled();
+    std::cout << "\n--- Hardware Counters (1 in " << settings.perf_sample_every << " orders, "
+              << profile.backend() << ", by " << (settings.perf_bucket == PerfBucket::MATCHING ? "matching" : "end-to-end")
+              << " latency) ---\n";
+    if (std::string(profile.backend()) == "none") {
+        std::cout << "Counters unavailable (perf_event_open refused, kperf not loaded or unsupported platform), "
+                  << sampled.count() << " orders sampled for latency only\n";
+        return;
+    }
+    if (sampled.count() == 0) {
+        std::cout << "No orders sampled.\n";
+        return;
+    }
+    struct Band {
+        const char* name;
+        double from, to;
+    };
+    const Band bands[] = {{"p0-p50", 0.0, 50.0}, {"p50-p90", 50.0, 90.0}, {"p90-p99", 90.0, 99.0},
+                          {"p99-p99.9", 99.0, 99.9}, {"p99.9-max", 99.9, 100.0}};
+    std::cout << std::fixed << std::setprecision(1);
+    for (size_t stage = 0; stage < PERF_STAGE_COUNT; ++stage) {
+        std::cout << to_string(static_cast<PerfStage>(stage)) << " (per order)\n";
+        std::cout << std::left << std::setw(12) << "band" << std::right << std::setw(10) << "orders"
+                  << std::setw(10) << "<= us";
+        for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            std::cout << std::setw(14) << to_string(static_cast<PerfEvent>(i));
+        }
+        std::cout << std::setw(8) << "IPC" << "\n";
+        for (const Band& band : bands) {
+            PerfBand counts = profile.band(band.from, band.to);
+            std::cout << std::left << std::setw(12) << band.name << std::right << std::setw(10) << counts.orders
+                      << std::setw(10) << sampled.value_at_percentile(band.to) / 1000.0;
+            for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+                PerfEvent event = static_cast<PerfEvent>(i);
+                if (profile.available(event) && counts.orders > 0) {
+                    std::cout << std::setw(14) << counts.mean(static_cast<PerfStage>(stage), event);
+                } else {
+                    std::cout << std::setw(14) << "-";
+                }
+            }
+            double cycles = counts.mean(static_cast<PerfStage>(stage), PerfEvent::CYCLES);
+            if (profile.available(PerfEvent::INSTRUCTIONS) && cycles > 0.0) {
+                std::cout << std::setw(8) << std::setprecision(2)
+                          << counts.mean(static_cast<PerfStage>(stage), PerfEvent::INSTRUCTIONS) / cycles
+                          << std::setprecision(1);
+            } else {
+                std::cout << std::setw(8) << "-";
+            }
+            std::cout << "\n";
+        }
+    }
+}
+
+//Offered Load Function: target vs sent vs processed rate. only printed for rate-driven producers, where
+//"sent" falling short of the target means the producers themselves could not keep to it
+void print_offered_load(const SimulationSettings& settings, const RunStats& stats) {
+    const OrderFlowProfile& flow = settings.flow;
+    if (flow.rate <= 0.0) {
+        return;
+    }
+    double seconds = static_cast<double>(settings.duration_seconds);
+    double target = flow.rate * settings.num_producers;
+    double sent = std::accumulate(stats.sent.begin(), stats.sent.end(), uint64_t{0}) / seconds;
+    double processed = stats.throughput.in_window() / seconds;
+    std::cout << "\n--- Offered Load (" << to_string(flow.pacing);
+    if (flow.pacing == Pacing::OPEN_LOOP) {
+        std::cout << ", " << to_string(flow.arrival) << " arrivals";
+    }
+    if (flow.burst_size > 1) {
+        std::cout << ", bursts of " << flow.burst_size;
+    }
+    std::cout << ") ---\n";
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Target:    " << static_cast<uint64_t>(target) << " orders/s\n";
+    std::cout << "Sent:      " << static_cast<uint64_t>(sent) << " orders/s (" << 100.0 * sent / target
+              << "% of target)\n";
+    std::cout << "Processed: " << static_cast<uint64_t>(processed) << " orders/s (" << 100.0 * processed / target
+              << "% of target)\n";
+}
+
+//runs one simulation and prints or summarises it. every shard brings its own arena, so only the
+//aggregated results are allocated here
+RunSummary execute(const SimulationSettings& settings) {
+    RunStats stats(settings);
+    switch (settings.transport_backend) {
+        case TransportBackend::QUEUE:
+            run_with_transport<QueueTransport>(settings, stats);
+            break;
+        case TransportBackend::TOKEN_QUEUE:
+            run_with_transport<TokenQueueTransport>(settings, stats);
+            break;
+        case TransportBackend::SPSC_RINGS:
+            run_with_transport<SpscRingTransport>(settings, stats);
+            break;
+    }
+    if (settings.verbose) {
+        print_lifecycle(settings, stats);
+        print_offered_load(settings, stats);
+        print_latency_stats(stats.latencies.totals(), stats.latencies.is_open_loop());
+        print_latency_breakdown(settings, stats.latencies);
+        print_depth_stats(settings, stats.depth);
+        if (settings.execution_reports) {
+            print_round_trips(settings, stats);
+        }
+        if (settings.l2_feed) {
+            print_feed_stats(settings, stats);
+        }
+        if (!settings.ingress_shm.empty()) {
+            print_ingress_stats(settings, stats);
+        }
+        if (settings.net_ingress != NetProtocol::NONE) {
+            print_network_stats(settings, stats);
+        }
+        if (settings.risk_mode != RiskMode::OFF) {
+            print_risk_stats(settings, stats);
+        }
+        if (!settings.journal_path.empty()) {
+            print_journal_stats(settings, stats);
+        }
+        if (stats.perf) {
+            print_perf_profile(settings, *stats.perf);
+        }
+        print_wait_stats(settings, stats.wait_stats);
+    }
+    const LatencyHistogram& totals = stats.latencies.totals();
+    return RunSummary{stats.throughput.in_window(), static_cast<double>(settings.duration_seconds),
+                      totals.value_at_percentile(50.0), totals.value_at_percentile(99.0),
+                      totals.value_at_percentile(99.9), totals.max(),
+                      std::accumulate(stats.sent.begin(), stats.sent.end(), uint64_t{0}),
+                      stats.depth.mean_resting(), stats.depth.mean_levels(), stats.depth.recentres};
+}
+
+//Replay Function: walks a mapped capture on this thread and feeds every order straight to its book,
+//either as fast as the book allows or at the consume times it was recorded with.
+//matching latency is per process_order call, schedule lag is how late a paced order was started
+template <typename Book>
+RunSummary run_replay(const SimulationSettings& settings) {
+    MappedCapture capture(settings.replay_path);
+    if (!capture.ok()) {
+        std::cerr << "Replay: " << capture.error() << "\n";
+        return RunSummary{};
+    }
+    size_t num_symbols = std::max<size_t>(capture.num_symbols(), 1);
+    Arena arena(num_symbols * Book::arena_bytes(settings.limits) + 2 * Arena::reserve_for(sizeof(LatencyHistogram)));
+    auto* matching = new (arena.allocate(sizeof(LatencyHistogram))) LatencyHistogram();
+    auto* lag = new (arena.allocate(sizeof(LatencyHistogram))) LatencyHistogram();
+    const CaptureRecord* records = capture.records();
+    std::vector<Price> centres = recorded_centres(records, capture.size(), num_symbols, settings.flow.mid_price,
+                                                  [](const CaptureRecord&) { return true; });
+    std::vector<std::unique_ptr<Book>> books(num_symbols);
+    for (size_t symbol = 0; symbol < num_symbols; ++symbol) {
+        books[symbol] = make_book<Book>(arena, settings.limits, nullptr, centres[symbol]);
+    }
+    std::cout << "Replaying " << capture.size() << " orders from " << settings.replay_path << " ("
+              << (settings.replay_pace == ReplayPace::RECORDED ? "recorded pace" : "full speed") << ", "
+              << Book::NAME << " book)\n";
+    uint64_t skipped = 0;
+    Timestamp start = SimClock::now();
+    for (uint64_t i = 0; i < capture.size(); ++i) {
+        Order order = records[i].order;
+        if (order.symbol >= books.size()) {
+            ++skipped;
+            continue;
+        }
+        if (settings.replay_pace == ReplayPace::RECORDED) {
+            Timestamp due = start + SimClock::ticks_from_ns(static_cast<long long>(records[i].offset_ns));
+            while (SimClock::now() < due) {
+                cpu_relax();
+            }
+            lag->record_ns(SimClock::elapsed_ns(due, SimClock::now()));
+        }
+        Timestamp begin = SimClock::now();
+        books[order.symbol]->process_order(order);
+        matching->record_ns(SimClock::elapsed_ns(begin, SimClock::now_serialized()));
+    }
+    double seconds = static_cast<double>(SimClock::elapsed_ns(start, SimClock::now())) / 1e9;
+    std::cout << "\n--- Replay ---\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Orders: " << matching->count() << " in " << seconds << " s ("
+              << static_cast<uint64_t>(matching->count() / seconds) << " orders/s)";
+    if (skipped > 0) {
+        std::cout << ", " << skipped << " skipped (symbol outside the capture's universe)";
+    }
+    std::cout << "\n";
+    std::cout << std::left << std::setw(22) << "(us)" << std::right << std::setw(10) << "count"
+              << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9"
+              << std::setw(11) << "max" << "\n";
+    print_breakdown_row("matching", *matching);
+    if (settings.replay_pace == ReplayPace::RECORDED) {
+        print_breakdown_row("schedule lag", *lag);
+    }
+    //the same capture always ends in the same books, so this doubles as a determinism check
+    std::cout << "\n--- FINAL ---" << std::endl;
+    for (size_t symbol = 0; symbol < books.size(); ++symbol) {
+        if (books.size() > 1) {
+            std::cout << "Symbol " << symbol << "\n";
+        }
+        books[symbol]->print_top_of_book();
+        std::cout << "Resting orders: " << books[symbol]->resting_orders() << "\n";
+    }
+    return RunSummary{matching->count(), seconds, matching->value_at_percentile(50.0),
+                      matching->value_at_percentile(99.0), matching->value_at_percentile(99.9), matching->max()};
+}
+
+//Recovery Function: rebuilds the books of one shard's journal from its last complete snapshot plus the orders
+//journaled after it, timing each phase. the rebuilt books' fills are checked against the journaled trades
+template <typename Book>
+void run_recovery(const SimulationSettings& settings) {
+    MappedJournal journal(settings.recover_journal);
+    if (!journal.ok()) {
+        std::cerr << "Recovery: " << journal.error() << "\n";
+        return;
+    }
+    size_t num_symbols = std::max<size_t>(journal.num_symbols(), 1);
+    Arena arena(num_symbols * Book::arena_bytes(settings.limits));
+    ExecutionReporter reports(arena, 0, 0); //no rings, only counts the fills
+    const JournalRecord* records = journal.records();
+    const uint64_t count = journal.size();
+    std::vector<Price> centres = recorded_centres(records, count, num_symbols, settings.flow.mid_price,
+        [](const JournalRecord& record) {
+            return record.kind == JournalEvent::ORDER || record.kind == JournalEvent::SNAPSHOT_ORDER;
+        });
+    std::vector<std::unique_ptr<Book>> books(num_symbols);
+    for (size_t symbol = 0; symbol < num_symbols; ++symbol) {
+        books[symbol] = make_book<Book>(arena, settings.limits, &reports, centres[symbol]);
+    }
+    //the last complete snapshot: the last SNAPSHOT_END and the SNAPSHOT_BEGIN before it
+    uint64_t begin = count;
+    uint64_t end = count;
+    for (uint64_t i = count; i-- > 0;) {
+        if (end == count) {
+            if (records[i].kind == JournalEvent::SNAPSHOT_END) {
+                end = i;
+            }
+        } else if (records[i].kind == JournalEvent::SNAPSHOT_BEGIN) {
+            begin = i;
+            break;
+        }
+    }
+    std::cout << "Recovering " << count << " journal records from " << settings.recover_journal << " ("
+              << Book::NAME << " book)\n";
+    uint64_t loaded = 0;
+    uint64_t replay_from = 0;
+    Timestamp start = SimClock::now();
+    if (begin < count) {
+        for (uint64_t i = begin + 1; i < end; ++i) {
+            Order order = records[i].order;
+            if (order.symbol < books.size()) {
+                books[order.symbol]->process_order(order);
+                ++loaded;
+            }
+        }
+        replay_from = end + 1;
+    }
+    Timestamp snapshot_loaded = SimClock::now();
+    uint64_t replayed = 0;
+    uint64_t journaled_trades = 0;
+    for (uint64_t i = replay_from; i < count; ++i) {
+        if (records[i].kind == JournalEvent::ORDER && records[i].order.symbol < books.size()) {
+            Order order = records[i].order;
+            books[order.symbol]->process_order(order);
+            ++replayed;
+        } else if (records[i].kind == JournalEvent::TRADE) {
+            ++journaled_trades;
+        }
+    }
+    Timestamp replay_done = SimClock::now();
+    double load_seconds = static_cast<double>(SimClock::elapsed_ns(start, snapshot_loaded)) / 1e9;
+    double replay_seconds = static_cast<double>(SimClock::elapsed_ns(snapshot_loaded, replay_done)) / 1e9;
+    std::cout << "\n--- Recovery ---\n" << std::fixed << std::setprecision(2);
+    std::cout << "Journal: " << count << " records in the durable prefix, " << journal.discarded_bytes()
+              << " bytes after it discarded\n";
+    if (begin < count) {
+        std::cout << "Snapshot: sequence " << begin << ", " << loaded << " resting orders loaded in "
+                  << load_seconds * 1000.0 << " ms ("
+                  << static_cast<uint64_t>(load_seconds > 0.0 ? loaded / load_seconds : 0.0) << " orders/s)\n";
+    } else {
+        std::cout << "Snapshot: none complete, replaying from the first record\n";
+    }
+    std::cout << "Replay: " << replayed << " orders in " << replay_seconds * 1000.0 << " ms ("
+              << static_cast<uint64_t>(replay_seconds > 0.0 ? replayed / replay_seconds : 0.0) << " orders/s), "
+              << reports.fills() << " fills against " << journaled_trades << " journaled trades ("
+              << (reports.fills() == journaled_trades ? "match" : "MISMATCH") << ")\n";
+    std::cout << "Rebuilt in " << (load_seconds + replay_seconds) * 1000.0 << " ms\n";
+    std::cout << "\n--- FINAL ---" << std::endl;
+    for (size_t symbol = 0; symbol < books.size(); ++symbol) {
+        if (books.size() > 1) {
+            std::cout << "Symbol " << symbol << "\n";
+        }
+        books[symbol]->print_top_of_book();
+        std::cout << "Resting orders: " << books[symbol]->resting_orders() << "\n";
+    }
+}
+
+//a single run, or one setting swept over several values
+struct Scenario {
+    SimulationSettings settings;
+    std::string sweep;                     //key of the setting to sweep, "" = single run
+    std::vector<std::string> sweep_values;
+    int sweep_seconds;                     //length of each sweep point
+    std::string sweep_by;                  //second setting, every sweep value is run at each of its values
+    std::vector<std::string> sweep_by_values;
+};
+
+//every setting a scenario file or --key=value can change, named after the constants in main()
+const std::vector<ConfigKey<Scenario>>& scenario_keys() {
+    using S = Scenario;
+    const std::initializer_list<std::pair<const char*, WaitStrategy>> waits = {
+        {"spin", WaitStrategy::SPIN}, {"spin_yield", WaitStrategy::SPIN_YIELD},
+        {"spin_park", WaitStrategy::SPIN_PARK}, {"blocking", WaitStrategy::BLOCKING}};
+    const std::initializer_list<std::pair<const char*, NetProtocol>> protocols = {
+        {"none", NetProtocol::NONE}, {"udp", NetProtocol::UDP}, {"tcp", NetProtocol::TCP}};
+    const std::initializer_list<std::pair<const char*, JournalSync>> journal_syncs = {
+        {"none", JournalSync::NONE}, {"batch", JournalSync::BATCH}, {"interval", JournalSync::INTERVAL}};
+    const std::initializer_list<std::pair<const char*, RiskMode>> risk_modes = {
+        {"off", RiskMode::OFF}, {"inline", RiskMode::INLINE}, {"pipelined", RiskMode::PIPELINED}};
+    const std::initializer_list<std::pair<const char*, PerfBucket>> perf_buckets = {
+        {"matching", PerfBucket::MATCHING}, {"end_to_end", PerfBucket::END_TO_END}};
+    static const std::vector<ConfigKey<S>> keys = {
+        config_key<S>("num_producers", "producer threads (1-256)",
+                      [](S& s) -> auto& { return s.settings.num_producers; }),
+        config_key<S>("duration_seconds", "length of a single run's measurement window",
+                      [](S& s) -> auto& { return s.settings.duration_seconds; }),
+        config_key<S>("warmup_seconds", "flow run before measuring starts, not reported, 0 = none",
+                      [](S& s) -> auto& { return s.settings.warmup_seconds; }),
+        config_key<S>("lock_memory", "true | false, mlockall before the run",
+                      [](S& s) -> auto& { return s.settings.lock_memory; }),
+        config_choice<S>("book_backend", "map | ladder",
+                         [](S& s) -> auto& { return s.settings.book_backend; },
+                         {{"map", BookBackend::MAP}, {"ladder", BookBackend::LADDER}}),
+        config_choice<S>("transport_backend", "queue | token_queue | spsc_rings",
+                         [](S& s) -> auto& { return s.settings.transport_backend; },
+                         {{"queue", TransportBackend::QUEUE}, {"token_queue", TransportBackend::TOKEN_QUEUE},
+                          {"spsc_rings", TransportBackend::SPSC_RINGS}}),
+        config_key<S>("num_symbols", "symbol universe (1-65536)",
+                      [](S& s) -> auto& { return s.settings.num_symbols; }),
+        config_key<S>("num_shards", "engine threads", [](S& s) -> auto& { return s.settings.num_shards; }),
+        config_key<S>("execution_reports", "true | false",
+                      [](S& s) -> auto& { return s.settings.execution_reports; }),
+        config_key<S>("seed", "producer seed, 0 = random", [](S& s) -> auto& { return s.settings.seed; }),
+        config_key<S>("capture_path", "write dequeued orders here",
+                      [](S& s) -> auto& { return s.settings.capture_path; }),
+        config_key<S>("replay_path", "replay this capture instead of running producers",
+                      [](S& s) -> auto& { return s.settings.replay_path; }),
+        config_choice<S>("replay_pace", "full_speed | recorded",
+                         [](S& s) -> auto& { return s.settings.replay_pace; },
+                         {{"full_speed", ReplayPace::FULL_SPEED}, {"recorded", ReplayPace::RECORDED}}),
+        config_key<S>("transport_capacity", "per-producer ring size or queue capacity",
+                      [](S& s) -> auto& { return s.settings.transport_capacity; }),
+        config_key<S>("batch_size", "orders drained per poll", [](S& s) -> auto& { return s.settings.batch_size; }),
+        config_key<S>("sample_every", "per-order timestamps every Nth order in batch mode",
+                      [](S& s) -> auto& { return s.settings.sample_every; }),
+        config_choice<S>("engine_wait", "spin | spin_yield | spin_park | blocking",
+                         [](S& s) -> auto& { return s.settings.engine_wait; }, waits),
+        config_choice<S>("producer_wait", "spin | spin_yield | spin_park",
+                         [](S& s) -> auto& { return s.settings.producer_wait; }, waits),
+        config_key<S>("wait_spin_limit", "empty polls before yielding or parking",
+                      [](S& s) -> auto& { return s.settings.spin_limit; }),
+        config_key<S>("producer_gap", "pause between orders when rate is 0, e.g. 10us",
+                      [](S& s) -> auto& { return s.settings.producer_gap; }),
+        config_key<S>("producer_spin_window", "spin_park producers spin this end of a gap, e.g. 80us",
+                      [](S& s) -> auto& { return s.settings.producer_spin_window; }),
+        config_key<S>("engine_cores", "comma separated, one per shard",
+                      [](S& s) -> auto& { return s.settings.placement.engine_cores; }),
+        config_key<S>("producer_cores", "comma separated",
+                      [](S& s) -> auto& { return s.settings.placement.producer_cores; }),
+        config_key<S>("engine_realtime_priority", "SCHED_FIFO 1-99, 0 = normal",
+                      [](S& s) -> auto& { return s.settings.placement.realtime_priority; }),
+        config_key<S>("numa_local_memory", "true | false",
+                      [](S& s) -> auto& { return s.settings.placement.numa_local; }),
+        config_key<S>("max_resting_orders", "per symbol", [](S& s) -> auto& { return s.settings.limits.max_orders; }),
+        config_key<S>("max_price_levels", "per symbol", [](S& s) -> auto& { return s.settings.limits.max_levels; }),
+        config_key<S>("max_ladder_window", "ticks the ladder window may grow to, per symbol",
+                      [](S& s) -> auto& { return s.settings.limits.max_window; }),
+        config_choice<S>("pool_policy", "reject | heap_fallback | abort",
+                         [](S& s) -> auto& { return s.settings.limits.policy; },
+                         {{"reject", ExhaustionPolicy::REJECT}, {"heap_fallback", ExhaustionPolicy::HEAP_FALLBACK},
+                          {"abort", ExhaustionPolicy::ABORT}}),
+        config_key<S>("report_interval", "interval report period, e.g. 1000ms",
+                      [](S& s) -> auto& { return s.settings.report_interval; }),
+        config_key<S>("rate", "orders/s per producer, 0 = one per producer_gap",
+                      [](S& s) -> auto& { return s.settings.flow.rate; }),
+        config_key<S>("mid_price", "centre of the price distribution",
+                      [](S& s) -> auto& { return s.settings.flow.mid_price; }),
+        config_choice<S>("price_distribution", "uniform | normal",
+                         [](S& s) -> auto& { return s.settings.flow.price_distribution; },
+                         {{"uniform", PriceDistribution::UNIFORM}, {"normal", PriceDistribution::NORMAL}}),
+        config_key<S>("price_range", "ticks either side of mid_price",
+                      [](S& s) -> auto& { return s.settings.flow.price_range; }),
+        config_key<S>("price_stddev", "ticks, normal prices only",
+                      [](S& s) -> auto& { return s.settings.flow.price_stddev; }),
+        config_choice<S>("quantity_distribution", "uniform | geometric",
+                         [](S& s) -> auto& { return s.settings.flow.quantity_distribution; },
+                         {{"uniform", QuantityDistribution::UNIFORM},
+                          {"geometric", QuantityDistribution::GEOMETRIC}}),
+        config_key<S>("min_quantity", "smallest order", [](S& s) -> auto& { return s.settings.flow.min_quantity; }),
+        config_key<S>("max_quantity", "largest order", [](S& s) -> auto& { return s.settings.flow.max_quantity; }),
+        config_key<S>("mean_quantity", "average order, geometric only",
+                      [](S& s) -> auto& { return s.settings.flow.mean_quantity; }),
+        config_key<S>("buy_percent", "share of new orders that buy",
+                      [](S& s) -> auto& { return s.settings.flow.buy_percent; }),
+        config_key<S>("cancel_percent", "share of messages that cancel",
+                      [](S& s) -> auto& { return s.settings.flow.cancel_percent; }),
+        config_key<S>("modify_percent", "share of messages that modify",
+                      [](S& s) -> auto& { return s.settings.flow.modify_percent; }),
+        config_key<S>("market_percent", "share of new orders sent as market orders",
+                      [](S& s) -> auto& { return s.settings.flow.market_percent; }),
+        config_key<S>("ioc_percent", "share of new orders sent immediate-or-cancel",
+                      [](S& s) -> auto& { return s.settings.flow.ioc_percent; }),
+        config_key<S>("fok_percent", "share of new orders sent fill-or-kill",
+                      [](S& s) -> auto& { return s.settings.flow.fok_percent; }),
+        config_key<S>("post_only_percent", "share of new orders sent post-only",
+                      [](S& s) -> auto& { return s.settings.flow.post_only_percent; }),
+        config_key<S>("burst_size", "orders sent back to back, 1 = evenly paced",
+                      [](S& s) -> auto& { return s.settings.flow.burst_size; }),
+        config_key<S>("build_up_orders", "new orders on one side before a sweep of the other, 0 = off",
+                      [](S& s) -> auto& { return s.settings.flow.build_up_orders; }),
+        config_key<S>("trend", "ticks the mid moves per 1000 new orders per producer, e.g. 5 or -2",
+                      [](S& s) -> auto& { return s.settings.flow.trend; }),
+        config_choice<S>("pacing", "closed_loop | open_loop",
+                         [](S& s) -> auto& { return s.settings.flow.pacing; },
+                         {{"closed_loop", Pacing::CLOSED_LOOP}, {"open_loop", Pacing::OPEN_LOOP}}),
+        config_choice<S>("arrival", "constant | poisson, open loop only",
+                         [](S& s) -> auto& { return s.settings.flow.arrival; },
+                         {{"constant", ArrivalProcess::CONSTANT}, {"poisson", ArrivalProcess::POISSON}}),
+        config_key<S>("snapshot_depth", "book levels per side published after each batch, 0 = off",
+                      [](S& s) -> auto& { return s.settings.snapshot_depth; }),
+        config_key<S>("market_data_shm", "shared memory name for the snapshots, e.g. /llsim_md",
+                      [](S& s) -> auto& { return s.settings.market_data_shm; }),
+        config_key<S>("monitor_shm", "watch the snapshots another run publishes there instead of simulating",
+                      [](S& s) -> auto& { return s.settings.monitor_shm; }),
+        config_key<S>("l2_feed", "true | false, stream level changes to a feed thread",
+                      [](S& s) -> auto& { return s.settings.l2_feed; }),
+        config_key<S>("feed_conflation", "window merging updates to one level, e.g. 100us, 0 = none",
+                      [](S& s) -> auto& { return s.settings.feed_conflation; }),
+        config_key<S>("ingress_shm", "shared memory name client processes send orders to, e.g. /llsim_in",
+                      [](S& s) -> auto& { return s.settings.ingress_shm; }),
+        config_key<S>("ingress_clients", "client slots in the ingress segment",
+                      [](S& s) -> auto& { return s.settings.ingress_clients; }),
+        config_key<S>("client_shm", "send orders to the ingress another run opened there instead of simulating",
+                      [](S& s) -> auto& { return s.settings.client_shm; }),
+        config_choice<S>("net_ingress", "none | udp | tcp, socket the network ingress listens on",
+                         [](S& s) -> auto& { return s.settings.net_ingress; }, protocols),
+        config_key<S>("net_address", "IPv4 address the ingress binds to or the load client sends to",
+                      [](S& s) -> auto& { return s.settings.net_address; }),
+        config_key<S>("net_port", "port of the network ingress", [](S& s) -> auto& { return s.settings.net_port; }),
+        config_key<S>("net_recv_batch", "datagrams per recvmmsg call",
+                      [](S& s) -> auto& { return s.settings.net_recv_batch; }),
+        config_choice<S>("net_client", "none | udp | tcp, send orders to another run's network ingress",
+                         [](S& s) -> auto& { return s.settings.net_client; }, protocols),
+        config_key<S>("net_send_batch", "orders per datagram or write from the load client",
+                      [](S& s) -> auto& { return s.settings.net_send_batch; }),
+        config_choice<S>("risk_mode", "off | inline | pipelined, where the pre-trade checks run",
+                         [](S& s) -> auto& { return s.settings.risk_mode; }, risk_modes),
+        config_key<S>("risk_max_quantity", "largest new or modified quantity, 0 = unchecked",
+                      [](S& s) -> auto& { return s.settings.risk_limits.max_quantity; }),
+        config_key<S>("risk_collar_ticks", "furthest a limit price may be from the mid, 0 = unchecked",
+                      [](S& s) -> auto& { return s.settings.risk_limits.collar_ticks; }),
+        config_key<S>("risk_max_position", "net accepted quantity per client and symbol, 0 = unchecked",
+                      [](S& s) -> auto& { return s.settings.risk_limits.max_position; }),
+        config_key<S>("risk_max_rate", "messages/s per client, 0 = unchecked",
+                      [](S& s) -> auto& { return s.settings.risk_limits.max_rate; }),
+        config_key<S>("risk_rate_burst", "messages a client may send back to back under the rate limit",
+                      [](S& s) -> auto& { return s.settings.risk_limits.rate_burst; }),
+        config_key<S>("journal_path", "journal accepted orders and trades here, e.g. /tmp/llsim.journal",
+                      [](S& s) -> auto& { return s.settings.journal_path; }),
+        config_choice<S>("journal_sync", "none | batch | interval, when the journal is made durable",
+                         [](S& s) -> auto& { return s.settings.journal_sync; }, journal_syncs),
+        config_key<S>("journal_commit_interval", "most time between journal syncs, e.g. 1000us, interval only",
+                      [](S& s) -> auto& { return s.settings.journal_commit_interval; }),
+        config_key<S>("journal_direct", "true | false, open the journal O_DIRECT",
+                      [](S& s) -> auto& { return s.settings.journal_direct; }),
+        config_key<S>("journal_ring", "journal records the engine may be ahead of the writer",
+                      [](S& s) -> auto& { return s.settings.journal_ring; }),
+        config_key<S>("journal_snapshot_every", "accepted orders between book snapshots in the journal, 0 = none",
+                      [](S& s) -> auto& { return s.settings.journal_snapshot_every; }),
+        config_key<S>("recover_journal", "rebuild the books from this journal instead of simulating",
+                      [](S& s) -> auto& { return s.settings.recover_journal; }),
+        config_key<S>("perf_sample_every", "read hardware counters around every Nth order, 0 = off",
+                      [](S& s) -> auto& { return s.settings.perf_sample_every; }),
+        config_choice<S>("perf_bucket", "matching | end_to_end, latency the counter samples are grouped by",
+                         [](S& s) -> auto& { return s.settings.perf_bucket; }, perf_buckets),
+        config_key<S>("sweep", "setting to sweep, e.g. rate or batch_size", [](S& s) -> auto& { return s.sweep; }),
+        config_key<S>("sweep_values", "comma separated values for the swept setting",
+                      [](S& s) -> auto& { return s.sweep_values; }),
+        config_key<S>("sweep_seconds", "length of each sweep point", [](S& s) -> auto& { return s.sweep_seconds; }),
+        config_key<S>("sweep_by", "second setting to sweep across, e.g. num_producers",
+                      [](S& s) -> auto& { return s.sweep_by; }),
+        config_key<S>("sweep_by_values", "comma separated values for sweep_by",
+                      [](S& s) -> auto& { return s.sweep_by_values; }),
+    };
+    return keys;
+}
+
+//"" when the scenario can run, otherwise what is wrong with it
+std::string validate_scenario(const Scenario& scenario) {
+    //a grid is checked as one sweep per sweep_by value
+    if (!scenario.sweep_by.empty()) {
+        if (scenario.sweep.empty() || scenario.sweep_by_values.empty()) {
+            return "sweep_by " + scenario.sweep_by + " needs a sweep and sweep_by_values";
+        }
+        if (scenario.sweep_by.compare(0, 5, "sweep") == 0 || scenario.sweep_by == scenario.sweep) {
+            return "cannot sweep by " + scenario.sweep_by;
+        }
+        for (const std::string& value : scenario.sweep_by_values) {
+            Scenario row = scenario;
+            row.sweep_by.clear();
+            std::string error;
+            if (!apply_config_entry(scenario_keys(), row, ConfigEntry{scenario.sweep_by, value, "sweep_by_values"},
+                                    error)) {
+                return error;
+            }
+            error = validate_scenario(row);
+            if (!error.empty()) {
+                return scenario.sweep_by + " = " + value + ": " + error;
+            }
+        }
+        return "";
+    }
+    //a sweep is checked point by point, the base settings alone may be incomplete (a rate sweep's rate)
+    if (!scenario.sweep.empty()) {
+        if (scenario.sweep_values.empty()) {
+            return "sweep " + scenario.sweep + " has no sweep_values";
+        }
+        if (scenario.sweep.compare(0, 5, "sweep") == 0) {
+            return "cannot sweep " + scenario.sweep;
+        }
+        for (const std::string& value : scenario.sweep_values) {
+            Scenario point = scenario;
+            point.sweep.clear();
+            std::string error;
+            if (!apply_config_entry(scenario_keys(), point, ConfigEntry{scenario.sweep, value, "sweep_values"}, error)) {
+                return error;
+            }
+            error = validate_scenario(point);
+            if (!error.empty()) {
+                return "sweep point " + scenario.sweep + " = " + value + ": " + error;
+            }
+        }
+        return "";
+    }
+    const SimulationSettings& settings = scenario.settings;
+    if (settings.num_producers < 1 || settings.num_producers > static_cast<int>(MAX_PRODUCERS)) {
+        return "num_producers must be 1-" + std::to_string(MAX_PRODUCERS) + " (Order::producer_id is 8 bits)";
+    }
+    if (settings.duration_seconds < 1 || scenario.sweep_seconds < 1 || settings.warmup_seconds < 0) {
+        return "duration_seconds and sweep_seconds must be at least 1, warmup_seconds not negative";
+    }
+    if (settings.num_symbols < 1 || settings.num_symbols > size_t(std::numeric_limits<SymbolID>::max()) + 1) {
+        return "num_symbols must be 1-65536";
+    }
+    if (settings.num_shards < 1 || settings.batch_size < 1 || settings.transport_capacity < 1) {
+        return "num_shards, batch_size and transport_capacity must be at least 1";
+    }
+    if (settings.producer_wait == WaitStrategy::BLOCKING) {
+        return "producer_wait cannot be blocking, nothing posts a producer (spin, spin_yield or spin_park)";
+    }
+    if (settings.producer_spin_window.count() < 0) {
+        return "producer_spin_window must not be negative";
+    }
+    if (settings.limits.max_window < settings.limits.max_levels) {
+        return "max_ladder_window must be at least max_price_levels";
+    }
+    if (settings.snapshot_depth > MAX_SNAPSHOT_DEPTH) {
+        return "snapshot_depth must be at most " + std::to_string(MAX_SNAPSHOT_DEPTH);
+    }
+    if (!settings.ingress_shm.empty()
+        && (settings.ingress_clients < 1 || producer_lanes(settings) > MAX_PRODUCERS)) {
+        return "ingress_clients must be 1-" + std::to_string(MAX_PRODUCERS - first_client_lane(settings))
+               + " (each client is a producer lane after the producer threads)";
+    }
+    if (producer_lanes(settings) > MAX_PRODUCERS) {
+        return "num_producers must leave a producer lane for the network ingress";
+    }
+    if (settings.net_recv_batch < 1 || settings.net_send_batch < 1
+        || settings.net_send_batch > MAX_DATAGRAM / WIRE_ORDER_SIZE) {
+        return "net_recv_batch must be at least 1 and net_send_batch 1-" + std::to_string(MAX_DATAGRAM / WIRE_ORDER_SIZE);
+    }
+    const RiskLimits& risk = settings.risk_limits;
+    if (risk.max_quantity < 0 || risk.collar_ticks < 0 || risk.max_position < 0 || risk.max_rate < 0.0
+        || risk.rate_burst < 1.0) {
+        return "risk limits must not be negative and risk_rate_burst must be at least 1";
+    }
+    if (settings.risk_mode == RiskMode::PIPELINED && risk.collar_ticks > 0 && settings.snapshot_depth == 0) {
+        return "a pipelined price collar needs snapshot_depth > 0, the risk thread reads the published top of book";
+    }
+    if (settings.journal_ring < 1
+        || (settings.journal_sync == JournalSync::INTERVAL && settings.journal_commit_interval.count() <= 0)) {
+        return "journal_ring must be at least 1 and journal_commit_interval above 0 with interval syncs";
+    }
+    return settings.flow.validate();
+}
+
+//one line describing what the producers send
+std::string describe_flow(const SimulationSettings& settings) {
+    const OrderFlowProfile& flow = settings.flow;
+    std::ostringstream line;
+    line << to_string(flow.price_distribution) << " prices " << flow.mid_price - flow.price_range << "-"
+         << flow.mid_price + flow.price_range << ", " << to_string(flow.quantity_distribution) << " "
+         << flow.min_quantity << "-" << flow.max_quantity << " lots, " << flow.buy_percent << "% buys, "
+         << flow.cancel_percent << "% cancels, " << flow.modify_percent << "% modifies, ";
+    if (flow.non_limit_percent() > 0) {
+        line << "new orders " << flow.market_percent << "% market, " << flow.ioc_percent << "% ioc, "
+             << flow.fok_percent << "% fok, " << flow.post_only_percent << "% post-only, ";
+    }
+    if (flow.pacing == Pacing::OPEN_LOOP) {
+        line << static_cast<uint64_t>(flow.rate) << " orders/s per producer open loop, " << to_string(flow.arrival)
+             << " arrivals";
+    } else if (flow.rate > 0.0) {
+        line << static_cast<uint64_t>(flow.rate) << " orders/s per producer";
+    } else {
+        line << "one order per " << settings.producer_gap.count() / 1000.0 << "us per producer";
+    }
+    if (flow.burst_size > 1) {
+        line << " in bursts of " << flow.burst_size;
+    }
+    if (flow.build_up_orders > 0) {
+        line << ", one-sided build-ups of " << flow.build_up_orders << " orders swept from the other side";
+    }
+    if (flow.trend != 0.0) {
+        line << ", mid trending " << flow.trend << " ticks per 1000 orders";
+    }
+    return line.str();
+}
+
+//Sweep Function: reruns the simulation once per value of one setting and tabulates throughput, the book depth
+//the orders met and latency. with sweep_by the whole sweep is repeated for each of a second setting's values,
+//e.g. book depth against producer count. when the producers are rate driven the offered load is shown too,
+//and the first point of each row where the engine falls clearly behind it is reported as the saturation point
+void run_sweep(const Scenario& scenario) {
+    struct Point {
+        std::string value;
+        std::string by_value; //"" without sweep_by
+        double offered; //orders/s asked for, 0 when producers are gap driven
+        RunSummary summary;
+    };
+    std::vector<Point> results;
+    bool rate_driven = false;
+    bool ladder = false;
+    const bool grid = !scenario.sweep_by.empty();
+    const std::vector<std::string> rows = grid ? scenario.sweep_by_values : std::vector<std::string>{""};
+    for (const std::string& by_value : rows) {
+        for (const std::string& value : scenario.sweep_values) {
+            Scenario point = scenario;
+            std::string error;
+            if (grid) {
+                apply_config_entry(scenario_keys(), point, ConfigEntry{scenario.sweep_by, by_value, "sweep_by_values"},
+                                   error);
+            }
+            apply_config_entry(scenario_keys(), point, ConfigEntry{scenario.sweep, value, "sweep_values"}, error);
+            SimulationSettings& settings = point.settings;
+            settings.verbose = false;
+            settings.duration_seconds = scenario.sweep_seconds;
+            double offered = settings.flow.rate * settings.num_producers;
+            rate_driven |= offered > 0.0;
+            ladder |= settings.book_backend == BookBackend::LADDER;
+            std::cout << "Sweep: " << scenario.sweep << " " << value;
+            if (grid) {
+                std::cout << ", " << scenario.sweep_by << " " << by_value;
+            }
+            std::cout << "...\n";
+            results.push_back(Point{value, by_value, offered, execute(settings)});
+        }
+    }
+    int width = static_cast<int>(std::max<size_t>(scenario.sweep.size(), 6)) + 2;
+    int by_width = static_cast<int>(std::max<size_t>(scenario.sweep_by.size(), 6)) + 2;
+    bool open_loop = scenario.settings.flow.pacing == Pacing::OPEN_LOOP;
+    std::cout << "\n--- Sweep of " << scenario.sweep << (grid ? " by " + scenario.sweep_by : "") << " (throughput vs "
+              << (open_loop ? "latency from intended send time" : "end-to-end latency") << ") ---\n";
+    std::cout << "resting / levels = mean resting orders / non-empty price levels of the book each sampled order met\n";
+    std::cout << std::fixed << std::setprecision(2);
+    if (grid) {
+        std::cout << std::setw(by_width) << scenario.sweep_by;
+    }
+    std::cout << std::setw(width) << scenario.sweep;
+    if (rate_driven) {
+        std::cout << std::setw(14) << "offered/s" << std::setw(14) << "sent/s";
+    }
+    //latency columns fit 100 s in us with two decimals, so a saturated point's queueing never runs them together
+    const int latency_width = 14;
+    std::cout << std::setw(14) << "orders/s" << std::setw(11) << "resting" << std::setw(11) << "levels";
+    if (ladder) {
+        std::cout << std::setw(12) << "recentres";
+    }
+    std::cout << std::setw(latency_width) << "p50 us" << std::setw(latency_width) << "p99 us"
+              << std::setw(latency_width) << "p99.9 us" << std::setw(latency_width) << "max us" << "\n";
+    //first saturated point of each sweep_by row
+    std::vector<const Point*> saturated(rows.size(), nullptr);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Point& point = results[i];
+        const RunSummary& r = point.summary;
+        double achieved = r.orders / r.seconds;
+        if (grid) {
+            std::cout << std::setw(by_width) << point.by_value;
+        }
+        std::cout << std::setw(width) << point.value;
+        if (rate_driven) {
+            std::cout << std::setw(14) << static_cast<uint64_t>(point.offered)
+                      << std::setw(14) << static_cast<uint64_t>(r.sent / r.seconds);
+        }
+        std::cout << std::setw(14) << static_cast<uint64_t>(achieved) << std::setprecision(0) << std::setw(11)
+                  << r.resting << std::setw(11) << r.levels << std::setprecision(2);
+        if (ladder) {
+            std::cout << std::setw(12) << r.recentres;
+        }
+        //a point so far behind schedule that nothing sent in the window was due in it has no latencies
+        if (r.max_ns == 0) {
+            std::cout << std::setw(latency_width) << "-" << std::setw(latency_width) << "-"
+                      << std::setw(latency_width) << "-" << std::setw(latency_width) << "-" << "\n";
+        } else {
+            std::cout << std::setw(latency_width) << r.p50_ns / 1000.0 << std::setw(latency_width) << r.p99_ns / 1000.0
+                      << std::setw(latency_width) << r.p999_ns / 1000.0 << std::setw(latency_width) << r.max_ns / 1000.0
+                      << "\n";
+        }
+        size_t row = i / scenario.sweep_values.size();
+        if (!saturated[row] && point.offered > 0.0 && achieved < SATURATION_SHARE * point.offered) {
+            saturated[row] = &point;
+        }
+    }
+    if (!rate_driven) {
+        return;
+    }
+    for (size_t row = 0; row < rows.size(); ++row) {
+        std::cout << "Saturation" << (grid ? " (" + scenario.sweep_by + " " + rows[row] + ")" : "") << ": ";
+        if (saturated[row]) {
+            std::cout << "first reached at " << scenario.sweep << " = " << saturated[row]->value
+                      << " (throughput below " << static_cast<int>(SATURATION_SHARE * 100) << "% of the offered load)\n";
+        } else {
+            std::cout << "not reached, every point kept up with at least "
+                      << static_cast<int>(SATURATION_SHARE * 100) << "% of the offered load\n";
+        }
+    }
+}
+
+//Monitor Function: attaches to another run's market data in shared memory and prints its first books
+//every report interval for the run length, the way an external reader would poll them
+int run_monitor(const SimulationSettings& settings) {
+    MarketDataReader reader(settings.monitor_shm);
+    if (!reader.ok()) {
+        std::cerr << "Monitor: " << reader.error() << "\n";
+        return 1;
+    }
+    std::cout << "Monitoring " << reader.num_symbols() << " symbol" << (reader.num_symbols() == 1 ? "" : "s")
+              << " at " << settings.monitor_shm << " (" << reader.depth() << " levels per side)\n";
+    size_t shown = std::min<size_t>(reader.num_symbols(), REPORTED_BOOKS);
+    std::vector<uint64_t> last_updates(shown, 0);
+    BookSnapshot snapshot;
+    for (size_t symbol = 0; symbol < shown; ++symbol) {
+        reader.read(static_cast<SymbolID>(symbol), snapshot);
+        last_updates[symbol] = snapshot.updates;
+    }
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(settings.duration_seconds);
+    double seconds = std::chrono::duration<double>(settings.report_interval).count();
+    for (int interval = 1; std::chrono::steady_clock::now() < end; ++interval) {
+        std::this_thread::sleep_for(settings.report_interval);
+        for (size_t symbol = 0; symbol < shown; ++symbol) {
+            reader.read(static_cast<SymbolID>(symbol), snapshot);
+            std::cout << std::fixed << std::setprecision(0) << "[monitor " << interval << " symbol " << symbol
+                      << "] " << describe_snapshot(snapshot) << ", "
+                      << (snapshot.updates - last_updates[symbol]) / seconds << " updates/s\n";
+            last_updates[symbol] = snapshot.updates;
+        }
+    }
+    return 0;
+}
+
+//Client Function: one external order source. attaches to another run's shared memory ingress, claims a client
+//slot and sends the configured order flow on it for the run length or until that engine stops. every order is
+//stamped with the shared clock before the push, so the engine's latency report covers the whole cross-process path
+int run_client(const SimulationSettings& settings) {
+    IngressClient client(settings.client_shm);
+    if (!client.ok()) {
+        std::cerr << "Client: " << client.error() << "\n";
+        return 1;
+    }
+    SimClock::calibrate();
+    std::cout << "Client " << client.index() << " of " << settings.client_shm << " trading " << client.num_symbols()
+              << " symbol" << (client.num_symbols() == 1 ? "" : "s") << ": " << describe_flow(settings) << "\n";
+    WaitStats wait_stats;
+    ProducerWaiter waiter(settings.producer_wait, settings.producer_spin_window, wait_stats);
+    OrderFlow flow(settings.flow, client.num_symbols(),
+                   (settings.seed != 0 ? settings.seed : std::random_device{}()) + MAX_PRODUCERS + client.index(),
+                   settings.producer_gap);
+    std::atomic<uint64_t> ids{client.first_order_id()};
+    uint32_t sequence = 0;
+    uint64_t sent = 0, retries = 0;
+    const bool open_loop = settings.flow.pacing == Pacing::OPEN_LOOP;
+    auto wall_start = std::chrono::steady_clock::now();
+    auto end = wall_start + std::chrono::seconds(settings.duration_seconds);
+    Timestamp schedule_start = SimClock::now();
+    IngressRecord record{};
+    while (!client.closed() && std::chrono::steady_clock::now() < end) {
+        Timestamp intended = 0;
+        if (open_loop) {
+            intended = flow.next_arrival(schedule_start);
+            long long ahead_ns = SimClock::elapsed_ns(SimClock::now(), intended);
+            if (ahead_ns > 0) {
+                waiter.pause(std::chrono::nanoseconds(ahead_ns), [] {});
+            }
+        }
+        record.order = Order{};
+        record.order.sequence = sequence++;
+        flow.next(record.order, ids);
+        record.produce = SimClock::now();
+        record.intended = open_loop ? intended : record.produce;
+        bool pushed = client.send(record);
+        while (!pushed && !client.closed()) {
+            ++retries;
+            waiter.backoff();
+            pushed = client.send(record);
+        }
+        sent += pushed ? 1 : 0;
+        if (!open_loop) {
+            std::chrono::nanoseconds gap = flow.pause();
+            if (gap.count() > 0) {
+                waiter.pause(gap, [] {});
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    std::cout << "Sent " << sent << " orders in " << std::fixed << std::setprecision(2) << seconds << " s ("
+              << static_cast<uint64_t>(sent / seconds) << " orders/s), " << retries << " full-ring retries"
+              << (client.closed() ? ", stopped by the engine" : "") << "\n";
+    return 0;
+}
+
+//Load Client Function: a network load generator. sends the configured order flow to another run's network
+//ingress for the run length, net_send_batch orders per datagram or write, each batch stamped with the shared
+//clock right before the send call. the final reports coming back carry the engine's emit time, which gives
+//wire -> match directly, and their arrival closes the round trip
+int run_net_client(const SimulationSettings& settings) {
+    NetLink link(settings.net_client, settings.net_address, settings.net_port);
+    if (!link.ok()) {
+        std::cerr << "Load client: " << link.error() << "\n";
+        return 1;
+    }
+    SimClock::calibrate();
+    std::cout << "Load client: " << to_string(settings.net_client) << " to " << settings.net_address << ":"
+              << settings.net_port << ", " << settings.net_send_batch << " order"
+              << (settings.net_send_batch == 1 ? "" : "s") << " per send: " << describe_flow(settings) << "\n";
+    WaitStats wait_stats;
+    ProducerWaiter waiter(settings.producer_wait, settings.producer_spin_window, wait_stats);
+    OrderFlow flow(settings.flow, settings.num_symbols,
+                   (settings.seed != 0 ? settings.seed : std::random_device{}()) + 2 * MAX_PRODUCERS,
+                   settings.producer_gap);
+    //clear of the producer threads' ids and of every shared memory client's
+    std::atomic<uint64_t> ids{(OrderID(1) << 62) + (static_cast<OrderID>(::getpid()) << 32)};
+    LatencyHistogram wire_to_match;
+    LatencyHistogram round_trip;
+    uint64_t reports = 0;
+    auto collect = [&] {
+        while (link.receive([&](const WireReport& report) {
+            wire_to_match.record_ns(SimClock::elapsed_ns(report.sent, report.emitted));
+            round_trip.record_ns(SimClock::elapsed_ns(report.sent, SimClock::now()));
+            ++reports;
+        })) {
+        }
+    };
+    unsigned char batch[MAX_DATAGRAM];
+    size_t batched = 0;
+    uint32_t sequence = 0;
+    uint64_t sent = 0, failed = 0;
+    auto flush = [&] {
+        Timestamp now = SimClock::now();
+        for (size_t i = 0; i < batched; ++i) {
+            stamp_order(batch + i * WIRE_ORDER_SIZE, now);
+        }
+        if (link.send(batch, batched * WIRE_ORDER_SIZE)) {
+            sent += batched;
+        } else {
+            failed += batched;
+        }
+        batched = 0;
+    };
+    const bool open_loop = settings.flow.pacing == Pacing::OPEN_LOOP;
+    auto wall_start = std::chrono::steady_clock::now();
+    auto end = wall_start + std::chrono::seconds(settings.duration_seconds);
+    Timestamp schedule_start = SimClock::now();
+    while (std::chrono::steady_clock::now() < end) {
+        if (open_loop) {
+            long long ahead_ns = SimClock::elapsed_ns(SimClock::now(), flow.next_arrival(schedule_start));
+            if (ahead_ns > 0) {
+                waiter.pause(std::chrono::nanoseconds(ahead_ns), collect);
+            }
+        }
+        Order order{};
+        flow.next(order, ids);
+        encode_order(order, sequence++, 0, batch + batched * WIRE_ORDER_SIZE);
+        if (++batched == settings.net_send_batch) {
+            flush();
+        }
+        if (!open_loop) {
+            std::chrono::nanoseconds gap = flow.pause();
+            if (gap.count() > 0) {
+                waiter.pause(gap, collect);
+            }
+        }
+    }
+    if (batched > 0) {
+        flush();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    //the last reports are still on their way back
+    auto drain_end = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    while (std::chrono::steady_clock::now() < drain_end) {
+        collect();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::cout << "Sent " << sent << " orders in " << std::fixed << std::setprecision(2) << seconds << " s ("
+              << static_cast<uint64_t>(sent / seconds) << " orders/s), " << failed << " in failed sends, "
+              << reports << " final reports back\n";
+    std::cout << std::left << std::setw(22) << "(us)" << std::right << std::setw(10) << "count"
+              << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p99.9"
+              << std::setw(11) << "max" << "\n";
+    print_breakdown_row("wire -> match", wire_to_match);
+    print_breakdown_row("round trip", round_trip);
     return 0;
-}
\ No newline at end of file
+}
+
+void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " [--profile=<name>] [--config=<file>] [--<setting>=<value> ...]\n"
+              << "Settings are applied in order, so later ones override earlier ones and the constants in main().\n"
+              << "Profiles are the .conf files in " << LLSIM_SCENARIO_DIR << ".\n\nSettings:\n";
+    print_config_keys(scenario_keys());
+}
+
+//Main Function
+int main(int argc, char** argv) {
+    //defaults, every one of these can be overridden from a scenario file or the command line (--help)
+    const int NUM_PRODUCER_THREADS = 4;
+    const int SIMULATION_DURATION_SECONDS = 10;
+    const BookBackend BOOK_BACKEND = BookBackend::LADDER;
+    const TransportBackend TRANSPORT_BACKEND = TransportBackend::QUEUE;
+    //symbol universe and engine shards, each shard is one matching thread owning the symbols that hash to it
+    const size_t NUM_SYMBOLS = 1;
+    const size_t NUM_SHARDS = 1;
+    //send fills/acks back to the producers on per-producer rings and report the round trip
+    const bool EXECUTION_REPORTS = true;
+    //capture / replay: SEED 0 seeds producers from std::random_device. a REPLAY_PATH skips the producers and
+    //replays that capture (one shard's file) straight into the book
+    const uint64_t SEED = 0;
+    const std::string CAPTURE_PATH = "";
+    const std::string REPLAY_PATH = "";
+    const ReplayPace REPLAY_PACE = ReplayPace::FULL_SPEED;
+    //per-producer capacity of the transport (ring size, or initial queue capacity)
+    const size_t TRANSPORT_CAPACITY = 1 << 16;
+    //engine batching: orders drained per poll (1 = one at a time) and per-order timestamp sampling
+    const size_t BATCH_SIZE = 1;
+    const size_t SAMPLE_EVERY = 0;
+    //set SWEEP to a setting's key to run a short simulation per value instead of a single run,
+    //e.g. "batch_size" with {"1", "4", "16", "64", "256"}, or "rate" to find the saturation point
+    const std::string SWEEP = "";
+    const std::vector<std::string> SWEEP_VALUES = {};
+    const int SWEEP_SECONDS_PER_POINT = 3;
+    //SWEEP_BY crosses the sweep with a second setting, e.g. "num_producers" with {"1", "2", "4"}
+    const std::string SWEEP_BY = "";
+    const std::vector<std::string> SWEEP_BY_VALUES = {};
+    //wait strategies: engine when the transport is empty, producers between orders
+    const WaitStrategy ENGINE_WAIT = WaitStrategy::SPIN_YIELD;
+    //producers spin: the default gap is shorter than any sleep's overshoot, so spin-park would never park
+    const WaitStrategy PRODUCER_WAIT = WaitStrategy::SPIN;
+    const uint32_t WAIT_SPIN_LIMIT = 100;
+    const std::chrono::microseconds PRODUCER_GAP(10);
+    //spin-park producers sleep until this long before the next send and spin the rest, so the sleep's
+    //overshoot (tens of us under the default timer slack) is absorbed and reports are taken as they arrive.
+    //only gaps wider than this park at all, so pair spin_park with a PRODUCER_GAP well above it
+    const std::chrono::microseconds PRODUCER_SPIN_WINDOW(80);
+    //prices, quantities, side skew, message mix, rate and bursts (defaults in order_flow.h)
+    const OrderFlowProfile ORDER_FLOW{};
+    //thread placement: {} / 0 leave it to the scheduler
+    const std::vector<int> ENGINE_CORES = {}; //one per shard
+    const std::vector<int> PRODUCER_CORES = {};
+    const int ENGINE_REALTIME_PRIORITY = 0; //SCHED_FIFO 1-99, needs CAP_SYS_NICE
+    const bool NUMA_LOCAL_MEMORY = true;
+    //startup sizing for everything the matching threads allocate from, per symbol
+    const size_t MAX_RESTING_ORDERS = DEFAULT_MAX_ORDERS;
+    const size_t MAX_PRICE_LEVELS = DEFAULT_MAX_LEVELS;
+    const size_t MAX_LADDER_WINDOW = DEFAULT_MAX_WINDOW; //ladder: wider re-centres are refused, the order rejected
+    const ExhaustionPolicy POOL_POLICY = ExhaustionPolicy::REJECT;
+    //how often the reporter prints an interval histogram
+    const std::chrono::milliseconds REPORT_INTERVAL(1000);
+    //market data: book levels per side published after every batch (0 = off), and the shared memory name
+    //other processes read them from. MONITOR_SHM turns this process into such a reader
+    const size_t SNAPSHOT_DEPTH = 0;
+    const std::string MARKET_DATA_SHM = "";
+    const std::string MONITOR_SHM = "";
+    //L2 feed: every level change goes to a downstream feed thread, conflated over FEED_CONFLATION (0 = none)
+    const bool L2_FEED = false;
+    const std::chrono::microseconds FEED_CONFLATION(0);
+    //shared memory ingress: client processes started with CLIENT_SHM set to this run's INGRESS_SHM send their
+    //orders into INGRESS_CLIENTS slots next to the producer threads
+    const std::string INGRESS_SHM = "";
+    const size_t INGRESS_CLIENTS = 1;
+    const std::string CLIENT_SHM = "";
+    //network ingress: binary orders over UDP or TCP on NET_ADDRESS:NET_PORT, received NET_RECV_BATCH datagrams
+    //per call. NET_CLIENT turns this process into a load generator sending NET_SEND_BATCH orders per datagram
+    const NetProtocol NET_INGRESS = NetProtocol::NONE;
+    const std::string NET_ADDRESS = "127.0.0.1";
+    const uint16_t NET_PORT = 9000;
+    const size_t NET_RECV_BATCH = 32;
+    const NetProtocol NET_CLIENT = NetProtocol::NONE;
+    const size_t NET_SEND_BATCH = 1;
+    //pre-trade risk: RISK_MODE runs the checks on the engine thread or on a thread of their own per shard,
+    //each limit 0 leaves its check out
+    const RiskMode RISK_MODE = RiskMode::OFF;
+    const Quantity RISK_MAX_QUANTITY = 0;
+    const Price RISK_COLLAR_TICKS = 0;
+    const long long RISK_MAX_POSITION = 0;
+    const double RISK_MAX_RATE = 0.0;
+    const double RISK_RATE_BURST = 100.0;
+    //journal: every accepted order and trade goes to JOURNAL_PATH (per shard), written by a thread of its own and
+    //synced per JOURNAL_SYNC, with a snapshot of the books every JOURNAL_SNAPSHOT_EVERY orders (0 = none).
+    //RECOVER_JOURNAL rebuilds the books from such a journal instead of simulating
+    const std::string JOURNAL_PATH = "";
+    const JournalSync JOURNAL_SYNC = JournalSync::BATCH;
+    const std::chrono::microseconds JOURNAL_COMMIT_INTERVAL(1000);
+    const bool JOURNAL_DIRECT = false;
+    const size_t JOURNAL_RING = 1 << 16;
+    const uint64_t JOURNAL_SNAPSHOT_EVERY = 100000;
+    const std::string RECOVER_JOURNAL = "";
+    //hardware counters: every PERF_SAMPLE_EVERY-th order (0 = off) has cycles, instructions, branch and cache
+    //misses read around its dequeue and process_order, reported per band of its PERF_BUCKET latency
+    const uint64_t PERF_SAMPLE_EVERY = 0;
+    const PerfBucket PERF_BUCKET = PerfBucket::MATCHING;
+    //run lifecycle: WARMUP_SECONDS of flow before the SIMULATION_DURATION_SECONDS measurement window (none of it
+    //reported), then a drain of whatever is queued. LOCK_MEMORY pins and faults in every page with mlockall first
+    const int WARMUP_SECONDS = 1;
+    const bool LOCK_MEMORY = true;
+    Scenario scenario{SimulationSettings{NUM_PRODUCER_THREADS, SIMULATION_DURATION_SECONDS,
+                                         BookLimits{MAX_RESTING_ORDERS, MAX_PRICE_LEVELS, POOL_POLICY, MAX_LADDER_WINDOW},
+                                         REPORT_INTERVAL, TRANSPORT_CAPACITY, BOOK_BACKEND, TRANSPORT_BACKEND,
+                                         BATCH_SIZE, SAMPLE_EVERY, true, ENGINE_WAIT, PRODUCER_WAIT, WAIT_SPIN_LIMIT,
+                                         PRODUCER_GAP, PRODUCER_SPIN_WINDOW, ORDER_FLOW,
+                                         ThreadPlacement{ENGINE_CORES, PRODUCER_CORES, ENGINE_REALTIME_PRIORITY,
+                                                         NUMA_LOCAL_MEMORY}, NUM_SYMBOLS, NUM_SHARDS,
+                                         EXECUTION_REPORTS, SEED, CAPTURE_PATH, REPLAY_PATH, REPLAY_PACE,
+                                         SNAPSHOT_DEPTH, MARKET_DATA_SHM, MONITOR_SHM, L2_FEED, FEED_CONFLATION,
+                                         INGRESS_SHM, INGRESS_CLIENTS, CLIENT_SHM, NET_INGRESS, NET_ADDRESS,
+                                         NET_PORT, NET_RECV_BATCH, NET_CLIENT, NET_SEND_BATCH, RISK_MODE,
+                                         RiskLimits{RISK_MAX_QUANTITY, RISK_COLLAR_TICKS, RISK_MAX_POSITION,
+                                                    RISK_MAX_RATE, RISK_RATE_BURST},
+                                         JOURNAL_PATH, JOURNAL_SYNC, JOURNAL_COMMIT_INTERVAL, JOURNAL_DIRECT,
+                                         JOURNAL_RING, JOURNAL_SNAPSHOT_EVERY, RECOVER_JOURNAL,
+                                         PERF_SAMPLE_EVERY, PERF_BUCKET, WARMUP_SECONDS, LOCK_MEMORY},
+                      SWEEP, SWEEP_VALUES, SWEEP_SECONDS_PER_POINT, SWEEP_BY, SWEEP_BY_VALUES};
+    //scenario files and --key=value arguments, applied over the constants in the order they were given
+    Config config(LLSIM_SCENARIO_DIR);
+    std::string error;
+    bool configured = config.parse_args(argc, argv, error);
+    for (const ConfigEntry& entry : config.entries()) {
+        if (!configured) {
+            break;
+        }
+        configured = apply_config_entry(scenario_keys(), scenario, entry, error);
+    }
+    if (configured) {
+        error = validate_scenario(scenario);
+        configured = error.empty();
+    }
+    if (config.help()) {
+        print_usage(argv[0]);
+        return 0;
+    }
+    if (!configured) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    const SimulationSettings& settings = scenario.settings;
+    if (!settings.monitor_shm.empty()) {
+        return run_monitor(settings);
+    }
+    if (!settings.client_shm.empty()) {
+        return run_client(settings);
+    }
+    if (settings.net_client != NetProtocol::NONE) {
+        return run_net_client(settings);
+    }
+    std::cout << "Starting " << settings.num_producers << " producer threads.\n";
+    std::cout << "Starting " << settings.num_shards << " consumer (matching engine) thread"
+              << (settings.num_shards == 1 ? "" : "s") << " for " << settings.num_symbols << " symbol"
+              << (settings.num_symbols == 1 ? "" : "s") << ".\n";
+    std::cout << "Order book backend: "
+              << (settings.book_backend == BookBackend::MAP ? MapOrderBook::NAME : LadderOrderBook::NAME);
+    if (settings.book_backend == BookBackend::LADDER) {
+        std::cout << " (level scans: " << level_scan::to_string(level_scan::active()) << ")";
+    }
+    std::cout << "\n";
+    std::cout << "Order flow: " << describe_flow(settings) << "\n";
+    std::cout << "Simulation will run for " << settings.duration_seconds << " seconds";
+    if (settings.warmup_seconds > 0) {
+        std::cout << " after a " << settings.warmup_seconds << " second warm-up";
+    }
+    std::cout << ".\n";
+    //calibrate the timestamp source before any order is stamped
+    SimClock::calibrate();
+    std::cout << "Clock: " << SimClock::NAME << std::fixed << std::setprecision(3) << " at " << SimClock::ticks_per_ns()
+              << " ticks/ns" << (SimClock::invariant() ? "" : " (WARNING: not invariant)") << "\n";
+    ClockDriftReport drift = check_cross_core_drift<SimClock>();
+    if (!drift.supported) {
+        std::cout << "Cross-core drift: not checked (threads cannot be pinned to the cores this process may run on)\n";
+    } else {
+        std::cout << "Cross-core drift: " << drift.max_skew_ns << " ns max over " << drift.cores_checked
+                  << " cores from core " << drift.reference_core << " (round trip " << drift.round_trip_ns << " ns)";
+        if (drift.cores_unpinned > 0) {
+            std::cout << ", " << drift.cores_unpinned << " left out, pinning refused";
+        }
+        std::cout << "\n";
+    }
+    //pinned threads only get a core to themselves if the kernel was booted with isolcpus=
+    std::vector<int> isolated = isolated_cores();
+    if (isolated.empty()) {
+        std::cout << "Isolated cores: none";
+    } else {
+        std::cout << "Isolated cores:";
+        for (int core : isolated) {
+            std::cout << " " << core;
+        }
+    }
+    for (int core : settings.placement.engine_cores) {
+        if (std::find(isolated.begin(), isolated.end(), core) == isolated.end()) {
+            std::cout << " (WARNING: engine core " << core << " is not isolated)";
+        }
+    }
+    std::cout << "\n\n";
+    if (!settings.recover_journal.empty()) {
+        if (settings.book_backend == BookBackend::MAP) {
+            run_recovery<MapOrderBook>(settings);
+        } else {
+            run_recovery<LadderOrderBook>(settings);
+        }
+    } else if (!settings.replay_path.empty()) {
+        if (settings.book_backend == BookBackend::MAP) {
+            run_replay<MapOrderBook>(settings);
+        } else {
+            run_replay<LadderOrderBook>(settings);
+        }
+    } else if (!scenario.sweep.empty()) {
+        run_sweep(scenario);
+    } else {
+        execute(settings);
+    }
+    return 0;
+}
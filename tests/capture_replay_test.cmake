@@ -0,0 +1,40 @@
+#Capture/Replay Test: a run with inline risk checks captures what it matched, and replaying that capture
+#must end in the same books. run with -DSIM=<order_book_sim> -DWORK_DIR=<scratch dir>
+if(NOT SIM OR NOT WORK_DIR)
+    message(FATAL_ERROR "SIM and WORK_DIR must be set")
+endif()
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+#top of book and resting count of every book in a run's FINAL section
+function(final_books output result)
+    string(FIND "${output}" "--- FINAL ---" start)
+    if(start EQUAL -1)
+        message(FATAL_ERROR "no FINAL section in:\n${output}")
+    endif()
+    string(SUBSTRING "${output}" ${start} -1 final)
+    string(REGEX REPLACE " over [0-9]+ levels" "" final "${final}")
+    string(REGEX MATCHALL "(BIDS|ASKS)[^\n]*|Resting orders: [0-9]+\n" books "${final}")
+    set(${result} "${books}" PARENT_SCOPE)
+endfunction()
+
+#one order at a time and batched, the two engine paths. a tight quantity limit rejects most orders
+foreach(batch 1 16)
+    set(capture ${WORK_DIR}/inline_risk_${batch}.bin)
+    execute_process(COMMAND ${SIM} --duration_seconds=1 --warmup_seconds=0 --lock_memory=false --seed=11
+                            --risk_mode=inline --risk_max_quantity=5 --batch_size=${batch} --capture_path=${capture}
+                    OUTPUT_VARIABLE live RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "live run (batch ${batch}) failed:\n${live}")
+    endif()
+    execute_process(COMMAND ${SIM} --replay_path=${capture} --lock_memory=false
+                    OUTPUT_VARIABLE replay RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "replay (batch ${batch}) failed:\n${replay}")
+    endif()
+    final_books("${live}" live_books)
+    final_books("${replay}" replay_books)
+    if(NOT live_books OR NOT live_books STREQUAL replay_books)
+        message(FATAL_ERROR "batch ${batch}: replay ended in different books\nlive:\n${live_books}\nreplay:\n${replay_books}")
+    endif()
+    message(STATUS "batch ${batch}: replay matches the live books")
+endforeach()
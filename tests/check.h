@@ -0,0 +1,16 @@
+#pragma once
+#include <iostream>
+
+//Minimal test support: CHECK reports a failed condition and keeps going, main returns check_failures()
+inline int& check_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                          \
+    do {                                                                                          \
+        if (!(condition)) {                                                                       \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n";   \
+            ++check_failures();                                                                   \
+        }                                                                                         \
+    } while (0)
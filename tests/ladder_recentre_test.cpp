@@ -0,0 +1,74 @@
+#include <random>
+#include "check.h"
+#include "memory_pool.h"
+#include "price_level.h"
+#include "map_order_book.h"
+#include "ladder_order_book.h"
+
+//Ladder Re-centre Test: a flow whose mid walks up and then back down, with old orders cancelled so the book
+//stays narrow, makes the ladder move its window inside its arena arrays hundreds of times in both directions
+//and widen it a few. after every message it must agree with the map book, and it must never touch the arena
+//again once it is built
+
+Order message(MsgType type, OrderID id, Side side, Price price, Quantity quantity) {
+    Order order{};
+    order.type = type;
+    order.id = id;
+    order.side = side;
+    order.price = price;
+    order.quantity = quantity;
+    return order;
+}
+
+bool same_book(const MapOrderBook& map, const LadderOrderBook& ladder) {
+    TopOfBook a = map.top_of_book();
+    TopOfBook b = ladder.top_of_book();
+    return a.bid_price == b.bid_price && a.bid_quantity == b.bid_quantity && a.ask_price == b.ask_price
+           && a.ask_quantity == b.ask_quantity && map.resting_orders() == ladder.resting_orders()
+           && map.price_levels() == ladder.price_levels();
+}
+
+int main() {
+    BookLimits limits;
+    limits.max_orders = 1 << 12;
+    limits.max_levels = 64;
+    limits.max_window = 1 << 10;
+    BookLimits map_limits = limits;
+    map_limits.max_levels = 1 << 10;
+    Arena map_arena(MapOrderBook::arena_bytes(map_limits));
+    Arena ladder_arena(LadderOrderBook::arena_bytes(limits));
+    MapOrderBook map(map_arena, map_limits);
+    LadderOrderBook ladder(ladder_arena, limits, nullptr, 100);
+    size_t built = ladder_arena.bytes_used();
+    CHECK(built <= ladder_arena.bytes_capacity());
+
+    std::mt19937 gen(11);
+    OrderID next_id = 1;
+    double mid = 100.0;
+    int mismatches = 0;
+    auto send = [&](Order order) {
+        Order copy = order;
+        map.process_order(order);
+        ladder.process_order(copy);
+        if (!same_book(map, ladder)) {
+            ++mismatches;
+        }
+    };
+    for (int i = 0; i < 100000; ++i) {
+        mid += i % 20000 < 10000 ? 0.3 : -0.35;
+        Side side = gen() % 2 == 0 ? Side::BUY : Side::SELL;
+        Price price = static_cast<Price>(mid) + static_cast<Price>(gen() % 41) - 20;
+        send(message(MsgType::NEW, next_id, side, price, 1 + static_cast<Quantity>(gen() % 10)));
+        if (gen() % 4 == 0) {
+            send(message(MsgType::MODIFY, next_id - gen() % 50, side, 0, static_cast<Quantity>(gen() % 12)));
+        }
+        if (next_id > 200) {
+            send(message(MsgType::CANCEL, next_id - 200, side, 0, 0));
+        }
+        ++next_id;
+    }
+    CHECK(mismatches == 0);
+    CHECK(ladder.recentres() > 100);
+    CHECK(ladder_arena.bytes_used() == built);
+    return check_failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+#include <climits>
+#include <vector>
+#include "check.h"
+#include "level_scan.h"
+
+//Level Scan Test: for every kernel set this build and CPU support, the dispatching searches and sweeps give
+//exactly what the scalar loops give, over every window of a small bitmap and a small totals array. that puts
+//the answer on and either side of each vector register boundary, in the tails and at both ends of the window
+
+using namespace level_scan;
+
+const size_t WORDS = 40;
+const size_t TOTALS = 72;
+
+//one or two non-zero words anywhere, or none, against every [begin, end)
+void searches_match_scalar() {
+    std::vector<uint64_t> words(WORDS, 0);
+    auto compare_windows = [&] {
+        for (size_t begin = 0; begin <= WORDS; ++begin) {
+            for (size_t end = begin; end <= WORDS; ++end) {
+                CHECK(first_nonzero(words.data(), begin, end) == scalar::first_nonzero(words.data(), begin, end));
+                CHECK(last_nonzero(words.data(), begin, end) == scalar::last_nonzero(words.data(), begin, end));
+            }
+        }
+    };
+    compare_windows();
+    for (size_t set = 0; set < WORDS; ++set) {
+        //the top bit as well, a kernel that narrowed a word would lose it
+        words[set] = set % 2 == 0 ? 1 : uint64_t{1} << 63;
+        compare_windows();
+        if (set + 5 < WORDS) {
+            words[set + 5] = ~uint64_t{0};
+            compare_windows();
+            words[set + 5] = 0;
+        }
+        words[set] = 0;
+    }
+}
+
+//wanted quantities that land before, exactly on and just after each prefix total of a sweep, plus ones it
+//never reaches
+template <typename Sweep, typename Reference>
+void compare_sweep(const std::vector<Quantity>& totals, size_t from, size_t count, Sweep sweep, Reference reference) {
+    std::vector<long long> wanted{1, LLONG_MAX};
+    for (size_t i = 0; i < count; ++i) {
+        long long prefix = reference(totals.data(), from, i + 1, LLONG_MAX).quantity;
+        wanted.push_back(prefix - 1);
+        wanted.push_back(prefix);
+        wanted.push_back(prefix + 1);
+    }
+    for (long long want : wanted) {
+        Span span = sweep(totals.data(), from, count, want);
+        Span expected = reference(totals.data(), from, count, want);
+        CHECK(span.slots == expected.slots);
+        CHECK(span.quantity == expected.quantity);
+    }
+}
+
+void sweeps_match_scalar() {
+    auto scalar_up = [](const Quantity* t, size_t from, size_t count, long long want) {
+        return scalar::sweep_up(t, from, count, want);
+    };
+    auto scalar_down = [](const Quantity* t, size_t from, size_t count, long long want) {
+        return scalar::sweep_down(t, from, count, want);
+    };
+    //zeros for empty ticks, and totals near INT_MAX so a block sum only fits once widened
+    std::vector<Quantity> totals(TOTALS);
+    for (size_t i = 0; i < TOTALS; ++i) {
+        if (i % 7 == 0) {
+            totals[i] = 0;
+        } else {
+            totals[i] = i % 11 == 0 ? INT_MAX - static_cast<Quantity>(i) : static_cast<Quantity>(i % 5 + 1);
+        }
+    }
+    for (size_t from = 0; from < TOTALS; ++from) {
+        for (size_t count = 0; from + count <= TOTALS; ++count) {
+            compare_sweep(totals, from, count, sweep_up, scalar_up);
+        }
+        for (size_t count = 0; count <= from + 1; ++count) {
+            compare_sweep(totals, from, count, sweep_down, scalar_down);
+        }
+    }
+}
+
+int main() {
+    for (Isa isa : {Isa::SCALAR, Isa::NEON, Isa::AVX2, Isa::AVX512}) {
+        if (!select(isa)) {
+            continue;
+        }
+        std::cout << "level scan kernels: " << to_string(isa) << "\n";
+        searches_match_scalar();
+        sweeps_match_scalar();
+    }
+    return check_failures() == 0 ? 0 : 1;
+}
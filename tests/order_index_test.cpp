@@ -0,0 +1,71 @@
+#include "check.h"
+#include "memory_pool.h"
+#include "price_level.h"
+#include "map_order_book.h"
+#include "ladder_order_book.h"
+
+//Order Index Test: a second order with the id of one still resting is rejected, by the index and by
+//both books, and the resting order keeps its id, level and quantity
+
+Order new_order(OrderID id, Side side, Price price, Quantity quantity) {
+    Order order{};
+    order.id = id;
+    order.type = MsgType::NEW;
+    order.side = side;
+    order.price = price;
+    order.quantity = quantity;
+    return order;
+}
+
+void index_rejects_duplicate() {
+    Arena arena(OrderIndex::bytes_needed(64));
+    OrderIndex index(arena, 64);
+    OrderNode first{};
+    OrderNode second{};
+    CHECK(index.insert(7, &first));
+    CHECK(!index.insert(7, &second));
+    CHECK(index.size() == 1);
+    CHECK(index.find(7) == &first);
+    index.erase(7);
+    CHECK(index.find(7) == nullptr);
+    CHECK(index.insert(7, &second));
+    CHECK(index.find(7) == &second);
+}
+
+template <typename Book>
+void book_rejects_duplicate() {
+    BookLimits limits;
+    limits.max_orders = 64;
+    limits.max_levels = 64;
+    Arena arena(Book::arena_bytes(limits));
+    Book book(arena, limits);
+    Order resting = new_order(1, Side::BUY, 99, 10);
+    book.process_order(resting);
+    //same id on another level, then on the same one: neither rests
+    Order elsewhere = new_order(1, Side::BUY, 98, 5);
+    book.process_order(elsewhere);
+    Order same_level = new_order(1, Side::BUY, 99, 5);
+    book.process_order(same_level);
+    CHECK(book.resting_orders() == 1);
+    CHECK(book.price_levels() == 1);
+    TopOfBook top = book.top_of_book();
+    CHECK(top.bid_price == 99);
+    CHECK(top.bid_quantity == 10);
+    //the id still reaches the original order
+    CHECK(book.cancel(1));
+    CHECK(book.resting_orders() == 0);
+    CHECK(book.top_of_book().bid_quantity == 0);
+    CHECK(!book.cancel(1));
+    //and is free again once it is gone
+    Order again = new_order(1, Side::SELL, 101, 3);
+    book.process_order(again);
+    CHECK(book.resting_orders() == 1);
+    CHECK(book.top_of_book().ask_quantity == 3);
+}
+
+int main() {
+    index_rejects_duplicate();
+    book_rejects_duplicate<MapOrderBook>();
+    book_rejects_duplicate<LadderOrderBook>();
+    return check_failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+#include <thread>
+#include <chrono>
+#include "check.h"
+#include "memory_pool.h"
+#include "order_timeline.h"
+#include "transport.h"
+
+//Timeline Table Test: one producer sends far more orders than the table is deep through the unbounded
+//queue transport, while the engine side lags behind it. every order must still find its own stamps
+const size_t DEPTH = 4;
+const uint32_t ORDERS = 20000;
+
+template <typename Transport>
+void overrun_table() {
+    Arena arena(TimelineTable::bytes_needed(1, DEPTH) + Transport::arena_bytes(1, ORDERS));
+    TimelineTable timelines(arena, 1, DEPTH);
+    Transport transport(arena, 1, ORDERS);
+    CHECK(timelines.slots_per_producer() == DEPTH);
+    std::thread producer([&] {
+        auto link = transport.producer(0);
+        for (uint32_t sequence = 0; sequence < ORDERS; ++sequence) {
+            Order order{};
+            order.id = sequence + 1;
+            order.sequence = sequence;
+            OrderTimeline* timeline;
+            while (!(timeline = timelines.claim(order))) {
+                std::this_thread::yield();
+            }
+            //stand-in stamps that say which order wrote them
+            timeline->intended = sequence + 1;
+            timeline->produce = sequence + 2;
+            while (!link.send(order)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    uint32_t received = 0;
+    size_t mismatched = 0;
+    while (received < ORDERS) {
+        Order order;
+        if (!transport.poll(order)) {
+            std::this_thread::yield();
+            continue;
+        }
+        //let the producer get as far ahead as it can
+        if (received % 1000 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        OrderTimeline& timeline = timelines.at(order);
+        if (order.sequence != received || timeline.intended != order.sequence + 1
+            || timeline.produce != order.sequence + 2) {
+            ++mismatched;
+        }
+        timeline.consume = timeline.produce + 1;
+        timelines.release(order);
+        ++received;
+    }
+    producer.join();
+    CHECK(received == ORDERS);
+    CHECK(mismatched == 0);
+}
+
+int main() {
+    overrun_table<QueueTransport>();
+    overrun_table<TokenQueueTransport>();
+    overrun_table<SpscRingTransport>();
+    return check_failures() == 0 ? 0 : 1;
+}